@@ -0,0 +1,188 @@
+#include "ban_table.h"
+#include "epoch.h"
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+const IpAddress V4_FIRST = IpAddress::FromV4(0);
+const IpAddress V4_LAST = IpAddress::FromV4(0xFFFFFFFFu);
+
+// Whether `next` starts inside or right after a range ending at `last`
+bool Touches(const IpAddress& last, const IpAddress& next) {
+    if (!(last < next)) {
+        return true;
+    }
+    IpAddress after{last.hi + (last.lo == ~0ull ? 1 : 0), last.lo + 1};
+    return !(after < next);
+}
+
+} // namespace
+
+IpBanTable::IpBanTable() {
+    Publish();
+}
+
+IpBanTable::~IpBanTable() {
+    // Tables retired earlier belong to Epoch; readers of this one are gone
+    delete compiled.load(std::memory_order_acquire);
+}
+
+bool IpBanTable::IsBanned(const IpAddress& address) const {
+    EpochGuard guard;
+    const Compiled* table = compiled.load(std::memory_order_acquire);
+
+    if (address.IsV4()) {
+        // The containing range, if any, is the first one ending at or
+        // after the address; the index bounds where that can be
+        uint32_t ip = address.V4();
+        uint32_t bucket = ip >> 16;
+        auto begin = table->v4_last.begin() + table->v4_index[bucket];
+        auto end = table->v4_last.begin() + table->v4_index[bucket + 1];
+        if (end != table->v4_last.end()) {
+            ++end;
+        }
+        auto it = std::lower_bound(begin, end, ip);
+        return it != table->v4_last.end() &&
+               table->v4_first[it - table->v4_last.begin()] <= ip;
+    }
+
+    auto it = std::lower_bound(table->v6.begin(), table->v6.end(), address,
+                               [](const V6Range& range, const IpAddress& value) {
+                                   return range.last < value;
+                               });
+    return it != table->v6.end() && !(address < it->first);
+}
+
+bool IpBanTable::Ban(const IpPrefix& prefix) {
+    w32::LockGuard lock(write_mutex);
+    auto it = std::lower_bound(rules.begin(), rules.end(), prefix);
+    if (it != rules.end() && *it == prefix) {
+        return false;
+    }
+    rules.insert(it, prefix);
+    Publish();
+    return true;
+}
+
+bool IpBanTable::Unban(const IpPrefix& prefix) {
+    w32::LockGuard lock(write_mutex);
+    auto it = std::lower_bound(rules.begin(), rules.end(), prefix);
+    if (it == rules.end() || !(*it == prefix)) {
+        return false;
+    }
+    rules.erase(it);
+    Publish();
+    return true;
+}
+
+size_t IpBanTable::BanAll(std::vector<IpPrefix> prefixes) {
+    std::sort(prefixes.begin(), prefixes.end());
+    prefixes.erase(std::unique(prefixes.begin(), prefixes.end()), prefixes.end());
+
+    w32::LockGuard lock(write_mutex);
+    size_t before = rules.size();
+    std::vector<IpPrefix> merged;
+    merged.reserve(rules.size() + prefixes.size());
+    std::set_union(rules.begin(), rules.end(), prefixes.begin(), prefixes.end(),
+                   std::back_inserter(merged));
+    rules.swap(merged);
+    if (rules.size() != before) {
+        Publish();
+    }
+    return rules.size() - before;
+}
+
+long long IpBanTable::LoadFile(const std::string& path, size_t* rejected) {
+    std::ifstream file(path);
+    if (!file) {
+        return -1;
+    }
+
+    std::vector<IpPrefix> prefixes;
+    size_t bad = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.resize(comment);
+        }
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            continue;
+        }
+        size_t last = line.find_last_not_of(" \t\r");
+
+        IpPrefix prefix;
+        if (IpPrefix::Parse(line.substr(first, last - first + 1), prefix)) {
+            prefixes.push_back(prefix);
+        } else {
+            ++bad;
+        }
+    }
+
+    if (rejected) {
+        *rejected = bad;
+    }
+    return (long long)BanAll(std::move(prefixes));
+}
+
+size_t IpBanTable::size() const {
+    w32::LockGuard lock(write_mutex);
+    return rules.size();
+}
+
+void IpBanTable::Publish() {
+    const Compiled* old = compiled.exchange(Compile(rules).release(), std::memory_order_acq_rel);
+    if (old) {
+        Epoch::Retire(old);
+    }
+}
+
+std::unique_ptr<IpBanTable::Compiled> IpBanTable::Compile(const std::vector<IpPrefix>& rules) {
+    std::unique_ptr<Compiled> table(new Compiled());
+
+    // Rules are sorted by first address, so merging is one pass
+    std::vector<V6Range> ranges;
+    ranges.reserve(rules.size());
+    for (const IpPrefix& rule : rules) {
+        IpAddress first = rule.First();
+        IpAddress last = rule.Last();
+        if (!ranges.empty() && Touches(ranges.back().last, first)) {
+            ranges.back().last = std::max(ranges.back().last, last);
+        } else {
+            ranges.push_back(V6Range{first, last});
+        }
+    }
+
+    // The IPv4-mapped slice of every range goes to the 32-bit table; the
+    // order is unchanged and the merged ranges stay disjoint
+    for (const V6Range& range : ranges) {
+        if (range.last < V4_FIRST || V4_LAST < range.first) {
+            continue;
+        }
+        table->v4_first.push_back(std::max(range.first, V4_FIRST).V4());
+        table->v4_last.push_back(std::min(range.last, V4_LAST).V4());
+    }
+    table->v4_first.shrink_to_fit();
+    table->v4_last.shrink_to_fit();
+
+    table->v4_index.resize((1u << 16) + 1);
+    size_t range = 0;
+    for (uint32_t bucket = 0; bucket <= (1u << 16); ++bucket) {
+        uint64_t bucket_start = (uint64_t)bucket << 16;
+        while (range < table->v4_last.size() && table->v4_last[range] < bucket_start) {
+            ++range;
+        }
+        table->v4_index[bucket] = (uint32_t)range;
+    }
+
+    // IPv4 lookups never search the IPv6 table, so it keeps only ranges
+    // reaching outside the mapped space
+    for (const V6Range& range : ranges) {
+        if (range.first < V4_FIRST || V4_LAST < range.last) {
+            table->v6.push_back(range);
+        }
+    }
+    return table;
+}
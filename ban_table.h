@@ -0,0 +1,101 @@
+#ifndef BAN_TABLE_H
+#define BAN_TABLE_H
+
+#include "ip_address.h"
+#include "win32_compat.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief IPv4/IPv6 ban list of CIDR blocks
+ *
+ * Bans are kept as a list of prefixes and compiled into sorted tables of
+ * disjoint address ranges, overlapping and adjacent blocks merged: one
+ * for IPv4 (32-bit keys, with a 64K-entry index on the top 16 bits that
+ * narrows each search to the ranges of one /16) and one for IPv6.
+ * IsBanned is a binary search over one of them.
+ *
+ * Compiled tables are immutable and published as a whole through a raw
+ * atomic pointer: a lookup is an EpochGuard, one acquire load and the
+ * search, with no lock and no shared reference count. Replaced tables
+ * are retired to Epoch and freed once no lookup can still hold them.
+ *
+ * Every Ban and Unban recompiles the whole table, O(n) in the number of
+ * rules plus the 64K-entry index (close to a millisecond at 10K
+ * rules). That suits operator-driven bans; for batches use BanAll or
+ * LoadFile, which sort the batch once and rebuild once.
+ */
+class IpBanTable {
+public:
+    IpBanTable();
+    ~IpBanTable();
+
+    IpBanTable(const IpBanTable&) = delete;
+    IpBanTable& operator=(const IpBanTable&) = delete;
+
+    /**
+     * @brief Whether any ban covers the address (any thread, no lock)
+     */
+    bool IsBanned(const IpAddress& address) const;
+
+    /**
+     * @brief Add a ban; returns false if it was already present
+     */
+    bool Ban(const IpPrefix& prefix);
+
+    /**
+     * @brief Remove a ban added with exactly this prefix
+     *
+     * Narrower or overlapping bans are untouched; unbanning one host of
+     * a banned /24 is not possible without lifting the /24.
+     * @return false if no such ban exists
+     */
+    bool Unban(const IpPrefix& prefix);
+
+    /**
+     * @brief Add many bans with one rebuild
+     * @return Bans that were new
+     */
+    size_t BanAll(std::vector<IpPrefix> prefixes);
+
+    /**
+     * @brief Load a blocklist: one address or CIDR block per line, blank
+     *        lines and '#' comments ignored
+     * @param rejected Set to the number of lines that failed to parse
+     * @return Bans that were new, or -1 if the file could not be opened
+     */
+    long long LoadFile(const std::string& path, size_t* rejected = nullptr);
+
+    /**
+     * @brief Number of ban rules
+     */
+    size_t size() const;
+
+private:
+    struct V6Range {
+        IpAddress first;
+        IpAddress last;
+    };
+
+    struct Compiled {
+        // Disjoint, sorted; v4_first[i] <= v4_last[i] < v4_first[i + 1]
+        std::vector<uint32_t> v4_first;
+        std::vector<uint32_t> v4_last;
+        // v4_index[b]: first range whose last address is >= b << 16
+        std::vector<uint32_t> v4_index;
+        std::vector<V6Range> v6;
+    };
+
+    mutable w32::Mutex write_mutex;
+    std::vector<IpPrefix> rules;                // Sorted, unique
+    std::atomic<const Compiled*> compiled{nullptr};   // Read under EpochGuard
+
+    void Publish();
+    static std::unique_ptr<Compiled> Compile(const std::vector<IpPrefix>& rules);
+};
+
+#endif // BAN_TABLE_H
@@ -23,9 +23,13 @@ if not exist build mkdir build
 :: Compile server
 echo [1/2] Building server.exe...
 cl /nologo /EHsc /std:c++17 /O2 /W3 ^
-    /I. ^
-    server.cpp sockutil.cpp thread_pool.cpp iocp_server.cpp ^
-    connection_manager.cpp chat_room.cpp message_store.cpp ^
+    /I. /D_WIN32_WINNT=0x0601 /DNOMINMAX /D_CRT_SECURE_NO_WARNINGS ^
+    server.cpp sockutil.cpp iocp_server.cpp ^
+    task.cpp thread_pool.cpp strand.cpp framing.cpp outbound_queue.cpp ^
+    timer_wheel.cpp rate_limiter.cpp epoch.cpp ip_address.cpp ban_table.cpp ^
+    connection_manager.cpp room_id.cpp room_cache.cpp sender_index.cpp ^
+    text_search.cpp trigram_index.cpp chat_room.cpp ^
+    segment_log.cpp log_writer.cpp message_store.cpp ^
     /Fe:build\server.exe ^
     /link ws2_32.lib mswsock.lib
 
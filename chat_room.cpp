@@ -1,135 +1,304 @@
 #include "chat_room.h"
+#include "epoch.h"
 #include <sstream>
 #include <algorithm>
 
+namespace {
+
+/**
+ * @brief Write-locks two shard locks (possibly the same one) in address
+ * order, which for shards of one array is ascending index order
+ */
+class PairWriteLock {
+public:
+    PairWriteLock(w32::SharedMutex& a, w32::SharedMutex& b)
+        : first(&a < &b ? a : b), second(&a < &b ? b : a) {
+        first.lock();
+        if (&second != &first) {
+            second.lock();
+        }
+    }
+
+    ~PairWriteLock() {
+        if (&second != &first) {
+            second.unlock();
+        }
+        first.unlock();
+    }
+
+    PairWriteLock(const PairWriteLock&) = delete;
+    PairWriteLock& operator=(const PairWriteLock&) = delete;
+
+private:
+    w32::SharedMutex& first;
+    w32::SharedMutex& second;
+};
+
+} // namespace
+
+Room* ChatRoomManager::RoomShard::Find(RoomId id) {
+    size_t slot = id / ROOM_SHARDS;
+    return slot < rooms.size() ? rooms[slot].get() : nullptr;
+}
+
 ChatRoomManager::ChatRoomManager() {
+    for (auto& chunk : member_chunks) chunk.store(nullptr, std::memory_order_relaxed);
+
     // Create default "general" room
-    Room general("general", 0);
-    general.topic = "Welcome to the chat server!";
-    rooms["general"] = general;
+    RoomShard& shard = RoomShardFor(GENERAL_ROOM);
+    shard.rooms.resize(GENERAL_ROOM / ROOM_SHARDS + 1);
+    shard.rooms[GENERAL_ROOM / ROOM_SHARDS].reset(new Room(GENERAL_ROOM, "general", 0));
+    shard.rooms[GENERAL_ROOM / ROOM_SHARDS]->topic = "Welcome to the chat server!";
+    PublishMembers(*shard.rooms[GENERAL_ROOM / ROOM_SHARDS], {});
+}
+
+ChatRoomManager::~ChatRoomManager() {
+    for (auto& chunk_ref : member_chunks) {
+        MemberSlotRef* chunk = chunk_ref.load(std::memory_order_relaxed);
+        if (!chunk) continue;
+        for (size_t i = 0; i < MEMBER_CHUNK_SIZE; ++i) {
+            delete chunk[i].load(std::memory_order_relaxed);
+        }
+        delete[] chunk;
+    }
+}
+
+ChatRoomManager::MemberSlotRef* ChatRoomManager::MemberSlot(RoomId id, bool create) {
+    if (id >= MAX_ROOM_IDS) {
+        return nullptr;
+    }
+    auto& chunk_ref = member_chunks[id >> MEMBER_CHUNK_SHIFT];
+    MemberSlotRef* chunk = chunk_ref.load(std::memory_order_acquire);
+    if (!chunk && create) {
+        // A chunk spans room shards, so its allocation has its own lock
+        w32::LockGuard lock(member_chunks_mutex);
+        chunk = chunk_ref.load(std::memory_order_acquire);
+        if (!chunk) {
+            chunk = new MemberSlotRef[MEMBER_CHUNK_SIZE];
+            for (size_t i = 0; i < MEMBER_CHUNK_SIZE; ++i) {
+                chunk[i].store(nullptr, std::memory_order_relaxed);
+            }
+            chunk_ref.store(chunk, std::memory_order_release);
+        }
+    }
+    return chunk ? &chunk[id & (MEMBER_CHUNK_SIZE - 1)] : nullptr;
+}
+
+void ChatRoomManager::PublishMembers(Room& room, std::vector<int> members) {
+    // Caller holds the room's shard exclusively, so publishes are ordered
+    room.members = std::make_shared<const std::vector<int>>(std::move(members));
+    StoreMemberSlot(room.id, room.members);
+}
+
+void ChatRoomManager::StoreMemberSlot(RoomId id, MemberSnapshot members) {
+    const MemberSnapshot* next = members ? new MemberSnapshot(std::move(members)) : nullptr;
+    const MemberSnapshot* old = MemberSlot(id, true)->exchange(next, std::memory_order_acq_rel);
+    if (old) {
+        Epoch::Retire(old);
+    }
+}
+
+void ChatRoomManager::AddMember(Room& room, int client_id) {
+    const std::vector<int>& current = *room.members;
+    if (std::find(current.begin(), current.end(), client_id) != current.end()) {
+        return;
+    }
+    std::vector<int> next;
+    next.reserve(current.size() + 1);
+    next.assign(current.begin(), current.end());
+    next.push_back(client_id);
+    PublishMembers(room, std::move(next));
+}
+
+void ChatRoomManager::RemoveMember(Room& room, int client_id) {
+    const std::vector<int>& current = *room.members;
+    auto it = std::find(current.begin(), current.end(), client_id);
+    if (it == current.end()) {
+        return;
+    }
+    // Order within a room carries no meaning: swap the last one in
+    std::vector<int> next(current);
+    next[it - current.begin()] = next.back();
+    next.pop_back();
+    PublishMembers(room, std::move(next));
 }
 
 bool ChatRoomManager::CreateRoom(const std::string& name, int owner_id, bool is_private, const std::string& password) {
-    w32::LockGuard lock(rooms_mutex);
+    RoomId id = RoomInterner::Intern(name);
+    if (id == INVALID_ROOM) {
+        return false;
+    }
+    
+    RoomShard& shard = RoomShardFor(id);
+    w32::WriteLockGuard lock(shard.mutex);
     
     // Check if room already exists
-    if (rooms.find(name) != rooms.end()) {
+    if (shard.Find(id)) {
         return false;
     }
     
     // Create new room
-    Room room(name, owner_id);
-    room.is_private = is_private;
-    room.password = password;
-    rooms[name] = room;
+    size_t slot = id / ROOM_SHARDS;
+    if (slot >= shard.rooms.size()) {
+        shard.rooms.resize(slot + 1);
+    }
+    shard.rooms[slot].reset(new Room(id, name, owner_id));
+    shard.rooms[slot]->is_private = is_private;
+    shard.rooms[slot]->password = password;
+    PublishMembers(*shard.rooms[slot], {});
     
     return true;
 }
 
 bool ChatRoomManager::DeleteRoom(const std::string& name, int requester_id) {
-    w32::LockGuard lock(rooms_mutex);
+    RoomId id = RoomInterner::Find(name);
     
     // Can't delete general room
-    if (name == "general") {
+    if (id == INVALID_ROOM || id == GENERAL_ROOM) {
         return false;
     }
     
-    auto it = rooms.find(name);
-    if (it == rooms.end()) {
-        return false;
+    // Rare: members are re-homed across every client shard, so take them
+    // all (in order) before the two room shards involved
+    for (auto& client_shard : client_shards) {
+        client_shard.mutex.lock();
     }
     
-    // Only owner or admin (id 0) can delete
-    if (it->second.owner_id != requester_id && requester_id != 0) {
-        return false;
+    bool deleted = false;
+    {
+        RoomShard& shard = RoomShardFor(id);
+        RoomShard& general_shard = RoomShardFor(GENERAL_ROOM);
+        PairWriteLock rooms_lock(shard.mutex, general_shard.mutex);
+        
+        Room* room = shard.Find(id);
+        // Only owner or admin (id 0) can delete
+        if (room && (room->owner_id == requester_id || requester_id == 0)) {
+            // Move all members to general
+            Room* general = general_shard.Find(GENERAL_ROOM);
+            std::vector<int> merged(*general->members);
+            for (int client_id : *room->members) {
+                ClientShardFor(client_id).rooms[client_id] = GENERAL_ROOM;
+                merged.push_back(client_id);
+            }
+            PublishMembers(*general, std::move(merged));
+            
+            StoreMemberSlot(id, nullptr);
+            shard.rooms[id / ROOM_SHARDS].reset();
+            deleted = true;
+        }
     }
     
-    // Move all members to general
-    for (int client_id : it->second.members) {
-        client_rooms[client_id] = "general";
-        rooms["general"].members.insert(client_id);
+    for (size_t i = CLIENT_SHARDS; i > 0; --i) {
+        client_shards[i - 1].mutex.unlock();
     }
-    
-    rooms.erase(it);
-    return true;
+    return deleted;
 }
 
 bool ChatRoomManager::JoinRoom(const std::string& name, int client_id, const std::string& password) {
-    w32::LockGuard lock(rooms_mutex);
+    RoomId id = RoomInterner::Find(name);
+    if (id == INVALID_ROOM) {
+        return false;
+    }
+    return JoinRoom(id, client_id, password);
+}
+
+bool ChatRoomManager::JoinRoom(RoomId id, int client_id, const std::string& password) {
+    ClientShard& client_shard = ClientShardFor(client_id);
+    w32::WriteLockGuard client_lock(client_shard.mutex);
     
-    auto it = rooms.find(name);
-    if (it == rooms.end()) {
+    auto current_it = client_shard.rooms.find(client_id);
+    bool has_current = current_it != client_shard.rooms.end();
+    RoomShard& target = RoomShardFor(id);
+    RoomShard& source = has_current ? RoomShardFor(current_it->second) : target;
+    PairWriteLock rooms_lock(target.mutex, source.mutex);
+    
+    Room* room = target.Find(id);
+    if (!room) {
         return false;
     }
     
     // Check password for private rooms
-    if (it->second.is_private && it->second.password != password) {
+    if (room->is_private && room->password != password) {
         return false;
     }
     
     // Leave current room first
-    auto current_it = client_rooms.find(client_id);
-    if (current_it != client_rooms.end()) {
-        auto room_it = rooms.find(current_it->second);
-        if (room_it != rooms.end()) {
-            room_it->second.members.erase(client_id);
+    if (has_current) {
+        if (Room* current = source.Find(current_it->second)) {
+            RemoveMember(*current, client_id);
         }
     }
     
     // Join new room
-    it->second.members.insert(client_id);
-    client_rooms[client_id] = name;
+    AddMember(*room, client_id);
+    client_shard.rooms[client_id] = id;
     
     return true;
 }
 
 void ChatRoomManager::LeaveRoom(int client_id) {
-    w32::LockGuard lock(rooms_mutex);
+    ClientShard& client_shard = ClientShardFor(client_id);
+    w32::WriteLockGuard client_lock(client_shard.mutex);
     
-    auto it = client_rooms.find(client_id);
-    if (it != client_rooms.end()) {
-        auto room_it = rooms.find(it->second);
-        if (room_it != rooms.end()) {
-            room_it->second.members.erase(client_id);
+    auto it = client_shard.rooms.find(client_id);
+    if (it != client_shard.rooms.end()) {
+        RoomShard& shard = RoomShardFor(it->second);
+        {
+            w32::WriteLockGuard lock(shard.mutex);
+            if (Room* room = shard.Find(it->second)) {
+                RemoveMember(*room, client_id);
+            }
         }
-        client_rooms.erase(it);
+        client_shard.rooms.erase(it);
     }
 }
 
 std::string ChatRoomManager::GetClientRoom(int client_id) {
-    w32::LockGuard lock(rooms_mutex);
+    return RoomInterner::Name(GetClientRoomId(client_id));
+}
+
+RoomId ChatRoomManager::GetClientRoomId(int client_id) {
+    ClientShard& client_shard = ClientShardFor(client_id);
+    w32::ReadLockGuard lock(client_shard.mutex);
     
-    auto it = client_rooms.find(client_id);
-    if (it != client_rooms.end()) {
+    auto it = client_shard.rooms.find(client_id);
+    if (it != client_shard.rooms.end()) {
         return it->second;
     }
-    return "general";
+    return GENERAL_ROOM;
 }
 
 bool ChatRoomManager::SetTopic(const std::string& room_name, const std::string& topic, int requester_id) {
-    w32::LockGuard lock(rooms_mutex);
+    RoomId id = RoomInterner::Find(room_name);
+    if (id == INVALID_ROOM) {
+        return false;
+    }
     
-    auto it = rooms.find(room_name);
-    if (it == rooms.end()) {
+    RoomShard& shard = RoomShardFor(id);
+    w32::WriteLockGuard lock(shard.mutex);
+    
+    Room* room = shard.Find(id);
+    if (!room) {
         return false;
     }
     
     // Only owner or admin can set topic
-    if (it->second.owner_id != requester_id && requester_id != 0) {
+    if (room->owner_id != requester_id && requester_id != 0) {
         return false;
     }
     
-    it->second.topic = topic;
+    room->topic = topic;
     return true;
 }
 
 std::vector<std::string> ChatRoomManager::ListRooms() {
-    w32::LockGuard lock(rooms_mutex);
-    
     std::vector<std::string> room_list;
-    for (const auto& pair : rooms) {
-        if (!pair.second.is_private) {
-            room_list.push_back(pair.first);
+    for (auto& shard : room_shards) {
+        w32::ReadLockGuard lock(shard.mutex);
+        for (const auto& room : shard.rooms) {
+            if (room && !room->is_private) {
+                room_list.push_back(room->name);
+            }
         }
     }
     
@@ -138,57 +307,63 @@ std::vector<std::string> ChatRoomManager::ListRooms() {
 }
 
 std::vector<int> ChatRoomManager::GetRoomMembers(const std::string& room_name) {
-    w32::LockGuard lock(rooms_mutex);
-    
-    auto it = rooms.find(room_name);
-    if (it == rooms.end()) {
+    RoomId id = RoomInterner::Find(room_name);
+    if (id == INVALID_ROOM) {
         return {};
     }
-    
-    return std::vector<int>(it->second.members.begin(), it->second.members.end());
+    return GetRoomMembers(id);
+}
+
+std::vector<int> ChatRoomManager::GetRoomMembers(RoomId id) {
+    MemberSnapshot members = GetMemberSnapshot(id);
+    return members ? *members : std::vector<int>();
+}
+
+MemberSnapshot ChatRoomManager::GetMemberSnapshot(RoomId id) {
+    MemberSlotRef* slot = MemberSlot(id, false);
+    if (!slot) {
+        return nullptr;
+    }
+    EpochGuard guard;
+    const MemberSnapshot* members = slot->load(std::memory_order_acquire);
+    return members ? *members : nullptr;
 }
 
 bool ChatRoomManager::RoomExists(const std::string& name) {
-    w32::LockGuard lock(rooms_mutex);
-    return rooms.find(name) != rooms.end();
+    RoomId id = RoomInterner::Find(name);
+    if (id == INVALID_ROOM) {
+        return false;
+    }
+    
+    RoomShard& shard = RoomShardFor(id);
+    w32::ReadLockGuard lock(shard.mutex);
+    return shard.Find(id) != nullptr;
 }
 
 std::string ChatRoomManager::GetRoomInfo(const std::string& name) {
-    w32::LockGuard lock(rooms_mutex);
+    RoomId id = RoomInterner::Find(name);
+    if (id == INVALID_ROOM) {
+        return "Room not found";
+    }
+    
+    RoomShard& shard = RoomShardFor(id);
+    w32::ReadLockGuard lock(shard.mutex);
     
-    auto it = rooms.find(name);
-    if (it == rooms.end()) {
+    Room* room = shard.Find(id);
+    if (!room) {
         return "Room not found";
     }
     
     std::stringstream ss;
-    ss << "Room: #" << it->second.name << "\n";
-    ss << "Topic: " << it->second.topic << "\n";
-    ss << "Members: " << it->second.members.size() << "\n";
-    ss << "Private: " << (it->second.is_private ? "Yes" : "No") << "\n";
+    ss << "Room: #" << room->name << "\n";
+    ss << "Topic: " << room->topic << "\n";
+    ss << "Members: " << room->members->size() << "\n";
+    ss << "Private: " << (room->is_private ? "Yes" : "No") << "\n";
     
     return ss.str();
 }
 
 std::vector<int> ChatRoomManager::GetRoommates(int client_id) {
-    w32::LockGuard lock(rooms_mutex);
-    
-    auto it = client_rooms.find(client_id);
-    if (it == client_rooms.end()) {
-        // Default to general room
-        auto general_it = rooms.find("general");
-        if (general_it != rooms.end()) {
-            return std::vector<int>(general_it->second.members.begin(), 
-                                    general_it->second.members.end());
-        }
-        return {};
-    }
-    
-    auto room_it = rooms.find(it->second);
-    if (room_it == rooms.end()) {
-        return {};
-    }
-    
-    return std::vector<int>(room_it->second.members.begin(), 
-                            room_it->second.members.end());
+    // Default to general room
+    return GetRoomMembers(GetClientRoomId(client_id));
 }
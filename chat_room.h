@@ -1,38 +1,71 @@
 #ifndef CHAT_ROOM_H
 #define CHAT_ROOM_H
 
+#include "room_id.h"
 #include "win32_compat.h"
+#include <atomic>
 #include <chrono>
+#include <memory>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
+/**
+ * @brief Immutable member list of a room at one point in time
+ *
+ * Rebuilt (copy-on-write) on join/leave only; readers hold a reference
+ * and iterate a flat array while membership moves on.
+ */
+using MemberSnapshot = std::shared_ptr<const std::vector<int>>;
+
 
 /**
  * @brief Represents a single chat room
  */
 struct Room {
+  RoomId id;
   std::string name;
   std::string topic;
-  std::unordered_set<int> members; // Client IDs
+  MemberSnapshot members; // Client IDs; replaced, never mutated
   int owner_id;
   std::chrono::steady_clock::time_point created_at;
   bool is_private;
   std::string password; // Only if private
 
-  Room(const std::string &room_name = "", int owner = 0)
-      : name(room_name), owner_id(owner), is_private(false) {
+  Room(RoomId room_id = INVALID_ROOM, const std::string &room_name = "",
+       int owner = 0)
+      : id(room_id), name(room_name),
+        members(std::make_shared<const std::vector<int>>()), owner_id(owner),
+        is_private(false) {
     created_at = std::chrono::steady_clock::now();
   }
 };
 
+// Lock stripes for rooms (by name hash) and client->room entries (by id)
+constexpr size_t ROOM_SHARDS = 16;
+constexpr size_t CLIENT_SHARDS = 16;
+
 /**
  * @brief Manages chat rooms
+ *
+ * Rooms and the client->room map are split into independently locked
+ * shards, so activity in one room does not contend with another. Lookups
+ * (GetClientRoom, GetRoomMembers, GetRoommates) take shard locks shared;
+ * only membership changes take them exclusively. Member lists are also
+ * published per RoomId as immutable snapshots behind raw atomic pointers,
+ * which GetMemberSnapshot reads with no lock (epoch reclamation keeps a
+ * replaced snapshot alive until no reader can hold it).
+ *
+ * Rooms are addressed by interned RoomId: the broadcast path goes from
+ * client to RoomId to member list without hashing or copying a name.
+ * The name overloads exist for the protocol edges (commands).
+ *
+ * Lock order: client shards (ascending) before room shards (ascending).
  */
 class ChatRoomManager {
 public:
   ChatRoomManager();
+  ~ChatRoomManager();
 
   // Non-copyable
   ChatRoomManager(const ChatRoomManager &) = delete;
@@ -55,6 +88,7 @@ public:
    */
   bool JoinRoom(const std::string &name, int client_id,
                 const std::string &password = "");
+  bool JoinRoom(RoomId room, int client_id, const std::string &password = "");
 
   /**
    * @brief Leave current room
@@ -66,6 +100,11 @@ public:
    */
   std::string GetClientRoom(int client_id);
 
+  /**
+   * @brief Get client's current room ID (GENERAL_ROOM if none)
+   */
+  RoomId GetClientRoomId(int client_id);
+
   /**
    * @brief Set room topic
    */
@@ -81,6 +120,17 @@ public:
    * @brief Get members of a room
    */
   std::vector<int> GetRoomMembers(const std::string &room_name);
+  std::vector<int> GetRoomMembers(RoomId room);
+
+  /**
+   * @brief Current member list of a room without copying the list or
+   *        taking a lock
+   *
+   * An epoch-guarded load of the room's published snapshot plus one
+   * reference count increment; empty if the room does not exist. The
+   * broadcast path iterates this directly.
+   */
+  MemberSnapshot GetMemberSnapshot(RoomId room);
 
   /**
    * @brief Check if room exists
@@ -98,9 +148,42 @@ public:
   std::vector<int> GetRoommates(int client_id);
 
 private:
-  w32::Mutex rooms_mutex;
-  std::unordered_map<std::string, Room> rooms;
-  std::unordered_map<int, std::string> client_rooms; // client_id -> room_name
+  // Room `id` lives in shard id % ROOM_SHARDS at slot id / ROOM_SHARDS
+  struct alignas(64) RoomShard {
+    w32::SharedMutex mutex;
+    std::vector<std::unique_ptr<Room>> rooms; // Null slot: no such room
+    Room *Find(RoomId id);
+  };
+
+  struct alignas(64) ClientShard {
+    w32::SharedMutex mutex;
+    std::unordered_map<int, RoomId> rooms; // client_id -> room
+  };
+
+  RoomShard room_shards[ROOM_SHARDS];
+  ClientShard client_shards[CLIENT_SHARDS];
+
+  // RoomId -> published MemberSnapshot, in lazily allocated chunks that
+  // are never freed before the manager, so readers need no lock. A slot
+  // owns a heap copy of the snapshot handle; replaced copies are retired
+  // to Epoch, so a reader inside an EpochGuard can still copy from one
+  using MemberSlotRef = std::atomic<const MemberSnapshot *>;
+  static constexpr size_t MEMBER_CHUNK_SHIFT = 8;
+  static constexpr size_t MEMBER_CHUNK_SIZE = 1u << MEMBER_CHUNK_SHIFT;
+  std::atomic<MemberSlotRef *>
+      member_chunks[MAX_ROOM_IDS >> MEMBER_CHUNK_SHIFT];
+  w32::Mutex member_chunks_mutex;
+
+  MemberSlotRef *MemberSlot(RoomId room, bool create);
+  void StoreMemberSlot(RoomId room, MemberSnapshot members);
+  void PublishMembers(Room &room, std::vector<int> members);
+  void AddMember(Room &room, int client_id);
+  void RemoveMember(Room &room, int client_id);
+
+  RoomShard &RoomShardFor(RoomId room) { return room_shards[room % ROOM_SHARDS]; }
+  ClientShard &ClientShardFor(int client_id) {
+    return client_shards[(unsigned)client_id % CLIENT_SHARDS];
+  }
 };
 
 #endif // CHAT_ROOM_H
@@ -89,8 +89,9 @@ void SendMessages() {
         
         if (input.empty()) continue;
         
-        // Send to server
-        int result = send(g_socket, input.c_str(), (int)input.length(), 0);
+        // Send to server (newline-delimited framing)
+        std::string line = input + "\n";
+        int result = send(g_socket, line.c_str(), (int)line.length(), 0);
         if (result == SOCKET_ERROR) {
             PrintMessage("Failed to send message.\n", 12);
             g_running = false;
@@ -114,7 +115,7 @@ void SendMessages() {
 BOOL WINAPI ConsoleHandler(DWORD signal) {
     if (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT) {
         if (g_socket != INVALID_SOCKET) {
-            std::string exit_cmd = "#exit";
+            std::string exit_cmd = "#exit\n";
             send(g_socket, exit_cmd.c_str(), (int)exit_cmd.length(), 0);
         }
         g_running = false;
@@ -175,7 +176,8 @@ int main(int argc, char* argv[]) {
     }
     
     // Send username to server
-    send(g_socket, g_username.c_str(), (int)g_username.length(), 0);
+    std::string name_line = g_username + "\n";
+    send(g_socket, name_line.c_str(), (int)name_line.length(), 0);
     
     PrintMessage("\nWelcome, " + g_username + "!\n", 14);
     PrintMessage("Type #help for available commands. Type messages and press Enter to send.\n\n", 11);
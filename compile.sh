@@ -1,9 +1,15 @@
 #!/bin/bash
+set -e
 
-# Compile the client and server with ncurses
-g++ -o ser server.cpp sockutil.cpp -lncurses
-g++ -o cli client.cpp sockutil.cpp -lncurses
+# CMake owns the source lists; this only configures and builds.
+# Usage: ./compile.sh [epoll|io_uring]
+BACKEND_FLAG=""
+if [ -n "$1" ]; then
+    BACKEND_FLAG="-DCHAT_SERVER_BACKEND=$1"
+fi
+
+cmake -S . -B build -DCMAKE_BUILD_TYPE=Release $BACKEND_FLAG
+cmake --build build -j"$(nproc)"
 
 echo "Compilation complete!"
-echo "Run the server with: ./ser <port>"
-echo "Run the client with: ./cli <server_ip> <port>"
\ No newline at end of file
+echo "Run the server with: ./build/bin/server <port>"
@@ -0,0 +1,63 @@
+#ifndef CONNECTION_ACTIVITY_H
+#define CONNECTION_ACTIVITY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Liveness record for one connection
+ *
+ * Created with the connection and shared (by shared_ptr) between the I/O
+ * server, whose read path updates it, and ConnectionManager, which reads
+ * it when an idle timer fires. Every field is a relaxed atomic: readers
+ * want a recent value, not an ordering against anything else, so an
+ * update is a clock read and a few plain stores with no lock.
+ *
+ * The counters have one writer (a connection's reads never complete
+ * concurrently), so they are bumped with load + store rather than a
+ * locked read-modify-write.
+ */
+class ConnectionActivity {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit ConnectionActivity(Clock::time_point now = Clock::now())
+      : last(now.time_since_epoch().count()) {}
+
+  ConnectionActivity(const ConnectionActivity &) = delete;
+  ConnectionActivity &operator=(const ConnectionActivity &) = delete;
+
+  /**
+   * @brief Record completed reads (I/O thread owning the connection)
+   */
+  void RecordRead(uint32_t reads, size_t bytes) {
+    Touch();
+    read_count.store(read_count.load(std::memory_order_relaxed) + reads,
+                     std::memory_order_relaxed);
+    bytes_read.store(bytes_read.load(std::memory_order_relaxed) + bytes,
+                     std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Mark the connection active now (any thread)
+   */
+  void Touch(Clock::time_point now = Clock::now()) {
+    last.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+  }
+
+  Clock::time_point LastActivity() const {
+    return Clock::time_point(Clock::duration(last.load(std::memory_order_relaxed)));
+  }
+
+  uint64_t ReadCount() const { return read_count.load(std::memory_order_relaxed); }
+  uint64_t BytesRead() const { return bytes_read.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<Clock::rep> last;
+  std::atomic<uint64_t> read_count{0};
+  std::atomic<uint64_t> bytes_read{0};
+};
+
+#endif // CONNECTION_ACTIVITY_H
@@ -4,109 +4,167 @@
 
 ConnectionManager::ConnectionManager() : ConnectionManager(Config()) {}
 
-ConnectionManager::ConnectionManager(const Config& cfg) : config(cfg) {}
+ConnectionManager::ConnectionManager(const Config& cfg, TimerWheel* timer_wheel)
+    : config(cfg)
+    , connection_limit(cfg.max_connections_per_second, cfg.max_connections_per_second)
+    , ip_limiter(cfg.admission_table_size, cfg.max_connections_per_ip_per_minute / 60.0,
+                 cfg.ip_connection_burst)
+    , subnet_limiter(cfg.admission_table_size, cfg.max_connections_per_subnet_per_minute / 60.0,
+                     cfg.subnet_connection_burst)
+    , message_limiter(cfg.max_total_connections, cfg.max_messages_per_minute / 60.0,
+                      cfg.message_burst)
+    , timers(timer_wheel) {}
 
-bool ConnectionManager::AllowConnection(const std::string& ip_address) {
-    // Check if banned
-    if (IsBanned(ip_address)) {
-        return false;
-    }
-    
-    // Check max connections
-    if (current_connections >= config.max_total_connections) {
-        return false;
-    }
-    
-    // Check rate limit
-    w32::LockGuard lock(rate_mutex);
-    auto now = std::chrono::steady_clock::now();
-    auto one_second_ago = now - std::chrono::seconds(1);
-    
-    // Remove old timestamps
-    while (!connection_timestamps.empty() && connection_timestamps.front() < one_second_ago) {
-        connection_timestamps.pop_front();
+const char* ConnectionManager::AdmissionName(Admission result) {
+    switch (result) {
+    case Admission::ADMITTED: return "admitted";
+    case Admission::BANNED: return "banned";
+    case Admission::SERVER_FULL: return "server full";
+    case Admission::IP_RATE: return "address rate";
+    case Admission::SUBNET_RATE: return "subnet rate";
+    case Admission::GLOBAL_RATE: return "global rate";
     }
-    
-    if (connection_timestamps.size() >= (size_t)config.max_connections_per_second) {
-        return false;
+    return "unknown";
+}
+
+ConnectionManager::Admission ConnectionManager::AdmitConnection(const IpAddress& address) {
+    Admission result = Admission::ADMITTED;
+    int64_t now = GcraLimit::Now();
+
+    // A source is an IPv4 address or an IPv6 /64, the usual smallest
+    // allocation; subnets are /24 and /48. IPv4 keys keep the mapped
+    // prefix bits, so they never meet a key from routable IPv6 space
+    uint64_t source = address.IsV4() ? address.lo : address.hi;
+    uint64_t subnet = address.IsV4() ? address.lo >> 8 : address.hi >> 16;
+
+    // Cheapest and most specific first, so one abusive source is stopped
+    // by its own bucket before it can drain the shared ones
+    if (IsBanned(address)) {
+        result = Admission::BANNED;
+    } else if (current_connections >= config.max_total_connections) {
+        result = Admission::SERVER_FULL;
+    } else if (!ip_limiter.TryConsume(source, now)) {
+        result = Admission::IP_RATE;
+    } else if (!subnet_limiter.TryConsume(subnet, now)) {
+        result = Admission::SUBNET_RATE;
+    } else if (!connection_limit.TryConsume(connection_tat, now)) {
+        result = Admission::GLOBAL_RATE;
     }
-    
-    connection_timestamps.push_back(now);
-    return true;
+
+    admission_counts[(size_t)result].fetch_add(1, std::memory_order_relaxed);
+    return result;
 }
 
 bool ConnectionManager::AllowMessage(int client_id) {
     if (IsMuted(client_id)) {
         return false;
     }
-    
-    w32::LockGuard lock(message_mutex);
-    auto now = std::chrono::steady_clock::now();
-    auto one_minute_ago = now - std::chrono::minutes(1);
-    
-    auto& timestamps = client_messages[client_id];
-    
-    // Remove old timestamps
-    while (!timestamps.empty() && timestamps.front() < one_minute_ago) {
-        timestamps.pop_front();
-    }
-    
-    return timestamps.size() < (size_t)config.max_messages_per_minute;
+    return message_limiter.TryConsume(client_id);
 }
 
-void ConnectionManager::RecordMessage(int client_id) {
-    w32::LockGuard lock(message_mutex);
-    client_messages[client_id].push_back(std::chrono::steady_clock::now());
-    
-    // Also update activity
-    UpdateActivity(client_id);
-}
+void ConnectionManager::OnConnect(int client_id, std::shared_ptr<ConnectionActivity> record) {
+    current_connections++;
+    if (!record) {
+        record = std::make_shared<ConnectionActivity>();
+    }
 
-bool ConnectionManager::IsBanned(const std::string& ip_address) {
-    w32::LockGuard lock(ban_mutex);
-    return banned_ips.find(ip_address) != banned_ips.end();
+    w32::LockGuard lock(activity_mutex);
+    Activity& entry = activity[client_id];
+    entry.record = std::move(record);
+    if (timers && entry.idle_timer == INVALID_TIMER) {
+        ArmIdleTimer(client_id, entry, std::chrono::seconds(config.connection_timeout_seconds));
+    }
 }
 
-void ConnectionManager::Ban(const std::string& ip_address) {
-    w32::LockGuard lock(ban_mutex);
-    banned_ips.insert(ip_address);
+void ConnectionManager::OnDisconnect(int client_id) {
+    message_limiter.Release(client_id);
+    if (current_connections > 0) {
+        current_connections--;
+    }
+
+    TimerId idle_timer = INVALID_TIMER;
+    {
+        w32::LockGuard lock(activity_mutex);
+        auto it = activity.find(client_id);
+        if (it != activity.end()) {
+            idle_timer = it->second.idle_timer;
+            activity.erase(it);
+        }
+    }
+    Unmute(client_id);
+    if (timers && idle_timer != INVALID_TIMER) {
+        timers->Cancel(idle_timer);
+    }
 }
 
-void ConnectionManager::Unban(const std::string& ip_address) {
-    w32::LockGuard lock(ban_mutex);
-    banned_ips.erase(ip_address);
+void ConnectionManager::ArmIdleTimer(int client_id, Activity& entry,
+                                     std::chrono::steady_clock::duration delay) {
+    entry.idle_timer = timers->Schedule(
+        std::chrono::ceil<std::chrono::milliseconds>(delay),
+        [this, client_id] { CheckIdle(client_id); });
 }
 
-std::vector<int> ConnectionManager::CheckTimeouts(const std::vector<CLIENT_INFO>& clients) {
-    std::vector<int> timed_out;
-    auto now = std::chrono::steady_clock::now();
+void ConnectionManager::CheckIdle(int client_id) {
     auto timeout = std::chrono::seconds(config.connection_timeout_seconds);
-    
-    w32::LockGuard lock(activity_mutex);
-    for (const auto& client : clients) {
-        auto it = last_activity.find(client.id);
-        if (it != last_activity.end()) {
-            if (now - it->second > timeout) {
-                timed_out.push_back(client.id);
-            }
+    {
+        w32::LockGuard lock(activity_mutex);
+        auto it = activity.find(client_id);
+        if (it == activity.end()) {
+            return; // Disconnected meanwhile
         }
+
+        // Active since the timer was set: sleep until the new deadline
+        auto last = it->second.record->LastActivity();
+        auto idle = std::chrono::steady_clock::now() - last;
+        if (idle < timeout) {
+            ArmIdleTimer(client_id, it->second, timeout - idle);
+            return;
+        }
+        it->second.idle_timer = INVALID_TIMER;
+    }
+
+    if (on_timeout) {
+        on_timeout(client_id);
     }
-    
-    return timed_out;
 }
 
 void ConnectionManager::Mute(int client_id, int duration_seconds) {
     w32::LockGuard lock(mute_mutex);
+    MuteEntry& mute = muted_clients[client_id];
+    if (timers && mute.expiry != INVALID_TIMER) {
+        timers->Cancel(mute.expiry);
+        mute.expiry = INVALID_TIMER;
+    }
     if (duration_seconds == 0) {
-        muted_clients[client_id] = std::chrono::steady_clock::time_point::max();
+        mute.until = std::chrono::steady_clock::time_point::max();
     } else {
-        muted_clients[client_id] = std::chrono::steady_clock::now() + std::chrono::seconds(duration_seconds);
+        mute.until = std::chrono::steady_clock::now() + std::chrono::seconds(duration_seconds);
+        if (timers) {
+            mute.expiry = timers->Schedule(std::chrono::seconds(duration_seconds),
+                                           [this, client_id] { ExpireMute(client_id); });
+        }
     }
 }
 
 void ConnectionManager::Unmute(int client_id) {
     w32::LockGuard lock(mute_mutex);
-    muted_clients.erase(client_id);
+    auto it = muted_clients.find(client_id);
+    if (it == muted_clients.end()) {
+        return;
+    }
+    if (timers && it->second.expiry != INVALID_TIMER) {
+        timers->Cancel(it->second.expiry);
+    }
+    muted_clients.erase(it);
+}
+
+void ConnectionManager::ExpireMute(int client_id) {
+    w32::LockGuard lock(mute_mutex);
+    auto it = muted_clients.find(client_id);
+    // A re-mute since may have moved the expiry
+    if (it != muted_clients.end() && std::chrono::steady_clock::now() >= it->second.until) {
+        muted_clients.erase(it);
+    }
 }
 
 bool ConnectionManager::IsMuted(int client_id) {
@@ -116,9 +174,9 @@ bool ConnectionManager::IsMuted(int client_id) {
         return false;
     }
     
-    // Check if mute has expired
-    if (it->second != std::chrono::steady_clock::time_point::max() &&
-        std::chrono::steady_clock::now() > it->second) {
+    // The expiry timer can run up to a tick late
+    if (it->second.until != std::chrono::steady_clock::time_point::max() &&
+        std::chrono::steady_clock::now() > it->second.until) {
         muted_clients.erase(it);
         return false;
     }
@@ -128,5 +186,8 @@ bool ConnectionManager::IsMuted(int client_id) {
 
 void ConnectionManager::UpdateActivity(int client_id) {
     w32::LockGuard lock(activity_mutex);
-    last_activity[client_id] = std::chrono::steady_clock::now();
+    auto it = activity.find(client_id);
+    if (it != activity.end()) {
+        it->second.record->Touch();
+    }
 }
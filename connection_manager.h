@@ -1,18 +1,29 @@
 #ifndef CONNECTION_MANAGER_H
 #define CONNECTION_MANAGER_H
 
+#include "ban_table.h"
+#include "connection_activity.h"
+#include "rate_limiter.h"
 #include "sockutil.h"
+#include "timer_wheel.h"
 #include "win32_compat.h"
 #include <atomic>
 #include <chrono>
-#include <deque>
+#include <functional>
+#include <memory>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 
 /**
  * @brief Manages connection rate limiting, heartbeat, and spam prevention
+ *
+ * Idle timeouts and mute expiry run on a TimerWheel: each client has one
+ * idle timer, set for when it would time out. Liveness lives in the
+ * connection's ConnectionActivity, which the I/O server's read path
+ * updates without a lock; when the timer fires it re-arms itself for the
+ * remaining time if there was activity since, and reports the client
+ * otherwise. No per-message work here and no periodic sweep.
  */
 class ConnectionManager {
 public:
@@ -21,58 +32,108 @@ public:
    */
   struct Config {
     int max_connections_per_second = 50;  // Rate limit for new connections
-    int max_messages_per_minute = 60;     // Spam prevention
+    int max_connections_per_ip_per_minute = 30;      // Per source (IPv6: per /64)
+    int ip_connection_burst = 10;                    // Back-to-back connects per source
+    int max_connections_per_subnet_per_minute = 300; // Per /24 (IPv6: per /48)
+    int subnet_connection_burst = 50;                // Back-to-back connects per subnet
+    int admission_table_size = 16384;     // Sources (and subnets) tracked at once
+    int max_messages_per_minute = 60;     // Spam prevention: sustained rate
+    int message_burst = 10;               // Messages a quiet client may send at once
     int heartbeat_interval_seconds = 30;  // Heartbeat check interval
     int connection_timeout_seconds = 120; // Disconnect if no activity
     int max_total_connections = 1000;     // Maximum concurrent connections
   };
 
-  explicit ConnectionManager(const Config &config);
+  /**
+   * @param timers Runs idle timeouts and mute expiry; without one, clients
+   *        never time out and mutes lapse only when IsMuted looks
+   */
+  explicit ConnectionManager(const Config &config, TimerWheel *timers = nullptr);
   ConnectionManager();
 
+  /**
+   * @brief Called on the timer thread when a client has been idle for
+   *        connection_timeout_seconds; set before clients connect
+   */
+  using TimeoutHandler = std::function<void(int client_id)>;
+  void SetTimeoutHandler(TimeoutHandler handler) { on_timeout = handler; }
+
   // Non-copyable due to mutexes
   ConnectionManager(const ConnectionManager &) = delete;
   ConnectionManager &operator=(const ConnectionManager &) = delete;
 
   /**
-   * @brief Check if a new connection should be allowed
-   * @param ip_address Client IP address
-   * @return true if connection is allowed
+   * @brief Outcome of AdmitConnection; every value but ADMITTED is a
+   *        reject reason
+   */
+  enum class Admission {
+    ADMITTED,
+    BANNED,
+    SERVER_FULL,  // max_total_connections reached
+    IP_RATE,      // Source over its connect rate
+    SUBNET_RATE,  // Source's subnet over its connect rate
+    GLOBAL_RATE,  // max_connections_per_second reached
+  };
+  static constexpr size_t ADMISSION_KINDS = 6;
+
+  static const char *AdmissionName(Admission result);
+
+  /**
+   * @brief Decide whether to take a new connection (accept thread, before
+   *        anything is set up for the socket)
+   *
+   * Checks, in order: the ban table, the connection cap, then token
+   * buckets per source address, per subnet and server-wide. All of it is
+   * lock-free; the outcome is counted either way.
+   * @param address Client address
    */
-  bool AllowConnection(const std::string &ip_address);
+  Admission AdmitConnection(const IpAddress &address);
 
   /**
-   * @brief Check if a client can send a message (rate limiting)
+   * @brief Connections that got this outcome since startup
+   */
+  uint64_t GetAdmissionCount(Admission result) const {
+    return admission_counts[(size_t)result].load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Check and consume one message from the client's rate limit
+   *
+   * A token bucket per client (max_messages_per_minute, message_burst),
+   * taken with one CAS and no lock.
    * @param client_id Client ID
    * @return true if message is allowed
    */
   bool AllowMessage(int client_id);
 
   /**
-   * @brief Record a message from client (for rate limiting)
+   * @brief Check if an address is covered by a ban (no lock)
    */
-  void RecordMessage(int client_id);
+  bool IsBanned(const IpAddress &address) const { return bans.IsBanned(address); }
 
   /**
-   * @brief Check if client is banned
+   * @brief Ban an address or CIDR block
+   * @return false if the ban already exists
    */
-  bool IsBanned(const std::string &ip_address);
+  bool Ban(const IpPrefix &prefix) { return bans.Ban(prefix); }
 
   /**
-   * @brief Ban an IP address
+   * @brief Lift a ban added with exactly this prefix
    */
-  void Ban(const std::string &ip_address);
+  bool Unban(const IpPrefix &prefix) { return bans.Unban(prefix); }
 
   /**
-   * @brief Unban an IP address
+   * @brief Add bans from a blocklist file (see IpBanTable::LoadFile)
+   * @return Bans added, or -1 if the file could not be opened
    */
-  void Unban(const std::string &ip_address);
+  long long LoadBanList(const std::string &path, size_t *rejected = nullptr) {
+    return bans.LoadFile(path, rejected);
+  }
 
   /**
-   * @brief Check for timed-out connections
-   * @return Vector of client IDs that should be disconnected
+   * @brief Number of ban rules
    */
-  std::vector<int> CheckTimeouts(const std::vector<CLIENT_INFO> &clients);
+  size_t GetBanCount() const { return bans.size(); }
 
   /**
    * @brief Mute a client
@@ -90,7 +151,10 @@ public:
   bool IsMuted(int client_id);
 
   /**
-   * @brief Update activity timestamp for a client
+   * @brief Mark a client active outside the read path
+   *
+   * Reads are recorded by the server on the shared activity record; this
+   * is for activity the server does not see.
    */
   void UpdateActivity(int client_id);
 
@@ -100,42 +164,58 @@ public:
   int GetConnectionCount() const { return current_connections; }
 
   /**
-   * @brief Increment connection count (call on new connection)
+   * @brief Count the connection and start its idle timer (call on new
+   *        connection)
+   * @param record The connection's activity record, shared with the
+   *        server that updates it; null tracks only UpdateActivity
    */
-  void OnConnect() { current_connections++; }
+  void OnConnect(int client_id, std::shared_ptr<ConnectionActivity> record = nullptr);
 
   /**
-   * @brief Decrement connection count (call on disconnect)
+   * @brief Uncount the connection and drop its rate limit slot, idle
+   *        timer and mute (call on disconnect)
    */
-  void OnDisconnect() {
-    if (current_connections > 0)
-      current_connections--;
-  }
+  void OnDisconnect(int client_id);
 
 private:
   Config config;
 
   // Rate limiting for connections
-  w32::Mutex rate_mutex;
-  std::deque<std::chrono::steady_clock::time_point> connection_timestamps;
+  GcraLimit connection_limit;
+  std::atomic<int64_t> connection_tat{0};
+  KeyedRateLimiter ip_limiter;
+  KeyedRateLimiter subnet_limiter;
+  std::atomic<uint64_t> admission_counts[ADMISSION_KINDS] = {};
 
   // Message rate limiting per client
-  w32::Mutex message_mutex;
-  std::unordered_map<int, std::deque<std::chrono::steady_clock::time_point>>
-      client_messages;
+  ClientRateLimiter message_limiter;
+
+  // Banned addresses and CIDR blocks
+  IpBanTable bans;
 
-  // Banned IPs
-  w32::Mutex ban_mutex;
-  std::unordered_set<std::string> banned_ips;
+  TimerWheel *timers;
+  TimeoutHandler on_timeout;
 
   // Muted clients (with optional expiry)
+  struct MuteEntry {
+    std::chrono::steady_clock::time_point until; // time_point::max() = permanent
+    TimerId expiry = INVALID_TIMER;
+  };
   w32::Mutex mute_mutex;
-  std::unordered_map<int, std::chrono::steady_clock::time_point>
-      muted_clients; // time_point::max() = permanent
+  std::unordered_map<int, MuteEntry> muted_clients;
 
   // Activity tracking
+  struct Activity {
+    std::shared_ptr<ConnectionActivity> record;
+    TimerId idle_timer = INVALID_TIMER;
+  };
   w32::Mutex activity_mutex;
-  std::unordered_map<int, std::chrono::steady_clock::time_point> last_activity;
+  std::unordered_map<int, Activity> activity;
+
+  void ArmIdleTimer(int client_id, Activity &entry,
+                    std::chrono::steady_clock::duration delay);
+  void CheckIdle(int client_id);
+  void ExpireMute(int client_id);
 
   std::atomic<int> current_connections{0};
 };
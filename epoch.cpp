@@ -0,0 +1,150 @@
+#include "epoch.h"
+#include "win32_compat.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Threads that can be inside a guard at once with a slot of their own;
+// any beyond that share a counter that holds the epoch still while set
+constexpr size_t MAX_READERS = 256;
+
+// 0 in a slot means "not reading"
+std::atomic<uint64_t> global_epoch{1};
+
+struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> owned{false};
+};
+
+ReaderSlot reader_slots[MAX_READERS];
+std::atomic<size_t> slots_used{0};          // High-water mark; bounds scans
+std::atomic<uint32_t> overflow_readers{0};
+
+struct Retired {
+    void* object;
+    void (*deleter)(void*);
+    uint64_t epoch;
+};
+
+struct RetireList {
+    w32::Mutex mutex;
+    std::vector<Retired> items;
+
+    // At exit nothing reads any more
+    ~RetireList() {
+        for (const Retired& item : items) {
+            item.deleter(item.object);
+        }
+    }
+};
+
+RetireList& Retirees() {
+    static RetireList list;
+    return list;
+}
+
+// Per-thread slot, released when the thread exits
+struct ThreadReader {
+    ReaderSlot* slot = nullptr;
+    uint32_t depth = 0;
+
+    ~ThreadReader() {
+        if (slot) {
+            slot->epoch.store(0, std::memory_order_release);
+            slot->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadReader this_reader;
+
+ReaderSlot* ClaimSlot() {
+    for (size_t i = 0; i < MAX_READERS; ++i) {
+        ReaderSlot& slot = reader_slots[i];
+        bool expected = false;
+        if (!slot.owned.load(std::memory_order_relaxed) &&
+            slot.owned.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            size_t used = slots_used.load(std::memory_order_relaxed);
+            while (used < i + 1 &&
+                   !slots_used.compare_exchange_weak(used, i + 1, std::memory_order_acq_rel)) {
+            }
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+// Move the epoch on if every active reader has seen the current one
+bool TryAdvance() {
+    uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (overflow_readers.load(std::memory_order_seq_cst) != 0) {
+        return false;
+    }
+    size_t used = slots_used.load(std::memory_order_acquire);
+    for (size_t i = 0; i < used; ++i) {
+        uint64_t seen = reader_slots[i].epoch.load(std::memory_order_seq_cst);
+        if (seen != 0 && seen != epoch) {
+            return false;
+        }
+    }
+    return global_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+}
+
+} // namespace
+
+EpochGuard::EpochGuard() {
+    ThreadReader& reader = this_reader;
+    if (reader.depth++ > 0) {
+        return;
+    }
+    if (!reader.slot) {
+        reader.slot = ClaimSlot();
+    }
+    if (reader.slot) {
+        reader.slot->epoch.store(global_epoch.load(std::memory_order_seq_cst),
+                                 std::memory_order_seq_cst);
+    } else {
+        overflow_readers.fetch_add(1, std::memory_order_seq_cst);
+    }
+    // The announcement must be visible before any published pointer is read
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+EpochGuard::~EpochGuard() {
+    ThreadReader& reader = this_reader;
+    if (--reader.depth > 0) {
+        return;
+    }
+    if (reader.slot) {
+        reader.slot->epoch.store(0, std::memory_order_release);
+    } else {
+        overflow_readers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void Epoch::RetireRaw(void* object, void (*deleter)(void*)) {
+    std::vector<Retired> ready;
+    {
+        RetireList& list = Retirees();
+        w32::LockGuard lock(list.mutex);
+        list.items.push_back(Retired{object, deleter, global_epoch.load(std::memory_order_seq_cst)});
+
+        // Two steps free everything when no reader is active
+        TryAdvance() && TryAdvance();
+
+        uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+        auto keep = std::partition(list.items.begin(), list.items.end(),
+                                   [epoch](const Retired& item) { return item.epoch + 2 > epoch; });
+        ready.assign(keep, list.items.end());
+        list.items.erase(keep, list.items.end());
+    }
+
+    // Destructors run outside the lock
+    for (const Retired& item : ready) {
+        item.deleter(item.object);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+/**
+ * @brief Reader section for data published through a raw atomic pointer
+ *
+ * Epoch-based reclamation: a reader announces the current global epoch
+ * in its own cache line (one store and a fence, no lock, no shared write)
+ * and may dereference anything it loads until the guard ends. Writers
+ * swap a new object in and hand the old one to Epoch::Retire, which frees
+ * it only once every reader that could have loaded it has left.
+ *
+ * Guards nest and are cheap, but must not be held across blocking calls:
+ * a stalled reader delays reclamation (never correctness).
+ */
+class EpochGuard {
+public:
+    EpochGuard();
+    ~EpochGuard();
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+/**
+ * @brief Deferred frees for objects unpublished from a raw atomic pointer
+ *
+ * An object retired while the global epoch is E is freed once the epoch
+ * reaches E + 2; the epoch advances only when every active reader has
+ * announced the current one. Reclamation runs on the retiring thread, so
+ * garbage waits for the next Retire; readers never free anything.
+ */
+class Epoch {
+public:
+    /**
+     * @brief Free `object` once no reader can still be using it
+     *
+     * The caller must already have unpublished it.
+     */
+    template <typename T>
+    static void Retire(const T* object) {
+        RetireRaw(const_cast<T*>(object), [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    static void RetireRaw(void* object, void (*deleter)(void*));
+};
+
+#endif // EPOCH_H
@@ -0,0 +1,582 @@
+#include "epoll_server.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace {
+
+// epoll_data keys: client ids start at 1, so 0 and ~0 are free
+constexpr uint64_t WAKE_KEY = 0;
+constexpr uint64_t LISTEN_KEY = ~0ULL;
+
+bool AddToEpoll(int epfd, int fd, uint32_t events, uint64_t key) {
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = key;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+} // namespace
+
+EpollServer::EpollServer(int port, ThreadPool& pool)
+    : accept_epoll_fd(-1)
+    , wake_fd(-1)
+    , listen_socket(INVALID_SOCKET)
+    , thread_pool(pool)
+    , port_(port)
+{
+}
+
+EpollServer::~EpollServer() {
+    Stop();
+}
+
+bool EpollServer::Start() {
+    // Create listen socket
+    listen_socket = CreateListenSocket(port_);
+    if (listen_socket == INVALID_SOCKET) {
+        std::cerr << "[Epoll] Failed to create listen socket" << std::endl;
+        return false;
+    }
+    SetSocketNonBlocking(listen_socket);
+
+    // Level-triggered and never drained, so one write wakes every reactor
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        std::cerr << "[Epoll] eventfd failed: " << errno << std::endl;
+        closesocket(listen_socket);
+        listen_socket = INVALID_SOCKET;
+        return false;
+    }
+
+    accept_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (accept_epoll_fd < 0 ||
+        !AddToEpoll(accept_epoll_fd, listen_socket, EPOLLIN, LISTEN_KEY) ||
+        !AddToEpoll(accept_epoll_fd, wake_fd, EPOLLIN, WAKE_KEY)) {
+        std::cerr << "[Epoll] Failed to set up accept epoll: " << errno << std::endl;
+        Stop();
+        return false;
+    }
+
+    // One reactor per CPU core
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    int num_workers = sys_info.dwNumberOfProcessors;
+    if (num_workers == 0) num_workers = 1;
+
+    for (int i = 0; i < num_workers; ++i) {
+        int epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0 || !AddToEpoll(epfd, wake_fd, EPOLLIN, WAKE_KEY)) {
+            std::cerr << "[Epoll] epoll_create1 failed: " << errno << std::endl;
+            if (epfd >= 0) close(epfd);
+            Stop();
+            return false;
+        }
+        epoll_fds.push_back(epfd);
+    }
+
+    running.store(true);
+
+    std::cout << "[Epoll] Starting " << num_workers << " reactor threads" << std::endl;
+
+    for (int i = 0; i < num_workers; ++i) {
+        io_workers.push_back(w32::Thread([this, i] { ReactorThread(i); }));
+        // One reactor per core: keep each on its own CPU so its epoll set
+        // and connection state stay cache-warm
+        io_workers.back().SetName(("epoll-" + std::to_string(i)).c_str());
+        io_workers.back().SetAffinity(i);
+    }
+
+    accept_thread = w32::Thread(&EpollServer::AcceptConnections, this);
+    accept_thread.SetName("epoll-accept");
+
+    std::cout << "[Epoll] Server started on port " << port_ << std::endl;
+    return true;
+}
+
+void EpollServer::Stop() {
+    w32::LockGuard lifecycle(lifecycle_mutex);
+    bool was_running = running.exchange(false);
+
+    // Wake up reactor and accept threads
+    if (wake_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    if (accept_thread.joinable()) {
+        accept_thread.join();
+    }
+    for (auto& worker : io_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    io_workers.clear();
+
+    // Close listen socket
+    if (listen_socket != INVALID_SOCKET) {
+        closesocket(listen_socket);
+        listen_socket = INVALID_SOCKET;
+    }
+
+    // Drop all client connections (sockets close with the last reference)
+    {
+        w32::LockGuard lock(clients_mutex);
+        for (auto& pair : clients) {
+            pair.second->closing.store(true);
+            shutdown(pair.second->info.socket, SHUT_RDWR);
+        }
+        clients.clear();
+    }
+
+    for (int epfd : epoll_fds) {
+        close(epfd);
+    }
+    epoll_fds.clear();
+    if (accept_epoll_fd >= 0) {
+        close(accept_epoll_fd);
+        accept_epoll_fd = -1;
+    }
+    if (wake_fd >= 0) {
+        close(wake_fd);
+        wake_fd = -1;
+    }
+
+    if (was_running) {
+        std::cout << "[Epoll] Server stopped" << std::endl;
+    }
+}
+
+void EpollServer::ReactorThread(int index) {
+    int epfd = epoll_fds[index];
+    epoll_event events[MAX_EPOLL_EVENTS];
+    std::vector<char> buffer(MAX_LEN); // Shared by every socket on this reactor
+
+    while (running.load()) {
+        int count = epoll_wait(epfd, events, MAX_EPOLL_EVENTS, 1000);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "[Epoll] epoll_wait failed: " << errno << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count && running.load(); ++i) {
+            uint64_t key = events[i].data.u64;
+            if (key == WAKE_KEY) {
+                continue; // Shutdown signal, loop condition handles it
+            }
+
+            auto conn = FindConnection((int)key);
+            if (!conn) {
+                continue;
+            }
+
+            uint32_t flags = events[i].events;
+            if (flags & EPOLLOUT) {
+                HandleWrite(conn);
+            }
+            if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                HandleRead(conn, buffer.data());
+            }
+        }
+    }
+}
+
+void EpollServer::AcceptConnections() {
+    std::cout << "[Epoll] Accept thread started" << std::endl;
+
+    epoll_event events[2];
+    while (running.load()) {
+        int count = epoll_wait(accept_epoll_fd, events, 2, 1000);
+        if (count < 0 && errno != EINTR) {
+            std::cerr << "[Epoll] Accept wait failed: " << errno << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.u64 != LISTEN_KEY) {
+                continue;
+            }
+
+            // Drain the backlog
+            while (running.load()) {
+                sockaddr_storage client_addr;
+                socklen_t addr_len = sizeof(client_addr);
+                SOCKET client_socket = accept4(listen_socket, (sockaddr*)&client_addr,
+                                               &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (client_socket == INVALID_SOCKET) {
+                    int error = errno;
+                    if (error != EAGAIN && error != EWOULDBLOCK && error != EINTR) {
+                        std::cerr << "[Epoll] Accept failed: " << error << std::endl;
+                    }
+                    break;
+                }
+
+                // Screen before a connection object or reactor slot exists
+                IpAddress address;
+                IpAddress::FromSockaddr((const sockaddr*)&client_addr, address);
+                if (accept_filter && !accept_filter(address)) {
+                    closesocket(client_socket);
+                    continue;
+                }
+
+                HandleAccept(client_socket, address);
+            }
+        }
+    }
+
+    std::cout << "[Epoll] Accept thread stopped" << std::endl;
+}
+
+void EpollServer::HandleAccept(SOCKET client_socket, const IpAddress& address) {
+    int client_id = next_client_id.fetch_add(1);
+
+    auto conn = std::make_shared<EPOLL_CONNECTION>();
+    conn->strand = std::make_shared<Strand>(thread_pool);
+    conn->info.id = client_id;
+    conn->info.socket = client_socket;
+    conn->info.state = ClientState::CONNECTED;
+    conn->info.connected_at = std::chrono::steady_clock::now();
+    conn->info.activity = std::make_shared<ConnectionActivity>(conn->info.connected_at);
+    conn->info.ip_address = GetSocketAddress(client_socket);
+    conn->info.address = address;
+    conn->info.name = "anonymous";
+    conn->info.current_room = "general";
+    conn->reactor = (int)(next_reactor.fetch_add(1) % epoll_fds.size());
+
+    {
+        w32::LockGuard lock(clients_mutex);
+        clients[client_id] = conn;
+    }
+
+    std::cout << "[Epoll] New client " << client_id << " from "
+              << conn->info.ip_address << std::endl;
+
+    // Trigger connect callback
+    if (on_connect) {
+        conn->strand->post([this, client_id, client_socket]() {
+            on_connect(client_id, client_socket);
+        });
+    }
+
+    // EPOLLOUT stays armed: with edge triggering it only fires when the send
+    // buffer drains, which is exactly when a pending backlog can be flushed.
+    if (!AddToEpoll(epoll_fds[conn->reactor], client_socket,
+                    EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, (uint64_t)client_id)) {
+        std::cerr << "[Epoll] Failed to register client socket: " << errno << std::endl;
+        CleanupClient(client_id);
+    }
+}
+
+void EpollServer::HandleRead(const std::shared_ptr<EPOLL_CONNECTION>& conn, char* buffer) {
+    int client_id = conn->info.id;
+    int chunks = 0;
+    size_t bytes_read = 0;
+    bool disconnected = false;
+    std::string batch;
+
+    // Edge-triggered: read until the socket is drained
+    while (!conn->closing.load()) {
+        ssize_t bytes = recv(conn->info.socket, buffer, MAX_LEN, 0);
+        if (bytes > 0) {
+            ++chunks;
+            bytes_read += (size_t)bytes;
+            if (!conn->decoder.Feed(buffer, (size_t)bytes, batch)) {
+                std::cerr << "[Epoll] Framing error from client " << client_id << std::endl;
+                disconnected = true;
+                break;
+            }
+            // First bytes fix the mode: release what was held for it
+            conn->decoder.Publish([&](SharedBuffer frame) { PostWrite(conn, std::move(frame)); });
+            // Bound one dispatch when a client streams faster than we drain
+            if (batch.size() >= MAX_FRAME_SIZE) {
+                DispatchFrames(conn, batch);
+            }
+            continue;
+        }
+
+        if (bytes == 0) {
+            // Client disconnected gracefully
+            std::cout << "[Epoll] Client " << client_id << " disconnected" << std::endl;
+            disconnected = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            std::cerr << "[Epoll] I/O error for client " << client_id
+                      << ": " << errno << std::endl;
+            disconnected = true;
+        }
+        break;
+    }
+
+    // Everything pipelined in this wakeup goes out as one strand task
+    if (!batch.empty()) {
+        DispatchFrames(conn, batch);
+    }
+
+    // Update last activity; the record is the connection's own, no lock
+    if (chunks > 0) {
+        conn->info.activity->RecordRead((uint32_t)chunks, bytes_read);
+    }
+
+    if (disconnected) {
+        CleanupClient(client_id);
+    }
+}
+
+void EpollServer::DispatchFrames(const std::shared_ptr<EPOLL_CONNECTION>& conn, std::string& batch) {
+    if (on_message) {
+        int client_id = conn->info.id;
+        FrameMode mode = conn->decoder.mode();
+        conn->strand->post([this, client_id, mode, batch = std::move(batch)]() {
+            ForEachFrame(mode, batch.data(), batch.size(), [&](const char* frame, size_t length) {
+                on_message(client_id, frame, (int)length);
+            });
+        });
+    }
+    batch.clear();
+}
+
+void EpollServer::HandleWrite(const std::shared_ptr<EPOLL_CONNECTION>& conn) {
+    if (conn->outbound.OnWritable()) {
+        FlushWrites(conn);
+    }
+}
+
+bool EpollServer::PostWrite(const std::shared_ptr<EPOLL_CONNECTION>& conn, SharedBuffer data) {
+    if (data.empty()) {
+        return true;
+    }
+    if (conn->closing.load()) {
+        return false;
+    }
+
+    switch (conn->outbound.Push(std::move(data))) {
+    case OutboundQueue::PushResult::START_WRITE:
+        return FlushWrites(conn);
+    case OutboundQueue::PushResult::QUEUED:
+        return true;
+    case OutboundQueue::PushResult::BACKLOG_FULL:
+        break;
+    }
+
+    std::cerr << "[Epoll] Client " << conn->info.id
+              << " send backlog exceeded, dropping" << std::endl;
+    CleanupClient(conn->info.id);
+    return false;
+}
+
+bool EpollServer::FlushWrites(const std::shared_ptr<EPOLL_CONNECTION>& conn) {
+    OutboundSegment segments[MAX_SEND_SEGMENTS];
+    iovec iov[MAX_SEND_SEGMENTS];
+
+    // We are the queue's only writer until Gather drains it or we park
+    for (;;) {
+        if (conn->closing.load()) {
+            conn->outbound.Abort();
+            return false;
+        }
+
+        size_t count = conn->outbound.Gather(segments, MAX_SEND_SEGMENTS);
+        if (count == 0) {
+            return true;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = const_cast<char*>(segments[i].data);
+            iov[i].iov_len = segments[i].length;
+        }
+
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t sent = sendmsg(conn->info.socket, &msg, MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn->outbound.Consume((size_t)sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Kernel buffer full: EPOLLOUT resumes the flush
+            if (conn->outbound.Park()) {
+                continue;
+            }
+            return true;
+        }
+
+        std::cerr << "[Epoll] send failed: " << errno << std::endl;
+        conn->outbound.Abort();
+        CleanupClient(conn->info.id);
+        return false;
+    }
+}
+
+std::shared_ptr<EPOLL_CONNECTION> EpollServer::FindConnection(int client_id) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it == clients.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void EpollServer::CleanupClient(int client_id) {
+    std::shared_ptr<EPOLL_CONNECTION> conn;
+
+    {
+        w32::LockGuard lock(clients_mutex);
+        auto it = clients.find(client_id);
+        if (it != clients.end()) {
+            conn = it->second;
+            clients.erase(it);
+        }
+    }
+
+    if (!conn) {
+        return; // Already cleaned up
+    }
+
+    conn->closing.store(true);
+    if (conn->reactor < (int)epoll_fds.size()) {
+        epoll_ctl(epoll_fds[conn->reactor], EPOLL_CTL_DEL, conn->info.socket, NULL);
+    }
+    shutdown(conn->info.socket, SHUT_RDWR);
+
+    // Trigger disconnect callback
+    if (on_disconnect) {
+        conn->strand->post([this, client_id]() {
+            on_disconnect(client_id);
+        });
+    }
+}
+
+bool EpollServer::Send(int client_id, const char* message, int length) {
+    auto conn = FindConnection(client_id);
+    if (!conn) {
+        return false;
+    }
+
+    if (length <= 0) {
+        return true;
+    }
+    SharedBuffer payload = SharedBuffer::Copy(message, (size_t)length);
+    if (conn->decoder.Hold(payload)) {
+        return true; // Mode not known yet
+    }
+    return PostWrite(conn, EncodeFrame(conn->decoder.mode(), payload));
+}
+
+void EpollServer::Broadcast(const char* message, int length, int exclude_id) {
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<EPOLL_CONNECTION>> targets;
+    {
+        w32::LockGuard lock(clients_mutex);
+        targets.reserve(clients.size());
+        for (const auto& pair : clients) {
+            if (pair.first != exclude_id) {
+                targets.push_back(pair.second);
+            }
+        }
+    }
+
+    FanOut(targets, SharedBuffer::Copy(message, (size_t)length));
+}
+
+void EpollServer::Multicast(const std::vector<int>& client_ids, const SharedBuffer& payload,
+                            int exclude_id) {
+    if (payload.empty()) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<EPOLL_CONNECTION>> targets;
+    {
+        w32::LockGuard lock(clients_mutex);
+        targets.reserve(client_ids.size());
+        for (int client_id : client_ids) {
+            if (client_id == exclude_id) {
+                continue;
+            }
+            auto it = clients.find(client_id);
+            if (it != clients.end()) {
+                targets.push_back(it->second);
+            }
+        }
+    }
+
+    FanOut(targets, payload);
+}
+
+void EpollServer::FanOut(const std::vector<std::shared_ptr<EPOLL_CONNECTION>>& targets,
+                         const SharedBuffer& payload) {
+    SharedBuffer binary_frame; // Encoded once, on first binary-mode target
+    for (const auto& conn : targets) {
+        if (conn->decoder.Hold(payload)) {
+            continue;
+        }
+        if (conn->decoder.mode() == FrameMode::BINARY) {
+            if (binary_frame.empty()) {
+                binary_frame = EncodeFrame(FrameMode::BINARY, payload);
+            }
+            PostWrite(conn, binary_frame);
+        } else {
+            PostWrite(conn, payload);
+        }
+    }
+}
+
+void EpollServer::DisconnectClient(int client_id) {
+    CleanupClient(client_id);
+}
+
+CLIENT_INFO* EpollServer::GetClient(int client_id) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it != clients.end()) {
+        return &it->second->info;
+    }
+    return nullptr;
+}
+
+bool EpollServer::GetClientAddress(int client_id, IpAddress& address) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it != clients.end()) {
+        address = it->second->info.address;
+        return true;
+    }
+    return false;
+}
+
+std::shared_ptr<ConnectionActivity> EpollServer::GetClientActivity(int client_id) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it != clients.end()) {
+        return it->second->info.activity;
+    }
+    return nullptr;
+}
+
+std::vector<CLIENT_INFO> EpollServer::GetAllClients() {
+    w32::LockGuard lock(clients_mutex);
+    std::vector<CLIENT_INFO> result;
+    result.reserve(clients.size());
+    for (const auto& pair : clients) {
+        result.push_back(pair.second->info);
+    }
+    return result;
+}
@@ -0,0 +1,195 @@
+#ifndef EPOLL_SERVER_H
+#define EPOLL_SERVER_H
+
+#include "framing.h"
+#include "outbound_queue.h"
+#include "sockutil.h"
+#include "strand.h"
+#include "thread_pool.h"
+#include "win32_compat.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Max events drained per epoll_wait call
+constexpr int MAX_EPOLL_EVENTS = 256;
+
+/**
+ * @brief Per-connection state for the epoll backend
+ *
+ * Kept small on purpose: idle connections own no read buffer (reads go
+ * through a per-reactor scratch buffer) and queued output is released as
+ * soon as the kernel accepts it.
+ */
+struct EPOLL_CONNECTION {
+    CLIENT_INFO info;
+    int reactor = 0;                // Index of the epoll instance owning the socket
+    std::shared_ptr<Strand> strand; // Serializes this client's callbacks
+    FrameDecoder decoder;           // Touched only by the owning reactor
+    OutboundQueue outbound;         // Messages the kernel has not accepted yet
+    std::atomic<bool> closing{false};
+
+    // The descriptor is only closed once the last reference is gone, so a
+    // reactor still holding the connection can never see a reused fd.
+    ~EPOLL_CONNECTION() {
+        if (info.socket != INVALID_SOCKET) {
+            closesocket(info.socket);
+        }
+    }
+};
+
+/**
+ * @brief Edge-triggered epoll server for Linux
+ *
+ * Drop-in replacement for IOCPServer: same public surface and callback
+ * semantics. Connections are spread round-robin over one epoll instance
+ * per CPU core, each drained by its own reactor thread.
+ */
+class EpollServer {
+public:
+    using MessageHandler = std::function<void(int client_id, const char* message, int length)>;
+    using ConnectHandler = std::function<void(int client_id, SOCKET socket)>;
+    using DisconnectHandler = std::function<void(int client_id)>;
+    using AcceptFilter = std::function<bool(const IpAddress& address)>;
+
+    /**
+     * @brief Construct epoll server
+     * @param port Port to listen on
+     * @param pool Reference to thread pool
+     */
+    EpollServer(int port, ThreadPool& pool);
+
+    /**
+     * @brief Destructor
+     */
+    ~EpollServer();
+
+    // Non-copyable
+    EpollServer(const EpollServer&) = delete;
+    EpollServer& operator=(const EpollServer&) = delete;
+
+    /**
+     * @brief Start the server
+     * @return true if started successfully
+     */
+    bool Start();
+
+    /**
+     * @brief Stop the server
+     */
+    void Stop();
+
+    /**
+     * @brief Check if server is running
+     */
+    bool IsRunning() const { return running.load(); }
+
+    /**
+     * @brief Send message to specific client
+     */
+    bool Send(int client_id, const char* message, int length);
+
+    /**
+     * @brief Send message to all clients except sender
+     */
+    void Broadcast(const char* message, int length, int exclude_id = -1);
+
+    /**
+     * @brief Send one shared payload to each listed client
+     *
+     * Recipients share the payload's bytes; binary-mode clients share one
+     * framed copy. Nothing is copied per recipient.
+     */
+    void Multicast(const std::vector<int>& client_ids, const SharedBuffer& payload,
+                   int exclude_id = -1);
+
+    /**
+     * @brief Disconnect a client
+     */
+    void DisconnectClient(int client_id);
+
+    /**
+     * @brief Get client info
+     */
+    CLIENT_INFO* GetClient(int client_id);
+
+    /**
+     * @brief Copy a client's address, or return false if it is gone
+     *
+     * The copy stays valid if the client disconnects, unlike GetClient.
+     */
+    bool GetClientAddress(int client_id, IpAddress& address);
+
+    /**
+     * @brief Get a client's activity record, or null if it is gone
+     *
+     * The record outlives the connection for as long as a holder keeps it.
+     */
+    std::shared_ptr<ConnectionActivity> GetClientActivity(int client_id);
+
+    /**
+     * @brief Get all connected clients
+     */
+    std::vector<CLIENT_INFO> GetAllClients();
+
+    /**
+     * @brief Set event handlers
+     */
+    void OnMessage(MessageHandler handler) { on_message = handler; }
+    void OnConnect(ConnectHandler handler) { on_connect = handler; }
+    void OnDisconnect(DisconnectHandler handler) { on_disconnect = handler; }
+
+    /**
+     * @brief Screen new connections on the accept thread, before any
+     *        client state exists; returning false closes the socket
+     */
+    void OnAccept(AcceptFilter filter) { accept_filter = filter; }
+
+private:
+    // Core components
+    std::vector<int> epoll_fds;   // One per reactor thread
+    int accept_epoll_fd;
+    int wake_fd;                  // eventfd signalled by Stop()
+    SOCKET listen_socket;
+    ThreadPool& thread_pool;
+
+    // State
+    std::atomic<bool> running{false};
+    std::atomic<int> next_client_id{1};
+    std::atomic<unsigned> next_reactor{0};
+    w32::Mutex lifecycle_mutex;   // Serializes Stop() from signal thread and destructor
+
+    // Client management
+    std::unordered_map<int, std::shared_ptr<EPOLL_CONNECTION>> clients;
+    w32::Mutex clients_mutex;
+
+    // Reactor and accept threads
+    std::vector<w32::Thread> io_workers;
+    w32::Thread accept_thread;
+
+    // Event handlers
+    MessageHandler on_message;
+    ConnectHandler on_connect;
+    DisconnectHandler on_disconnect;
+    AcceptFilter accept_filter;
+
+    // Internal methods
+    void ReactorThread(int index);
+    void AcceptConnections();
+    void HandleAccept(SOCKET client_socket, const IpAddress& address);
+    void HandleRead(const std::shared_ptr<EPOLL_CONNECTION>& conn, char* buffer);
+    void FanOut(const std::vector<std::shared_ptr<EPOLL_CONNECTION>>& targets, const SharedBuffer& payload);
+    void DispatchFrames(const std::shared_ptr<EPOLL_CONNECTION>& conn, std::string& batch);
+    void HandleWrite(const std::shared_ptr<EPOLL_CONNECTION>& conn);
+    bool PostWrite(const std::shared_ptr<EPOLL_CONNECTION>& conn, SharedBuffer data);
+    bool FlushWrites(const std::shared_ptr<EPOLL_CONNECTION>& conn);
+    std::shared_ptr<EPOLL_CONNECTION> FindConnection(int client_id);
+    void CleanupClient(int client_id);
+
+    int port_;
+};
+
+#endif // EPOLL_SERVER_H
@@ -0,0 +1,120 @@
+#include "framing.h"
+
+namespace {
+
+const char* FindLastNewline(const char* data, size_t length) {
+    for (size_t i = length; i > 0; --i) {
+        if (data[i - 1] == '\n') {
+            return data + i - 1;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+size_t FrameDecoder::CompletePrefix(const char* data, size_t length, bool& ok) const {
+    ok = true;
+
+    if (parse_mode == FrameMode::TEXT) {
+        const char* last = FindLastNewline(data, length);
+        size_t complete = last ? (size_t)(last - data) + 1 : 0;
+        if (length - complete > MAX_FRAME_SIZE) {
+            ok = false; // Unterminated line over the limit
+        }
+        return complete;
+    }
+
+    size_t pos = 0;
+    while (length - pos >= FRAME_HEADER_SIZE) {
+        const unsigned char* h = reinterpret_cast<const unsigned char*>(data + pos);
+        size_t size = ((size_t)h[0] << 24) | ((size_t)h[1] << 16) |
+                      ((size_t)h[2] << 8) | (size_t)h[3];
+        if (size > MAX_FRAME_SIZE) {
+            ok = false;
+            return pos;
+        }
+        if (length - pos < FRAME_HEADER_SIZE + size) {
+            break;
+        }
+        pos += FRAME_HEADER_SIZE + size;
+    }
+    return pos;
+}
+
+bool FrameDecoder::Feed(const char* data, size_t length, std::string& batch) {
+    if (length == 0) {
+        return true;
+    }
+
+    if (parse_mode == FrameMode::DETECT) {
+        if ((unsigned char)data[0] == FRAME_BINARY_PREAMBLE) {
+            parse_mode = FrameMode::BINARY;
+            ++data;
+            --length;
+        } else {
+            parse_mode = FrameMode::TEXT;
+        }
+    }
+
+    bool ok;
+    if (partial.empty()) {
+        // Common case: frames aligned to the chunk; no copy into the decoder
+        size_t complete = CompletePrefix(data, length, ok);
+        batch.append(data, complete);
+        partial.assign(data + complete, length - complete);
+        return ok;
+    }
+
+    partial.append(data, length);
+    size_t complete = CompletePrefix(partial.data(), partial.size(), ok);
+    if (complete > 0) {
+        batch.append(partial, 0, complete);
+        partial.erase(0, complete);
+    }
+    return ok;
+}
+
+bool FrameDecoder::Hold(const SharedBuffer& payload) {
+    if (mode() != FrameMode::DETECT) {
+        return false;
+    }
+    w32::LockGuard lock(hold_mutex);
+    if (mode_.load(std::memory_order_relaxed) != FrameMode::DETECT) {
+        return false;
+    }
+    if (held_bytes + payload.size() <= MAX_HELD_OUTBOUND) {
+        held.push_back(payload);
+        held_bytes += payload.size();
+    }
+    return true;
+}
+
+SharedBuffer FrameDecoder::EncodeHeld(const SharedBuffer& payload) const {
+    return EncodeFrame(parse_mode, payload);
+}
+
+std::string EncodeFrame(FrameMode mode, const char* data, size_t length) {
+    if (mode != FrameMode::BINARY) {
+        return std::string(data, length);
+    }
+
+    if (length > 0 && data[length - 1] == '\n') {
+        --length;
+    }
+    std::string frame;
+    frame.reserve(FRAME_HEADER_SIZE + length);
+    frame += (char)((length >> 24) & 0xFF);
+    frame += (char)((length >> 16) & 0xFF);
+    frame += (char)((length >> 8) & 0xFF);
+    frame += (char)(length & 0xFF);
+    frame.append(data, length);
+    return frame;
+}
+
+SharedBuffer EncodeFrame(FrameMode mode, const SharedBuffer& payload) {
+    if (mode != FrameMode::BINARY) {
+        return payload;
+    }
+    return SharedBuffer::Copy(EncodeFrame(mode, payload.data(), payload.size()));
+}
@@ -0,0 +1,158 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include "shared_buffer.h"
+#include "win32_compat.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Largest accepted frame payload (text line or binary frame)
+constexpr size_t MAX_FRAME_SIZE = 64 * 1024;
+
+// First byte a client sends to select length-prefixed binary framing.
+// 0xFF never occurs in UTF-8 text, so text clients cannot trigger it.
+constexpr unsigned char FRAME_BINARY_PREAMBLE = 0xFF;
+
+// Binary frames: 4-byte big-endian payload length, then the payload
+constexpr size_t FRAME_HEADER_SIZE = 4;
+
+// Outbound bytes held for a connection whose mode is not known yet; a
+// client that stays silent past this misses the overflow
+constexpr size_t MAX_HELD_OUTBOUND = 64 * 1024;
+
+enum class FrameMode : uint8_t {
+    DETECT,     // No bytes seen yet
+    TEXT,       // Newline-delimited lines ("\r\n" accepted)
+    BINARY      // Length-prefixed frames
+};
+
+/**
+ * @brief Per-connection incremental frame decoder
+ *
+ * Fed with raw recv() chunks in arrival order by the single thread that
+ * owns the connection's reads. Complete frames are appended to a batch
+ * verbatim (still delimited/prefixed) so one recv carrying many pipelined
+ * messages becomes one dispatch; ForEachFrame() walks a batch on the
+ * handler side. Only an incomplete tail is ever copied into the decoder.
+ *
+ * Nothing may go out before the mode is known: a binary client would
+ * read unframed text as a frame header. Senders Hold() payloads while
+ * the mode is DETECT; the reader calls Publish() after every Feed(),
+ * which encodes and hands over the held payloads before making the mode
+ * visible, so later sends queue behind them.
+ */
+class FrameDecoder {
+public:
+    /**
+     * @brief Consume received bytes
+     * @param batch Receives every frame completed by this chunk
+     * @return false on a protocol violation (oversized frame); the
+     *         connection should be dropped
+     */
+    bool Feed(const char* data, size_t length, std::string& batch);
+
+    /**
+     * @brief Make a mode detected by Feed() visible to senders (reader,
+     *        right after Feed)
+     *
+     * Each payload held meanwhile is encoded for the new mode and passed
+     * to send(SharedBuffer) first, in order, under the hold lock.
+     */
+    template <typename Fn>
+    void Publish(Fn&& send) {
+        // Only the reader stores the mode, so the relaxed check is exact
+        if (parse_mode == FrameMode::DETECT ||
+            mode_.load(std::memory_order_relaxed) != FrameMode::DETECT) {
+            return;
+        }
+        w32::LockGuard lock(hold_mutex);
+        for (const SharedBuffer& payload : held) {
+            send(EncodeHeld(payload));
+        }
+        held.clear();
+        held.shrink_to_fit();
+        mode_.store(parse_mode, std::memory_order_release);
+    }
+
+    /**
+     * @brief Keep an outbound payload until the mode is published (any
+     *        thread)
+     * @return false once the mode is known: encode and send as usual
+     */
+    bool Hold(const SharedBuffer& payload);
+
+    /**
+     * @brief Mode published to senders (any thread); DETECT until the
+     *        first bytes arrive and Publish() runs
+     */
+    FrameMode mode() const { return mode_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Bytes buffered for an incomplete frame
+     */
+    size_t buffered() const { return partial.size(); }
+
+private:
+    size_t CompletePrefix(const char* data, size_t length, bool& ok) const;
+    SharedBuffer EncodeHeld(const SharedBuffer& payload) const;
+
+    std::atomic<FrameMode> mode_{FrameMode::DETECT};
+    FrameMode parse_mode = FrameMode::DETECT;   // Reader-only; ahead of mode_ until Publish
+    std::string partial;
+
+    // Outbound payloads sent while the mode was unknown
+    w32::Mutex hold_mutex;
+    std::vector<SharedBuffer> held;
+    size_t held_bytes = 0;
+};
+
+/**
+ * @brief Invoke fn(payload, length) for each frame in a decoded batch
+ */
+template <typename Fn>
+void ForEachFrame(FrameMode mode, const char* data, size_t length, Fn&& fn) {
+    const char* end = data + length;
+    if (mode == FrameMode::BINARY) {
+        while ((size_t)(end - data) >= FRAME_HEADER_SIZE) {
+            const unsigned char* h = reinterpret_cast<const unsigned char*>(data);
+            size_t size = ((size_t)h[0] << 24) | ((size_t)h[1] << 16) |
+                          ((size_t)h[2] << 8) | (size_t)h[3];
+            fn(data + FRAME_HEADER_SIZE, size);
+            data += FRAME_HEADER_SIZE + size;
+        }
+        return;
+    }
+
+    while (data < end) {
+        const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+        const char* line_end = newline ? newline : end;
+        size_t size = line_end - data;
+        if (size > 0 && data[size - 1] == '\r') {
+            --size;
+        }
+        fn(data, size);
+        data = newline ? newline + 1 : end;
+    }
+}
+
+/**
+ * @brief Build the wire form of an outbound message for a connection
+ *
+ * Text mode sends the message unchanged; binary mode drops the trailing
+ * newline text clients rely on and prepends the length header.
+ */
+std::string EncodeFrame(FrameMode mode, const char* data, size_t length);
+
+/**
+ * @brief EncodeFrame for a shared payload
+ *
+ * Text mode returns the payload itself, so text recipients of a fan-out
+ * all share one buffer; binary mode builds one framed copy.
+ */
+SharedBuffer EncodeFrame(FrameMode mode, const SharedBuffer& payload);
+
+#endif // FRAMING_H
@@ -0,0 +1,881 @@
+#include "io_uring_server.h"
+#include "object_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+namespace {
+
+int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+int io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Multishot accept reports no peer address; ask the socket for it
+bool GetPeerAddress(SOCKET sock, IpAddress& address) {
+    sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    return getpeername(sock, (sockaddr*)&addr, &len) == 0 &&
+           IpAddress::FromSockaddr((const sockaddr*)&addr, address);
+}
+
+// user_data for internal requests (wake-up NOP, cancel) that carry no context
+constexpr uint64_t INTERNAL_OP = 0;
+
+// Pause before re-arming an accept that failed for lack of descriptors
+const __kernel_timespec ACCEPT_BACKOFF = {0, 100 * 1000 * 1000};
+
+using IoDataPool = ObjectPool<URING_IO_DATA, 64>;
+
+void ReleaseIoData(URING_IO_DATA* io_data) {
+    io_data->conn.reset();
+    IoDataPool::Release(io_data);
+}
+
+// Writer only: point the connection's msghdr at the head of its queue
+size_t GatherWrite(URING_CONNECTION& conn) {
+    OutboundSegment segments[MAX_SEND_SEGMENTS];
+    size_t count = conn.outbound.Gather(segments, MAX_SEND_SEGMENTS);
+    for (size_t i = 0; i < count; ++i) {
+        conn.send_iov[i].iov_base = const_cast<char*>(segments[i].data);
+        conn.send_iov[i].iov_len = segments[i].length;
+    }
+    memset(&conn.send_msg, 0, sizeof(conn.send_msg));
+    conn.send_msg.msg_iov = conn.send_iov;
+    conn.send_msg.msg_iovlen = count;
+    return count;
+}
+
+} // namespace
+
+IoUringServer::IoUringServer(int port, ThreadPool& pool)
+    : listen_socket(INVALID_SOCKET)
+    , accept_op(nullptr)
+    , thread_pool(pool)
+    , port_(port)
+{
+}
+
+IoUringServer::~IoUringServer() {
+    Stop();
+}
+
+bool IoUringServer::SetupRing() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SUBMIT_ALL;
+
+    ring.fd = io_uring_setup(URING_QUEUE_DEPTH, &params);
+    if (ring.fd < 0 && errno == EINVAL) {
+        // Pre-5.18 kernels reject SUBMIT_ALL
+        memset(&params, 0, sizeof(params));
+        ring.fd = io_uring_setup(URING_QUEUE_DEPTH, &params);
+    }
+    if (ring.fd < 0) {
+        std::cerr << "[IoUring] io_uring_setup failed: " << errno << std::endl;
+        return false;
+    }
+    ring.features = params.features;
+
+    // Map submission and completion rings (one mapping on 5.4+)
+    ring.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (ring.features & IORING_FEAT_SINGLE_MMAP) {
+        ring.sq_size = std::max(ring.sq_size, ring.cq_size);
+        ring.cq_size = ring.sq_size;
+    }
+
+    ring.sq_ptr = mmap(NULL, ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring.fd, IORING_OFF_SQ_RING);
+    if (ring.sq_ptr == MAP_FAILED) {
+        ring.sq_ptr = nullptr;
+        std::cerr << "[IoUring] SQ ring mmap failed: " << errno << std::endl;
+        return false;
+    }
+
+    if (ring.features & IORING_FEAT_SINGLE_MMAP) {
+        ring.cq_ptr = ring.sq_ptr;
+    } else {
+        ring.cq_ptr = mmap(NULL, ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring.fd, IORING_OFF_CQ_RING);
+        if (ring.cq_ptr == MAP_FAILED) {
+            ring.cq_ptr = nullptr;
+            std::cerr << "[IoUring] CQ ring mmap failed: " << errno << std::endl;
+            return false;
+        }
+    }
+
+    ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring.fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        std::cerr << "[IoUring] SQE array mmap failed: " << errno << std::endl;
+        return false;
+    }
+    ring.sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(ring.sq_ptr);
+    ring.sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring.sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring.sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring.sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring.sq_entries = params.sq_entries;
+
+    char* cq = static_cast<char*>(ring.cq_ptr);
+    ring.cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring.cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring.cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring.cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Provided buffer ring for multishot recv
+    ring.buf_ring_size = URING_BUFFER_COUNT * sizeof(io_uring_buf);
+    void* buf_ring = mmap(NULL, ring.buf_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf_ring == MAP_FAILED) {
+        std::cerr << "[IoUring] Buffer ring mmap failed: " << errno << std::endl;
+        return false;
+    }
+    ring.buf_ring = static_cast<io_uring_buf_ring*>(buf_ring);
+    ring.buffers = new char[(size_t)URING_BUFFER_COUNT * MAX_LEN];
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring.buf_ring;
+    reg.ring_entries = URING_BUFFER_COUNT;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (io_uring_register(ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        std::cerr << "[IoUring] Provided buffer ring unsupported: " << errno << std::endl;
+        return false;
+    }
+
+    for (unsigned i = 0; i < URING_BUFFER_COUNT; ++i) {
+        RecycleBuffer((unsigned short)i);
+    }
+    __atomic_store_n(&ring.buf_ring->tail, ring.buf_tail, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void IoUringServer::DestroyRing() {
+    // Producers on other threads (Send, FanOut) check ring_alive under the
+    // same lock, so none can be writing an SQE while the rings go away
+    w32::LockGuard lock(sq_mutex);
+    ring_alive = false;
+    if (ring.sqes) munmap(ring.sqes, ring.sqes_size);
+    if (ring.cq_ptr && ring.cq_ptr != ring.sq_ptr) munmap(ring.cq_ptr, ring.cq_size);
+    if (ring.sq_ptr) munmap(ring.sq_ptr, ring.sq_size);
+    if (ring.fd >= 0) close(ring.fd);
+    if (ring.buf_ring) munmap(ring.buf_ring, ring.buf_ring_size);
+    delete[] ring.buffers;
+    ring = URING_RING();
+}
+
+io_uring_sqe* IoUringServer::GetSqe(unsigned ahead) {
+    if (!ring_alive) {
+        return nullptr;
+    }
+    unsigned tail = *ring.sq_tail + ahead;
+    unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+
+    if (tail - head >= ring.sq_entries) {
+        // Ring full: hand the backlog to the kernel before queuing more
+        if (ring.sq_unsubmitted > 0) {
+            int submitted = io_uring_enter(ring.fd, ring.sq_unsubmitted, 0, 0);
+            if (submitted > 0) ring.sq_unsubmitted -= std::min((unsigned)submitted, ring.sq_unsubmitted);
+        }
+        head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head >= ring.sq_entries) {
+            return nullptr;
+        }
+    }
+
+    unsigned index = tail & ring.sq_mask;
+    io_uring_sqe* sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sq_array[index] = index;
+    return sqe;
+}
+
+int IoUringServer::CommitSqes(unsigned count) {
+    // Publish prepared entries; the kernel picks them up on the next enter
+    __atomic_store_n(ring.sq_tail, *ring.sq_tail + count, __ATOMIC_RELEASE);
+    ring.sq_unsubmitted += count;
+    return (int)ring.sq_unsubmitted;
+}
+
+void IoUringServer::SubmitLocked() {
+    if (!ring_alive || ring.sq_unsubmitted == 0) {
+        return;
+    }
+    int submitted = io_uring_enter(ring.fd, ring.sq_unsubmitted, 0, 0);
+    if (submitted > 0) {
+        ring.sq_unsubmitted -= std::min((unsigned)submitted, ring.sq_unsubmitted);
+    }
+}
+
+bool IoUringServer::Start() {
+    // Create listen socket
+    listen_socket = CreateListenSocket(port_);
+    if (listen_socket == INVALID_SOCKET) {
+        std::cerr << "[IoUring] Failed to create listen socket" << std::endl;
+        return false;
+    }
+
+    if (!SetupRing()) {
+        DestroyRing();
+        closesocket(listen_socket);
+        listen_socket = INVALID_SOCKET;
+        return false;
+    }
+
+    running.store(true);
+
+    // Single multishot accept for the lifetime of the server
+    accept_op = IoDataPool::Acquire();
+    accept_op->operation = IOOperation::ACCEPT;
+    {
+        w32::LockGuard lock(sq_mutex);
+        ring_alive = true;
+        PostAccept(accept_op);
+        SubmitLocked();
+    }
+
+    completion_thread = w32::Thread(&IoUringServer::CompletionThread, this);
+    completion_thread.SetName("uring-cq");
+
+    std::cout << "[IoUring] Server started on port " << port_ << " (queue depth "
+              << ring.sq_entries << ", " << URING_BUFFER_COUNT << " provided buffers)" << std::endl;
+    return true;
+}
+
+void IoUringServer::Stop() {
+    w32::LockGuard lifecycle(lifecycle_mutex);
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    // Wake the completion thread; it tears down connections and drains
+    {
+        w32::LockGuard lock(sq_mutex);
+        io_uring_sqe* sqe = GetSqe();
+        if (sqe) {
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = INTERNAL_OP;
+            CommitSqes(1);
+        }
+        SubmitLocked();
+    }
+
+    if (completion_thread.joinable()) {
+        completion_thread.join();
+    }
+
+    DestroyRing();
+
+    if (listen_socket != INVALID_SOCKET) {
+        closesocket(listen_socket);
+        listen_socket = INVALID_SOCKET;
+    }
+
+    std::cout << "[IoUring] Server stopped" << std::endl;
+}
+
+void IoUringServer::CompletionThread() {
+    std::cout << "[IoUring] Completion thread started" << std::endl;
+
+    bool draining = false;
+    while (running.load() || inflight_ops.load() > 0) {
+        if (!running.load() && !draining) {
+            // Only this thread arms reads and accepts, so from here on no new
+            // long-lived request can appear; end the ones that exist.
+            draining = true;
+            {
+                w32::LockGuard lock(clients_mutex);
+                for (auto& pair : clients) {
+                    pair.second->closing.store(true);
+                    shutdown(pair.second->info.socket, SHUT_RDWR);
+                }
+                clients.clear();
+            }
+
+            w32::LockGuard lock(sq_mutex);
+            io_uring_sqe* sqe = GetSqe();
+            if (sqe) {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+                sqe->user_data = INTERNAL_OP;
+                CommitSqes(1);
+            }
+            continue;
+        }
+
+
+        // Submit everything queued since the last pass and wait, in one syscall
+        unsigned to_submit;
+        {
+            w32::LockGuard lock(sq_mutex);
+            to_submit = ring.sq_unsubmitted;
+        }
+
+        int result = io_uring_enter(ring.fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            std::cerr << "[IoUring] io_uring_enter failed: " << errno << std::endl;
+            break;
+        }
+        if (result > 0) {
+            // Only what the kernel took; the rest goes with the next enter
+            w32::LockGuard lock(sq_mutex);
+            ring.sq_unsubmitted -= std::min((unsigned)result, ring.sq_unsubmitted);
+        }
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        unsigned short buf_tail = ring.buf_tail;
+
+        while (head != tail) {
+            io_uring_cqe* cqe = &ring.cqes[head & ring.cq_mask];
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+            ++head;
+
+            if (user_data != INTERNAL_OP) {
+                HandleCompletion(reinterpret_cast<URING_IO_DATA*>(user_data), res, flags);
+            }
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+        // Return consumed receive buffers in one go
+        if (ring.buf_tail != buf_tail) {
+            __atomic_store_n(&ring.buf_ring->tail, ring.buf_tail, __ATOMIC_RELEASE);
+        }
+    }
+
+    std::cout << "[IoUring] Completion thread stopped" << std::endl;
+}
+
+void IoUringServer::HandleCompletion(URING_IO_DATA* io_data, int result, unsigned flags) {
+    switch (io_data->operation) {
+        case IOOperation::ACCEPT:
+            if (result >= 0) {
+                // Screen before a connection object exists. A peer that
+                // is already gone has no address to screen; drop it.
+                IpAddress address;
+                if (!GetPeerAddress(result, address) ||
+                    (accept_filter && !accept_filter(address))) {
+                    closesocket(result);
+                } else {
+                    HandleAccept(result, address);
+                }
+            } else if (result != -ECANCELED) {
+                std::cerr << "[IoUring] Accept failed: " << -result << std::endl;
+            }
+            if (!(flags & IORING_CQE_F_MORE)) {
+                inflight_ops--;
+                bool rearmed = false;
+                if (running.load()) {
+                    // Multishot accept was terminated; re-arm it. Out of
+                    // descriptors, the pending connection would fail it
+                    // again at once, so wait a little first.
+                    bool backoff = result == -EMFILE || result == -ENFILE;
+                    w32::LockGuard lock(sq_mutex);
+                    rearmed = PostAccept(io_data, backoff);
+                    if (!rearmed) {
+                        std::cerr << "[IoUring] Accept could not be re-armed, "
+                                  << "no new connections will be accepted" << std::endl;
+                    }
+                }
+                if (!rearmed) {
+                    ReleaseIoData(io_data);
+                    accept_op = nullptr;
+                }
+            }
+            break;
+        case IOOperation::READ:
+            HandleRead(io_data, result, flags);
+            break;
+        case IOOperation::WRITE:
+            HandleWrite(io_data, result);
+            break;
+    }
+}
+
+void IoUringServer::HandleAccept(SOCKET client_socket, const IpAddress& address) {
+    if (!running.load()) {
+        closesocket(client_socket);
+        return;
+    }
+
+    int client_id = next_client_id.fetch_add(1);
+
+    auto conn = std::make_shared<URING_CONNECTION>();
+    conn->strand = std::make_shared<Strand>(thread_pool);
+    conn->info.id = client_id;
+    conn->info.socket = client_socket;
+    conn->info.state = ClientState::CONNECTED;
+    conn->info.connected_at = std::chrono::steady_clock::now();
+    conn->info.activity = std::make_shared<ConnectionActivity>(conn->info.connected_at);
+    conn->info.ip_address = GetSocketAddress(client_socket);
+    conn->info.address = address;
+    conn->info.name = "anonymous";
+    conn->info.current_room = "general";
+
+    {
+        w32::LockGuard lock(clients_mutex);
+        clients[client_id] = conn;
+    }
+
+    std::cout << "[IoUring] New client " << client_id << " from "
+              << conn->info.ip_address << std::endl;
+
+    // Trigger connect callback
+    if (on_connect) {
+        conn->strand->post([this, client_id, client_socket]() {
+            on_connect(client_id, client_socket);
+        });
+    }
+
+    // Arm the multishot read; it is submitted with the next batch
+    URING_IO_DATA* io_data = IoDataPool::Acquire();
+    io_data->operation = IOOperation::READ;
+    io_data->conn = conn;
+
+    bool posted;
+    {
+        w32::LockGuard lock(sq_mutex);
+        posted = PostRead(io_data);
+    }
+    if (!posted) {
+        ReleaseIoData(io_data);
+        CleanupClient(client_id);
+    }
+}
+
+bool IoUringServer::PostAccept(URING_IO_DATA* io_data, bool backoff) {
+    unsigned count = 0;
+    if (backoff) {
+        // A timeout linked ahead of the accept; ETIME counts as success so
+        // the accept starts when it expires. Committed only with the accept.
+        io_uring_sqe* timeout = GetSqe();
+        if (!timeout) {
+            if (ring_alive) {
+                std::cerr << "[IoUring] Submission queue full, accept not armed" << std::endl;
+            }
+            return false;
+        }
+        timeout->opcode = IORING_OP_TIMEOUT;
+        timeout->flags = IOSQE_IO_LINK;
+        timeout->addr = (uint64_t)(uintptr_t)&ACCEPT_BACKOFF;
+        timeout->len = 1;
+        timeout->timeout_flags = IORING_TIMEOUT_ETIME_SUCCESS;
+        timeout->user_data = INTERNAL_OP;
+        count = 1;
+    }
+
+    io_uring_sqe* sqe = GetSqe(count);
+    if (!sqe) {
+        if (ring_alive) {
+            std::cerr << "[IoUring] Submission queue full, accept not armed" << std::endl;
+        }
+        return false;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_socket;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = (uint64_t)(uintptr_t)io_data;
+    CommitSqes(count + 1);
+    inflight_ops++;
+    return true;
+}
+
+bool IoUringServer::PostRead(URING_IO_DATA* io_data) {
+    io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        if (ring_alive) {
+            std::cerr << "[IoUring] Submission queue full, read not armed" << std::endl;
+        }
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = io_data->conn->info.socket;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = (uint64_t)(uintptr_t)io_data;
+    CommitSqes(1);
+    inflight_ops++;
+    return true;
+}
+
+bool IoUringServer::PostWrite(URING_IO_DATA* io_data) {
+    io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        if (ring_alive) {
+            std::cerr << "[IoUring] Submission queue full, write dropped" << std::endl;
+        }
+        return false;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = io_data->conn->info.socket;
+    sqe->addr = (uint64_t)(uintptr_t)&io_data->conn->send_msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)io_data;
+    CommitSqes(1);
+    inflight_ops++;
+    return true;
+}
+
+void IoUringServer::RecycleBuffer(unsigned short buffer_id) {
+    // Only the completion thread touches the buffer ring. Field-wise writes
+    // keep entry 0's resv intact, which doubles as the ring tail. The entries
+    // are indexed by hand: in C++ the header's flex-array member sits 8 bytes
+    // past the start of the ring.
+    io_uring_buf* entries = reinterpret_cast<io_uring_buf*>(ring.buf_ring);
+    io_uring_buf* buf = &entries[ring.buf_tail & (URING_BUFFER_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring.buffers + (size_t)buffer_id * MAX_LEN);
+    buf->len = MAX_LEN;
+    buf->bid = buffer_id;
+    ring.buf_tail++;
+}
+
+void IoUringServer::HandleRead(URING_IO_DATA* io_data, int result, unsigned flags) {
+    auto& conn = io_data->conn;
+    int client_id = conn->info.id;
+
+    if (result > 0 && (flags & IORING_CQE_F_BUFFER)) {
+        unsigned short buffer_id = (unsigned short)(flags >> IORING_CQE_BUFFER_SHIFT);
+
+        // Reassemble frames; everything completed by this chunk is one task
+        bool framing_error = false;
+        if (!conn->closing.load()) {
+            std::string batch;
+            if (!conn->decoder.Feed(ring.buffers + (size_t)buffer_id * MAX_LEN,
+                                    (size_t)result, batch)) {
+                std::cerr << "[IoUring] Framing error from client " << client_id << std::endl;
+                framing_error = true;
+            } else {
+                // First bytes fix the mode: release what was held for it
+                conn->decoder.Publish([&](SharedBuffer frame) {
+                    if (QueueWrite(conn, std::move(frame))) {
+                        StartWrites({conn});
+                    }
+                });
+                if (!batch.empty()) {
+                    DispatchFrames(conn, batch);
+                }
+            }
+        }
+        RecycleBuffer(buffer_id);
+
+        if (framing_error) {
+            // The shutdown ends the multishot recv; its final CQE frees io_data
+            CleanupClient(client_id);
+        }
+
+        // Update last activity; the record is the connection's own, no lock
+        conn->info.activity->RecordRead(1, (size_t)result);
+
+        if (flags & IORING_CQE_F_MORE) {
+            return; // Still armed, nothing to re-post
+        }
+    }
+
+    // The multishot request is finished
+    inflight_ops--;
+
+    bool rearm = conn->closing.load() == false && running.load() &&
+                 (result > 0 || result == -ENOBUFS);
+    if (rearm) {
+        bool posted;
+        {
+            w32::LockGuard lock(sq_mutex);
+            posted = PostRead(io_data);
+        }
+        if (posted) {
+            return;
+        }
+    } else if (result == 0) {
+        // Client disconnected gracefully
+        std::cout << "[IoUring] Client " << client_id << " disconnected" << std::endl;
+    } else if (result < 0 && result != -ECANCELED && !conn->closing.load()) {
+        std::cerr << "[IoUring] I/O error for client " << client_id
+                  << ": " << -result << std::endl;
+    }
+
+    CleanupClient(client_id);
+    ReleaseIoData(io_data);
+}
+
+void IoUringServer::DispatchFrames(const std::shared_ptr<URING_CONNECTION>& conn, std::string& batch) {
+    if (on_message) {
+        int client_id = conn->info.id;
+        FrameMode mode = conn->decoder.mode();
+        conn->strand->post([this, client_id, mode, batch = std::move(batch)]() {
+            ForEachFrame(mode, batch.data(), batch.size(), [&](const char* frame, size_t length) {
+                on_message(client_id, frame, (int)length);
+            });
+        });
+    }
+    batch.clear();
+}
+
+void IoUringServer::HandleWrite(URING_IO_DATA* io_data, int result) {
+    inflight_ops--;
+    auto& conn = io_data->conn;
+
+    if (result <= 0) {
+        conn->outbound.Abort();
+        if (result != -ECANCELED && !conn->closing.load()) {
+            std::cerr << "[IoUring] Send failed for client " << conn->info.id
+                      << ": " << -result << std::endl;
+            CleanupClient(conn->info.id);
+        }
+        ReleaseIoData(io_data);
+        return;
+    }
+
+    // Drop what was sent (possibly part of a message) and send what has
+    // queued up since, as one vectored write with the next batch
+    conn->outbound.Consume((size_t)result);
+    if (conn->closing.load()) {
+        conn->outbound.Abort();
+    } else if (GatherWrite(*conn) > 0) {
+        bool posted;
+        {
+            w32::LockGuard lock(sq_mutex);
+            posted = PostWrite(io_data);
+        }
+        if (posted) {
+            return;
+        }
+        conn->outbound.Abort();
+        CleanupClient(conn->info.id);
+    }
+
+    ReleaseIoData(io_data);
+}
+
+std::shared_ptr<URING_CONNECTION> IoUringServer::FindConnection(int client_id) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it == clients.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void IoUringServer::CleanupClient(int client_id) {
+    std::shared_ptr<URING_CONNECTION> conn;
+
+    {
+        w32::LockGuard lock(clients_mutex);
+        auto it = clients.find(client_id);
+        if (it != clients.end()) {
+            conn = it->second;
+            clients.erase(it);
+        }
+    }
+
+    if (!conn) {
+        return; // Already cleaned up
+    }
+
+    // Completes the armed recv; the socket closes with the last reference
+    conn->closing.store(true);
+    shutdown(conn->info.socket, SHUT_RDWR);
+
+    // Trigger disconnect callback
+    if (on_disconnect) {
+        conn->strand->post([this, client_id]() {
+            on_disconnect(client_id);
+        });
+    }
+}
+
+bool IoUringServer::QueueWrite(const std::shared_ptr<URING_CONNECTION>& conn, SharedBuffer data) {
+    switch (conn->outbound.Push(std::move(data))) {
+    case OutboundQueue::PushResult::START_WRITE:
+        return true;
+    case OutboundQueue::PushResult::QUEUED:
+        return false;
+    case OutboundQueue::PushResult::BACKLOG_FULL:
+        break;
+    }
+
+    std::cerr << "[IoUring] Client " << conn->info.id
+              << " send backlog exceeded, dropping" << std::endl;
+    CleanupClient(conn->info.id);
+    return false;
+}
+
+void IoUringServer::StartWrites(const std::vector<std::shared_ptr<URING_CONNECTION>>& writers) {
+    std::vector<std::shared_ptr<URING_CONNECTION>> failed;
+    {
+        // Queue every send, then enter the kernel once for the whole batch
+        w32::LockGuard lock(sq_mutex);
+        for (const auto& conn : writers) {
+            GatherWrite(*conn);
+            URING_IO_DATA* io_data = IoDataPool::Acquire();
+            io_data->operation = IOOperation::WRITE;
+            io_data->conn = conn;
+            if (!PostWrite(io_data)) {
+                ReleaseIoData(io_data);
+                conn->outbound.Abort();
+                failed.push_back(conn);
+            }
+        }
+        SubmitLocked();
+    }
+
+    for (const auto& conn : failed) {
+        CleanupClient(conn->info.id);
+    }
+}
+
+bool IoUringServer::Send(int client_id, const char* message, int length) {
+    if (!running.load() || length <= 0) {
+        return false;
+    }
+
+    auto conn = FindConnection(client_id);
+    if (!conn || conn->closing.load()) {
+        return false;
+    }
+
+    // Only the push that finds the queue idle starts a write; anything
+    // queued behind an in-flight write goes out with its completion
+    SharedBuffer payload = SharedBuffer::Copy(message, (size_t)length);
+    if (conn->decoder.Hold(payload)) {
+        return true; // Mode not known yet
+    }
+    if (QueueWrite(conn, EncodeFrame(conn->decoder.mode(), payload))) {
+        StartWrites({conn});
+    }
+    return !conn->closing.load();
+}
+
+void IoUringServer::Broadcast(const char* message, int length, int exclude_id) {
+    if (!running.load() || length <= 0) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<URING_CONNECTION>> targets;
+    {
+        w32::LockGuard lock(clients_mutex);
+        targets.reserve(clients.size());
+        for (const auto& pair : clients) {
+            if (pair.first != exclude_id) {
+                targets.push_back(pair.second);
+            }
+        }
+    }
+
+    FanOut(targets, SharedBuffer::Copy(message, (size_t)length));
+}
+
+void IoUringServer::Multicast(const std::vector<int>& client_ids, const SharedBuffer& payload,
+                              int exclude_id) {
+    if (!running.load() || payload.empty()) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<URING_CONNECTION>> targets;
+    {
+        w32::LockGuard lock(clients_mutex);
+        targets.reserve(client_ids.size());
+        for (int client_id : client_ids) {
+            if (client_id == exclude_id) {
+                continue;
+            }
+            auto it = clients.find(client_id);
+            if (it != clients.end()) {
+                targets.push_back(it->second);
+            }
+        }
+    }
+
+    FanOut(targets, payload);
+}
+
+void IoUringServer::FanOut(const std::vector<std::shared_ptr<URING_CONNECTION>>& targets,
+                           const SharedBuffer& payload) {
+    SharedBuffer binary_frame; // Encoded once, on first binary-mode target
+    std::vector<std::shared_ptr<URING_CONNECTION>> writers;
+    for (const auto& conn : targets) {
+        if (conn->closing.load() || conn->decoder.Hold(payload)) {
+            continue;
+        }
+        bool start;
+        if (conn->decoder.mode() == FrameMode::BINARY) {
+            if (binary_frame.empty()) {
+                binary_frame = EncodeFrame(FrameMode::BINARY, payload);
+            }
+            start = QueueWrite(conn, binary_frame);
+        } else {
+            start = QueueWrite(conn, payload);
+        }
+        if (start) {
+            writers.push_back(conn);
+        }
+    }
+
+    // Idle connections start their writes together in one submission
+    if (!writers.empty()) {
+        StartWrites(writers);
+    }
+}
+
+void IoUringServer::DisconnectClient(int client_id) {
+    CleanupClient(client_id);
+}
+
+CLIENT_INFO* IoUringServer::GetClient(int client_id) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it != clients.end()) {
+        return &it->second->info;
+    }
+    return nullptr;
+}
+
+bool IoUringServer::GetClientAddress(int client_id, IpAddress& address) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it != clients.end()) {
+        address = it->second->info.address;
+        return true;
+    }
+    return false;
+}
+
+std::shared_ptr<ConnectionActivity> IoUringServer::GetClientActivity(int client_id) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it != clients.end()) {
+        return it->second->info.activity;
+    }
+    return nullptr;
+}
+
+std::vector<CLIENT_INFO> IoUringServer::GetAllClients() {
+    w32::LockGuard lock(clients_mutex);
+    std::vector<CLIENT_INFO> result;
+    result.reserve(clients.size());
+    for (const auto& pair : clients) {
+        result.push_back(pair.second->info);
+    }
+    return result;
+}
@@ -0,0 +1,259 @@
+#ifndef IO_URING_SERVER_H
+#define IO_URING_SERVER_H
+
+#include "framing.h"
+#include "outbound_queue.h"
+#include "sockutil.h"
+#include "strand.h"
+#include "thread_pool.h"
+#include "win32_compat.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// Submission queue depth (completion queue is twice this)
+constexpr unsigned URING_QUEUE_DEPTH = 4096;
+
+// Provided receive buffers shared by every connection (power of two)
+constexpr unsigned URING_BUFFER_COUNT = 1024;
+constexpr unsigned short URING_BUFFER_GROUP = 0;
+
+/**
+ * @brief Per-connection state for the io_uring backend
+ *
+ * Every in-flight operation holds a reference, so the descriptor is only
+ * closed once the kernel has returned all of them.
+ */
+struct URING_CONNECTION {
+    CLIENT_INFO info;
+    std::shared_ptr<Strand> strand; // Serializes this client's callbacks
+    FrameDecoder decoder;           // Touched only by the completion thread
+    OutboundQueue outbound;         // Messages not yet accepted by the kernel
+    std::atomic<bool> closing{false};
+
+    // The in-flight SENDMSG, owned by the outbound queue's current writer
+    iovec send_iov[MAX_SEND_SEGMENTS];
+    msghdr send_msg;
+
+    ~URING_CONNECTION() {
+        if (info.socket != INVALID_SOCKET) {
+            closesocket(info.socket);
+        }
+    }
+};
+
+/**
+ * @brief Per-operation context, the io_uring counterpart of PER_IO_DATA
+ *
+ * Its address is the SQE user_data. A multishot ACCEPT or READ keeps one
+ * context for as long as the kernel keeps the request armed.
+ */
+struct URING_IO_DATA {
+    IOOperation operation;
+    std::shared_ptr<URING_CONNECTION> conn; // Empty for ACCEPT
+};
+
+/**
+ * @brief Mapped views of the submission/completion rings
+ */
+struct URING_RING {
+    int fd = -1;
+    unsigned features = 0;
+
+    void* sq_ptr = nullptr;
+    size_t sq_size = 0;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+    unsigned sq_unsubmitted = 0;  // Published to the ring, not yet entered
+
+    void* cq_ptr = nullptr;
+    size_t cq_size = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    io_uring_buf_ring* buf_ring = nullptr;
+    size_t buf_ring_size = 0;
+    char* buffers = nullptr;
+    unsigned short buf_tail = 0;
+};
+
+/**
+ * @brief io_uring server for Linux
+ *
+ * Drop-in replacement for IOCPServer built on the same completion model:
+ * one multishot accept, one multishot recv per connection drawing from a
+ * provided buffer ring, and SQEs batched into as few io_uring_enter calls
+ * as possible. A single completion thread owns the CQ and the buffer ring;
+ * message handling runs on the thread pool as with IOCP.
+ */
+class IoUringServer {
+public:
+    using MessageHandler = std::function<void(int client_id, const char* message, int length)>;
+    using ConnectHandler = std::function<void(int client_id, SOCKET socket)>;
+    using DisconnectHandler = std::function<void(int client_id)>;
+    using AcceptFilter = std::function<bool(const IpAddress& address)>;
+
+    /**
+     * @brief Construct io_uring server
+     * @param port Port to listen on
+     * @param pool Reference to thread pool
+     */
+    IoUringServer(int port, ThreadPool& pool);
+
+    /**
+     * @brief Destructor
+     */
+    ~IoUringServer();
+
+    // Non-copyable
+    IoUringServer(const IoUringServer&) = delete;
+    IoUringServer& operator=(const IoUringServer&) = delete;
+
+    /**
+     * @brief Start the server
+     * @return true if started successfully
+     */
+    bool Start();
+
+    /**
+     * @brief Stop the server
+     */
+    void Stop();
+
+    /**
+     * @brief Check if server is running
+     */
+    bool IsRunning() const { return running.load(); }
+
+    /**
+     * @brief Send message to specific client
+     */
+    bool Send(int client_id, const char* message, int length);
+
+    /**
+     * @brief Send message to all clients except sender
+     */
+    void Broadcast(const char* message, int length, int exclude_id = -1);
+
+    /**
+     * @brief Send one shared payload to each listed client
+     *
+     * Recipients share the payload's bytes; binary-mode clients share one
+     * framed copy. Nothing is copied per recipient.
+     */
+    void Multicast(const std::vector<int>& client_ids, const SharedBuffer& payload,
+                   int exclude_id = -1);
+
+    /**
+     * @brief Disconnect a client
+     */
+    void DisconnectClient(int client_id);
+
+    /**
+     * @brief Get client info
+     */
+    CLIENT_INFO* GetClient(int client_id);
+
+    /**
+     * @brief Copy a client's address, or return false if it is gone
+     *
+     * The copy stays valid if the client disconnects, unlike GetClient.
+     */
+    bool GetClientAddress(int client_id, IpAddress& address);
+
+    /**
+     * @brief Get a client's activity record, or null if it is gone
+     *
+     * The record outlives the connection for as long as a holder keeps it.
+     */
+    std::shared_ptr<ConnectionActivity> GetClientActivity(int client_id);
+
+    /**
+     * @brief Get all connected clients
+     */
+    std::vector<CLIENT_INFO> GetAllClients();
+
+    /**
+     * @brief Set event handlers
+     */
+    void OnMessage(MessageHandler handler) { on_message = handler; }
+    void OnConnect(ConnectHandler handler) { on_connect = handler; }
+    void OnDisconnect(DisconnectHandler handler) { on_disconnect = handler; }
+
+    /**
+     * @brief Screen new connections on the accept thread, before any
+     *        client state exists; returning false closes the socket
+     */
+    void OnAccept(AcceptFilter filter) { accept_filter = filter; }
+
+private:
+    // Core components
+    URING_RING ring;
+    w32::Mutex sq_mutex;          // Serializes SQE producers
+    bool ring_alive = false;      // Rings mapped; guarded by sq_mutex
+    SOCKET listen_socket;
+    URING_IO_DATA* accept_op;
+    ThreadPool& thread_pool;
+
+    // State
+    std::atomic<bool> running{false};
+    std::atomic<int> next_client_id{1};
+    std::atomic<int> inflight_ops{0};
+    w32::Mutex lifecycle_mutex;
+
+    // Client management
+    std::unordered_map<int, std::shared_ptr<URING_CONNECTION>> clients;
+    w32::Mutex clients_mutex;
+
+    // Completion thread
+    w32::Thread completion_thread;
+
+    // Event handlers
+    MessageHandler on_message;
+    ConnectHandler on_connect;
+    DisconnectHandler on_disconnect;
+    AcceptFilter accept_filter;
+
+    // Ring management
+    bool SetupRing();
+    void DestroyRing();           // Takes sq_mutex
+    // The following require sq_mutex and fail once the ring is destroyed
+    io_uring_sqe* GetSqe(unsigned ahead = 0);   // `ahead` entries prepared, not committed
+    int CommitSqes(unsigned count);
+    void SubmitLocked();
+
+    // Internal methods
+    void CompletionThread();
+    void HandleCompletion(URING_IO_DATA* io_data, int result, unsigned flags);
+    void HandleAccept(SOCKET client_socket, const IpAddress& address);
+    void HandleRead(URING_IO_DATA* io_data, int result, unsigned flags);
+    void FanOut(const std::vector<std::shared_ptr<URING_CONNECTION>>& targets, const SharedBuffer& payload);
+    void DispatchFrames(const std::shared_ptr<URING_CONNECTION>& conn, std::string& batch);
+    void HandleWrite(URING_IO_DATA* io_data, int result);
+    bool PostAccept(URING_IO_DATA* io_data, bool backoff = false);   // Require sq_mutex
+    bool PostRead(URING_IO_DATA* io_data);
+    bool PostWrite(URING_IO_DATA* io_data);
+    bool QueueWrite(const std::shared_ptr<URING_CONNECTION>& conn, SharedBuffer data);
+    void StartWrites(const std::vector<std::shared_ptr<URING_CONNECTION>>& writers);
+    void RecycleBuffer(unsigned short buffer_id);
+    std::shared_ptr<URING_CONNECTION> FindConnection(int client_id);
+    void CleanupClient(int client_id);
+
+    int port_;
+};
+
+#endif // IO_URING_SERVER_H
@@ -1,6 +1,35 @@
 #include "iocp_server.h"
+#include "object_pool.h"
 #include <iostream>
-#include <algorithm>
+
+namespace {
+
+// I/O contexts are recycled rather than freed: 2 KB+ each, one per read
+// re-post and per write burst
+using ReadDataPool = ObjectPool<IOCP_READ_DATA, 32>;
+using WriteDataPool = ObjectPool<IOCP_WRITE_DATA, 32>;
+
+IOCP_READ_DATA* ToReadData(PER_IO_DATA* io_data) {
+    return reinterpret_cast<IOCP_READ_DATA*>(io_data);
+}
+
+void ReleaseReadData(IOCP_READ_DATA* read_data) {
+    read_data->io.socket = INVALID_SOCKET;
+    read_data->session.reset();
+    ReadDataPool::Release(read_data);
+}
+
+IOCP_WRITE_DATA* ToWriteData(PER_IO_DATA* io_data) {
+    return reinterpret_cast<IOCP_WRITE_DATA*>(io_data);
+}
+
+void ReleaseWriteData(IOCP_WRITE_DATA* write_data) {
+    write_data->io.socket = INVALID_SOCKET;
+    write_data->session.reset();
+    WriteDataPool::Release(write_data);
+}
+
+} // namespace
 
 IOCPServer::IOCPServer(int port, ThreadPool& pool)
     : completion_port(INVALID_HANDLE_VALUE)
@@ -50,6 +79,7 @@ bool IOCPServer::Start() {
     
     for (int i = 0; i < num_workers; ++i) {
         io_workers.push_back(w32::Thread([this] { IOCPWorkerThread(); }));
+        io_workers.back().SetName(("iocp-" + std::to_string(i)).c_str());
     }
     
     // Start accept thread
@@ -92,16 +122,22 @@ void IOCPServer::Stop() {
     }
     io_workers.clear();
     
-    // Close all client connections
+    // Close all client connections. With the workers gone nothing will
+    // dequeue the outstanding I/O, whose contexts still hold sessions, so
+    // the sockets are closed here rather than with the last reference.
     {
         w32::LockGuard lock(clients_mutex);
-        for (auto& pair : clients) {
-            if (pair.second.socket != INVALID_SOCKET) {
-                closesocket(pair.second.socket);
+        for (auto& pair : sessions) {
+            IOCP_SESSION& session = *pair.second;
+            session.closing.store(true);
+            if (session.socket != INVALID_SOCKET) {
+                closesocket(session.socket);
+                session.socket = INVALID_SOCKET;
             }
         }
         clients.clear();
         socket_to_id.clear();
+        sessions.clear();
     }
     
     // Close IOCP handle
@@ -139,10 +175,16 @@ void IOCPServer::IOCPWorkerThread() {
             if (overlapped != NULL) {
                 // I/O operation failed
                 PER_IO_DATA* io_data = CONTAINING_RECORD(overlapped, PER_IO_DATA, overlapped);
-                std::cerr << "[IOCP] I/O error for client " << io_data->client_id 
-                          << ": " << error << std::endl;
-                CleanupClient(io_data->client_id);
-                delete io_data;
+                if (error != ERROR_OPERATION_ABORTED) { // Cancelled by CleanupClient
+                    std::cerr << "[IOCP] I/O error for client " << io_data->client_id 
+                              << ": " << error << std::endl;
+                }
+                if (io_data->operation == IOOperation::WRITE) {
+                    AbortWrite(io_data);
+                } else {
+                    CleanupClient(io_data->client_id);
+                    ReleaseReadData(ToReadData(io_data));
+                }
             }
             continue;
         }
@@ -154,11 +196,16 @@ void IOCPServer::IOCPWorkerThread() {
         
         PER_IO_DATA* io_data = CONTAINING_RECORD(overlapped, PER_IO_DATA, overlapped);
         
+        if (bytes_transferred == 0 && io_data->operation == IOOperation::WRITE) {
+            AbortWrite(io_data);
+            continue;
+        }
+        
         if (bytes_transferred == 0 && io_data->operation != IOOperation::ACCEPT) {
             // Client disconnected gracefully
             std::cout << "[IOCP] Client " << io_data->client_id << " disconnected" << std::endl;
             CleanupClient(io_data->client_id);
-            delete io_data;
+            ReleaseReadData(ToReadData(io_data));
             continue;
         }
         
@@ -180,7 +227,7 @@ void IOCPServer::AcceptConnections() {
     std::cout << "[IOCP] Accept thread started" << std::endl;
     
     while (running.load()) {
-        sockaddr_in client_addr;
+        sockaddr_storage client_addr;
         int addr_len = sizeof(client_addr);
         
         SOCKET client_socket = accept(listen_socket, (sockaddr*)&client_addr, &addr_len);
@@ -195,13 +242,21 @@ void IOCPServer::AcceptConnections() {
             continue;
         }
         
-        HandleAccept(client_socket);
+        // Screen before IOCP association or any client state
+        IpAddress address;
+        IpAddress::FromSockaddr((const sockaddr*)&client_addr, address);
+        if (accept_filter && !accept_filter(address)) {
+            closesocket(client_socket);
+            continue;
+        }
+        
+        HandleAccept(client_socket, address);
     }
     
     std::cout << "[IOCP] Accept thread stopped" << std::endl;
 }
 
-void IOCPServer::HandleAccept(SOCKET client_socket) {
+void IOCPServer::HandleAccept(SOCKET client_socket, const IpAddress& address) {
     // Associate with IOCP
     if (CreateIoCompletionPort((HANDLE)client_socket, completion_port, 0, 0) == NULL) {
         std::cerr << "[IOCP] Failed to associate client socket: " << GetLastError() << std::endl;
@@ -212,6 +267,9 @@ void IOCPServer::HandleAccept(SOCKET client_socket) {
     // Create client info
     int client_id = next_client_id.fetch_add(1);
     
+    auto session = std::make_shared<IOCP_SESSION>();
+    session->socket = client_socket;
+    session->strand = std::make_shared<Strand>(thread_pool);
     {
         w32::LockGuard lock(clients_mutex);
         
@@ -220,13 +278,16 @@ void IOCPServer::HandleAccept(SOCKET client_socket) {
         client.socket = client_socket;
         client.state = ClientState::CONNECTED;
         client.connected_at = std::chrono::steady_clock::now();
-        client.last_activity = client.connected_at;
+        client.activity = std::make_shared<ConnectionActivity>(client.connected_at);
         client.ip_address = GetSocketAddress(client_socket);
+        client.address = address;
         client.name = "anonymous";
         client.current_room = "general";
         
+        session->activity = client.activity;
         clients[client_id] = client;
         socket_to_id[client_socket] = client_id;
+        sessions[client_id] = session;
     }
     
     std::cout << "[IOCP] New client " << client_id << " from " 
@@ -234,28 +295,38 @@ void IOCPServer::HandleAccept(SOCKET client_socket) {
     
     // Trigger connect callback
     if (on_connect) {
-        thread_pool.enqueue([this, client_id, client_socket]() {
+        session->strand->post([this, client_id, client_socket]() {
             on_connect(client_id, client_socket);
         });
     }
     
     // Post initial read
-    PER_IO_DATA* io_data = new PER_IO_DATA();
-    io_data->operation = IOOperation::READ;
-    io_data->client_id = client_id;
-    io_data->socket = client_socket;
-    PostRead(io_data);
+    IOCP_READ_DATA* read_data = ReadDataPool::Acquire();
+    read_data->io.operation = IOOperation::READ;
+    read_data->io.client_id = client_id;
+    read_data->io.socket = client_socket;
+    read_data->session = std::move(session);
+    PostRead(read_data);
 }
 
-void IOCPServer::PostRead(PER_IO_DATA* io_data) {
+void IOCPServer::PostRead(IOCP_READ_DATA* read_data) {
+    PER_IO_DATA* io_data = &read_data->io;
+    if (read_data->session->closing.load()) {
+        ReleaseReadData(read_data);
+        return;
+    }
+    
+    // Only the OVERLAPPED must be clean; the buffer is overwritten by the
+    // kernel and read up to bytes_transferred
     ZeroMemory(&io_data->overlapped, sizeof(OVERLAPPED));
-    ZeroMemory(io_data->buffer, MAX_LEN);
     io_data->wsa_buf.buf = io_data->buffer;
     io_data->wsa_buf.len = MAX_LEN;
     
     DWORD flags = 0;
     DWORD bytes_recv = 0;
     
+    // The completion may release read_data before WSARecv returns
+    std::shared_ptr<IOCP_SESSION> session = read_data->session;
     int result = WSARecv(
         io_data->socket,
         &io_data->wsa_buf,
@@ -271,39 +342,70 @@ void IOCPServer::PostRead(PER_IO_DATA* io_data) {
         if (error != WSA_IO_PENDING) {
             std::cerr << "[IOCP] WSARecv failed: " << error << std::endl;
             CleanupClient(io_data->client_id);
-            delete io_data;
+            ReleaseReadData(read_data);
+            return;
         }
     }
+    
+    // Posted after CleanupClient's cancel: cancel it here instead
+    if (session->closing.load()) {
+        CancelIoEx((HANDLE)session->socket, NULL);
+    }
 }
 
-void IOCPServer::PostWrite(int client_id, const char* data, int length) {
-    SOCKET sock = INVALID_SOCKET;
-    {
-        w32::LockGuard lock(clients_mutex);
-        auto it = clients.find(client_id);
-        if (it == clients.end()) {
-            return;
+void IOCPServer::QueueWrite(int client_id, const std::shared_ptr<IOCP_SESSION>& session,
+                            SharedBuffer data) {
+    switch (session->outbound.Push(std::move(data))) {
+        case OutboundQueue::PushResult::START_WRITE: {
+            // Idle queue: this caller starts the session's single write
+            IOCP_WRITE_DATA* write_data = WriteDataPool::Acquire();
+            write_data->io.operation = IOOperation::WRITE;
+            write_data->io.client_id = client_id;
+            write_data->io.socket = session->socket;
+            write_data->session = session;
+            PostWrite(write_data);
+            break;
         }
-        sock = it->second.socket;
+        case OutboundQueue::PushResult::QUEUED:
+            break; // Goes out with the in-flight write's completion
+        case OutboundQueue::PushResult::BACKLOG_FULL:
+            std::cerr << "[IOCP] Client " << client_id
+                      << " send backlog exceeded, dropping" << std::endl;
+            CleanupClient(client_id);
+            break;
+    }
+}
+
+void IOCPServer::PostWrite(IOCP_WRITE_DATA* write_data) {
+    // Everything queued so far goes out as one vectored send, straight
+    // from the queued buffers
+    if (write_data->session->closing.load()) {
+        AbortWrite(&write_data->io);
+        return;
+    }
+    OutboundSegment segments[MAX_SEND_SEGMENTS];
+    size_t count = write_data->session->outbound.Gather(segments, MAX_SEND_SEGMENTS);
+    if (count == 0) {
+        ReleaseWriteData(write_data); // Drained
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        write_data->buffers[i].buf = const_cast<char*>(segments[i].data);
+        write_data->buffers[i].len = (ULONG)segments[i].length;
     }
     
-    PER_IO_DATA* io_data = new PER_IO_DATA();
-    io_data->operation = IOOperation::WRITE;
-    io_data->client_id = client_id;
-    io_data->socket = sock;
-    memcpy(io_data->buffer, data, std::min(length, (int)MAX_LEN));
-    io_data->wsa_buf.buf = io_data->buffer;
-    io_data->wsa_buf.len = length;
-    
+    ZeroMemory(&write_data->io.overlapped, sizeof(OVERLAPPED));
     DWORD bytes_sent = 0;
     
+    // The completion may release write_data before WSASend returns
+    std::shared_ptr<IOCP_SESSION> session = write_data->session;
     int result = WSASend(
-        sock,
-        &io_data->wsa_buf,
-        1,
+        write_data->io.socket,
+        write_data->buffers,
+        (DWORD)count,
         &bytes_sent,
         0,
-        &io_data->overlapped,
+        &write_data->io.overlapped,
         NULL
     );
     
@@ -311,82 +413,179 @@ void IOCPServer::PostWrite(int client_id, const char* data, int length) {
         int error = WSAGetLastError();
         if (error != WSA_IO_PENDING) {
             std::cerr << "[IOCP] WSASend failed: " << error << std::endl;
-            delete io_data;
+            AbortWrite(&write_data->io);
+            return;
         }
     }
+    
+    // Posted after CleanupClient's cancel: cancel it here instead
+    if (session->closing.load()) {
+        CancelIoEx((HANDLE)session->socket, NULL);
+    }
+}
+
+void IOCPServer::AbortWrite(PER_IO_DATA* io_data) {
+    IOCP_WRITE_DATA* write_data = ToWriteData(io_data);
+    write_data->session->outbound.Abort();
+    CleanupClient(io_data->client_id);
+    ReleaseWriteData(write_data);
 }
 
 void IOCPServer::HandleRead(PER_IO_DATA* io_data, DWORD bytes_transferred) {
-    // Update last activity
-    {
-        w32::LockGuard lock(clients_mutex);
-        auto it = clients.find(io_data->client_id);
-        if (it != clients.end()) {
-            it->second.last_activity = std::chrono::steady_clock::now();
-            it->second.message_count++;
-        }
-    }
+    IOCP_READ_DATA* read_data = ToReadData(io_data);
+    const std::shared_ptr<IOCP_SESSION>& session = read_data->session;
+    int client_id = io_data->client_id;
     
-    // Trigger message callback via thread pool
-    if (on_message && bytes_transferred > 0) {
-        int client_id = io_data->client_id;
-        std::string message(io_data->buffer, bytes_transferred);
+    if (!session->closing.load() && bytes_transferred > 0) {
+        // Update last activity on the session's shared record
+        session->activity->RecordRead(1, bytes_transferred);
         
-        thread_pool.enqueue([this, client_id, message]() {
-            on_message(client_id, message.c_str(), (int)message.length());
+        // Reassemble frames; everything completed by this chunk is one task
+        std::string batch;
+        if (!session->decoder.Feed(io_data->buffer, bytes_transferred, batch)) {
+            std::cerr << "[IOCP] Framing error from client " << client_id << std::endl;
+            CleanupClient(client_id);
+            ReleaseReadData(read_data);
+            return;
+        }
+        
+        // First bytes fix the mode: release what was held for it
+        session->decoder.Publish([&](SharedBuffer frame) {
+            QueueWrite(client_id, session, std::move(frame));
         });
+        
+        // Run on the client's strand: in order, one batch at a time
+        if (on_message && !batch.empty()) {
+            FrameMode mode = session->decoder.mode();
+            session->strand->post([this, client_id, mode, batch = std::move(batch)]() {
+                ForEachFrame(mode, batch.data(), batch.size(), [&](const char* frame, size_t length) {
+                    on_message(client_id, frame, (int)length);
+                });
+            });
+        }
     }
     
-    // Post another read
-    PostRead(io_data);
+    // Post another read; a closing session releases the context instead
+    PostRead(read_data);
 }
 
 void IOCPServer::HandleWrite(PER_IO_DATA* io_data, DWORD bytes_transferred) {
-    // Write completed, free the IO data
-    delete io_data;
+    // Drop what was sent, which may end mid-message, then send the rest
+    // plus anything queued meanwhile
+    IOCP_WRITE_DATA* write_data = ToWriteData(io_data);
+    write_data->session->outbound.Consume(bytes_transferred);
+    PostWrite(write_data);
 }
 
 void IOCPServer::CleanupClient(int client_id) {
-    SOCKET sock = INVALID_SOCKET;
+    std::shared_ptr<IOCP_SESSION> session;
     
     {
         w32::LockGuard lock(clients_mutex);
         auto it = clients.find(client_id);
         if (it != clients.end()) {
-            sock = it->second.socket;
-            socket_to_id.erase(sock);
+            socket_to_id.erase(it->second.socket);
             clients.erase(it);
         }
+        auto session_it = sessions.find(client_id);
+        if (session_it != sessions.end()) {
+            session = std::move(session_it->second);
+            sessions.erase(session_it);
+        }
     }
     
-    if (sock != INVALID_SOCKET) {
-        closesocket(sock);
+    // Don't close here: a fan-out may still hold the session. Cancelling
+    // makes the outstanding read and write complete, and the socket is
+    // closed when the last of them lets the session go.
+    if (session) {
+        session->closing.store(true);
+        CancelIoEx((HANDLE)session->socket, NULL);
     }
     
-    // Trigger disconnect callback
-    if (on_disconnect) {
-        thread_pool.enqueue([this, client_id]() {
+    // Trigger disconnect callback after any queued messages
+    if (on_disconnect && session) {
+        session->strand->post([this, client_id]() {
             on_disconnect(client_id);
         });
     }
 }
 
 bool IOCPServer::Send(int client_id, const char* message, int length) {
-    w32::LockGuard lock(clients_mutex);
-    auto it = clients.find(client_id);
-    if (it == clients.end()) {
-        return false;
+    std::shared_ptr<IOCP_SESSION> session;
+    {
+        w32::LockGuard lock(clients_mutex);
+        auto session_it = sessions.find(client_id);
+        if (session_it == sessions.end()) {
+            return false;
+        }
+        session = session_it->second;
     }
     
-    PostWrite(client_id, message, length);
+    if (length > 0) {
+        SharedBuffer payload = SharedBuffer::Copy(message, (size_t)length);
+        if (!session->decoder.Hold(payload)) {
+            QueueWrite(client_id, session, EncodeFrame(session->decoder.mode(), payload));
+        }
+    }
     return true;
 }
 
 void IOCPServer::Broadcast(const char* message, int length, int exclude_id) {
-    w32::LockGuard lock(clients_mutex);
-    for (const auto& pair : clients) {
-        if (pair.first != exclude_id) {
-            PostWrite(pair.first, message, length);
+    if (length <= 0) {
+        return;
+    }
+    
+    std::vector<SendTarget> targets;
+    {
+        w32::LockGuard lock(clients_mutex);
+        targets.reserve(sessions.size());
+        for (const auto& pair : sessions) {
+            if (pair.first != exclude_id) {
+                targets.push_back({pair.first, pair.second});
+            }
+        }
+    }
+    
+    FanOut(targets, SharedBuffer::Copy(message, (size_t)length));
+}
+
+void IOCPServer::Multicast(const std::vector<int>& client_ids, const SharedBuffer& payload,
+                           int exclude_id) {
+    if (payload.empty()) {
+        return;
+    }
+    
+    std::vector<SendTarget> targets;
+    {
+        w32::LockGuard lock(clients_mutex);
+        targets.reserve(client_ids.size());
+        for (int client_id : client_ids) {
+            if (client_id == exclude_id) {
+                continue;
+            }
+            auto session_it = sessions.find(client_id);
+            if (session_it != sessions.end()) {
+                targets.push_back({client_id, session_it->second});
+            }
+        }
+    }
+    
+    FanOut(targets, payload);
+}
+
+void IOCPServer::FanOut(const std::vector<SendTarget>& targets, const SharedBuffer& payload) {
+    SharedBuffer binary_frame; // Encoded once, on first binary-mode target
+    for (const auto& target : targets) {
+        if (target.session->decoder.Hold(payload)) {
+            continue;
+        }
+        if (target.session->decoder.mode() == FrameMode::BINARY) {
+            if (binary_frame.empty()) {
+                binary_frame = EncodeFrame(FrameMode::BINARY, payload);
+            }
+            QueueWrite(target.client_id, target.session, binary_frame);
+        } else {
+            QueueWrite(target.client_id, target.session, payload);
         }
     }
 }
@@ -404,6 +603,25 @@ CLIENT_INFO* IOCPServer::GetClient(int client_id) {
     return nullptr;
 }
 
+bool IOCPServer::GetClientAddress(int client_id, IpAddress& address) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it != clients.end()) {
+        address = it->second.address;
+        return true;
+    }
+    return false;
+}
+
+std::shared_ptr<ConnectionActivity> IOCPServer::GetClientActivity(int client_id) {
+    w32::LockGuard lock(clients_mutex);
+    auto it = clients.find(client_id);
+    if (it != clients.end()) {
+        return it->second.activity;
+    }
+    return nullptr;
+}
+
 std::vector<CLIENT_INFO> IOCPServer::GetAllClients() {
     w32::LockGuard lock(clients_mutex);
     std::vector<CLIENT_INFO> result;
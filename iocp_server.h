@@ -1,13 +1,93 @@
 #ifndef IOCP_SERVER_H
 #define IOCP_SERVER_H
 
+// Network backend: IOCP on Windows, epoll elsewhere. The build may pick one
+// explicitly with -DCHAT_BACKEND_<NAME> (see CHAT_SERVER_BACKEND in CMake).
+#if !defined(CHAT_BACKEND_IOCP) && !defined(CHAT_BACKEND_EPOLL) && \
+    !defined(CHAT_BACKEND_IO_URING)
+#ifdef _WIN32
+#define CHAT_BACKEND_IOCP
+#else
+#define CHAT_BACKEND_EPOLL
+#endif
+#endif
+
+#if defined(CHAT_BACKEND_EPOLL)
+
+#include "epoll_server.h"
+
+// server.cpp is written against IOCPServer; on Linux that is the epoll reactor
+using IOCPServer = EpollServer;
+
+#elif defined(CHAT_BACKEND_IO_URING)
+
+#include "io_uring_server.h"
+
+using IOCPServer = IoUringServer;
+
+#else
+
+#include "framing.h"
+#include "outbound_queue.h"
 #include "sockutil.h"
+#include "strand.h"
 #include "thread_pool.h"
 #include "win32_compat.h"
+#include <memory>
 #include <unordered_map>
 #include <functional>
 #include <vector>
 
+/**
+ * @brief Per-client dispatch state kept alongside CLIENT_INFO
+ *
+ * Only one read is outstanding per client, so read completions for a
+ * session never overlap and the decoder needs no lock of its own.
+ *
+ * The session owns the socket and closes it with the last reference.
+ * Every in-flight read and write holds one, so a handle value cannot be
+ * reused by a new connection while anything may still post to it.
+ * Disconnecting only marks the session closing and cancels its I/O.
+ */
+struct IOCP_SESSION {
+    SOCKET socket = INVALID_SOCKET;
+    std::atomic<bool> closing{false};  // Set once; no new I/O after it
+    std::shared_ptr<Strand> strand;  // Serializes this client's callbacks
+    FrameDecoder decoder;
+    OutboundQueue outbound;          // One WSASend in flight at a time
+    std::shared_ptr<ConnectionActivity> activity;  // Same record as CLIENT_INFO
+
+    ~IOCP_SESSION() {
+        if (socket != INVALID_SOCKET) {
+            closesocket(socket);
+        }
+    }
+};
+
+/**
+ * @brief Context of a client's outstanding WSARecv
+ *
+ * io comes first so a completion's PER_IO_DATA (operation READ) converts
+ * back to the read context.
+ */
+struct IOCP_READ_DATA {
+    PER_IO_DATA io;
+    std::shared_ptr<IOCP_SESSION> session;
+};
+
+/**
+ * @brief Context of a client's in-flight vectored WSASend
+ *
+ * io comes first so a completion's PER_IO_DATA (operation WRITE) converts
+ * back to the write context. Holding the session keeps the queued
+ * buffers alive until the kernel is done with them.
+ */
+struct IOCP_WRITE_DATA {
+    PER_IO_DATA io;
+    WSABUF buffers[MAX_SEND_SEGMENTS];
+    std::shared_ptr<IOCP_SESSION> session;
+};
+
 /**
  * @brief High-performance IOCP-based server
  * 
@@ -19,6 +99,7 @@ public:
     using MessageHandler = std::function<void(int client_id, const char* message, int length)>;
     using ConnectHandler = std::function<void(int client_id, SOCKET socket)>;
     using DisconnectHandler = std::function<void(int client_id)>;
+    using AcceptFilter = std::function<bool(const IpAddress& address)>;
 
     /**
      * @brief Construct IOCP server
@@ -62,6 +143,15 @@ public:
      */
     void Broadcast(const char* message, int length, int exclude_id = -1);
     
+    /**
+     * @brief Send one shared payload to each listed client
+     *
+     * Recipients share the payload's bytes; binary-mode clients share one
+     * framed copy. Nothing is copied per recipient.
+     */
+    void Multicast(const std::vector<int>& client_ids, const SharedBuffer& payload,
+                   int exclude_id = -1);
+    
     /**
      * @brief Disconnect a client
      */
@@ -72,6 +162,20 @@ public:
      */
     CLIENT_INFO* GetClient(int client_id);
     
+    /**
+     * @brief Copy a client's address, or return false if it is gone
+     *
+     * The copy stays valid if the client disconnects, unlike GetClient.
+     */
+    bool GetClientAddress(int client_id, IpAddress& address);
+    
+    /**
+     * @brief Get a client's activity record, or null if it is gone
+     *
+     * The record outlives the connection for as long as a holder keeps it.
+     */
+    std::shared_ptr<ConnectionActivity> GetClientActivity(int client_id);
+    
     /**
      * @brief Get all connected clients
      */
@@ -84,7 +188,19 @@ public:
     void OnConnect(ConnectHandler handler) { on_connect = handler; }
     void OnDisconnect(DisconnectHandler handler) { on_disconnect = handler; }
 
+    /**
+     * @brief Screen new connections on the accept thread, before any
+     *        client state exists; returning false closes the socket
+     */
+    void OnAccept(AcceptFilter filter) { accept_filter = filter; }
+
 private:
+    // A fan-out recipient, resolved under clients_mutex
+    struct SendTarget {
+        int client_id;
+        std::shared_ptr<IOCP_SESSION> session;
+    };
+    
     // Core components
     HANDLE completion_port;
     SOCKET listen_socket;
@@ -97,6 +213,7 @@ private:
     // Client management
     std::unordered_map<int, CLIENT_INFO> clients;
     std::unordered_map<SOCKET, int> socket_to_id;
+    std::unordered_map<int, std::shared_ptr<IOCP_SESSION>> sessions;
     w32::Mutex clients_mutex;
     
     // Worker threads for IOCP
@@ -106,13 +223,17 @@ private:
     MessageHandler on_message;
     ConnectHandler on_connect;
     DisconnectHandler on_disconnect;
+    AcceptFilter accept_filter;
     
     // Internal methods
     void IOCPWorkerThread();
     void AcceptConnections();
-    void HandleAccept(SOCKET client_socket);
-    void PostRead(PER_IO_DATA* io_data);
-    void PostWrite(int client_id, const char* data, int length);
+    void HandleAccept(SOCKET client_socket, const IpAddress& address);
+    void PostRead(IOCP_READ_DATA* read_data);
+    void QueueWrite(int client_id, const std::shared_ptr<IOCP_SESSION>& session, SharedBuffer data);
+    void FanOut(const std::vector<SendTarget>& targets, const SharedBuffer& payload);
+    void PostWrite(IOCP_WRITE_DATA* write_data);
+    void AbortWrite(PER_IO_DATA* io_data);
     void HandleRead(PER_IO_DATA* io_data, DWORD bytes_transferred);
     void HandleWrite(PER_IO_DATA* io_data, DWORD bytes_transferred);
     void CleanupClient(int client_id);
@@ -120,4 +241,6 @@ private:
     int port_;
 };
 
+#endif // CHAT_BACKEND_EPOLL / CHAT_BACKEND_IO_URING
+
 #endif // IOCP_SERVER_H
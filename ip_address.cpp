@@ -0,0 +1,135 @@
+#include "ip_address.h"
+#include "sockutil.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+uint64_t LoadBigEndian64(const unsigned char* bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+void StoreBigEndian64(uint64_t value, unsigned char* bytes) {
+    for (int i = 7; i >= 0; --i) {
+        bytes[i] = (unsigned char)value;
+        value >>= 8;
+    }
+}
+
+// Network-order bits [0, length) set, over the 128-bit form
+void PrefixMask(int length, uint64_t& hi, uint64_t& lo) {
+    hi = length >= 64 ? ~0ull : length <= 0 ? 0 : ~0ull << (64 - length);
+    lo = length >= 128 ? ~0ull : length <= 64 ? 0 : ~0ull << (128 - length);
+}
+
+bool ParseV4(const std::string& text, IpAddress& out) {
+    in_addr address;
+    if (inet_pton(AF_INET, text.c_str(), &address) != 1) {
+        return false;
+    }
+    out = IpAddress::FromV4(ntohl(address.s_addr));
+    return true;
+}
+
+bool ParseV6(const std::string& text, IpAddress& out) {
+    in6_addr address;
+    if (inet_pton(AF_INET6, text.c_str(), &address) != 1) {
+        return false;
+    }
+    const unsigned char* bytes = (const unsigned char*)&address;
+    out.hi = LoadBigEndian64(bytes);
+    out.lo = LoadBigEndian64(bytes + 8);
+    return true;
+}
+
+} // namespace
+
+bool IpAddress::Parse(const std::string& text, IpAddress& out) {
+    if (!text.empty() && text[0] == '[') {
+        size_t close = text.find(']');
+        return close != std::string::npos && ParseV6(text.substr(1, close - 1), out);
+    }
+    if (ParseV4(text, out) || ParseV6(text, out)) {
+        return true;
+    }
+    // "a.b.c.d:port", as GetSocketAddress prints it
+    size_t colon = text.find(':');
+    return colon != std::string::npos && text.find(':', colon + 1) == std::string::npos &&
+           ParseV4(text.substr(0, colon), out);
+}
+
+bool IpAddress::FromSockaddr(const sockaddr* address, IpAddress& out) {
+    if (address->sa_family == AF_INET) {
+        const sockaddr_in* v4 = (const sockaddr_in*)address;
+        out = FromV4(ntohl(v4->sin_addr.s_addr));
+        return true;
+    }
+    if (address->sa_family == AF_INET6) {
+        const unsigned char* bytes = (const unsigned char*)&((const sockaddr_in6*)address)->sin6_addr;
+        out.hi = LoadBigEndian64(bytes);
+        out.lo = LoadBigEndian64(bytes + 8);
+        return true;
+    }
+    return false;
+}
+
+std::string IpAddress::ToString() const {
+    char text[INET6_ADDRSTRLEN];
+    if (IsV4()) {
+        in_addr address;
+        address.s_addr = htonl(V4());
+        inet_ntop(AF_INET, &address, text, sizeof(text));
+    } else {
+        in6_addr address;
+        unsigned char* bytes = (unsigned char*)&address;
+        StoreBigEndian64(hi, bytes);
+        StoreBigEndian64(lo, bytes + 8);
+        inet_ntop(AF_INET6, &address, text, sizeof(text));
+    }
+    return text;
+}
+
+bool IpPrefix::Parse(const std::string& text, IpPrefix& out) {
+    size_t slash = text.find('/');
+    IpAddress address;
+    if (!IpAddress::Parse(text.substr(0, slash), address)) {
+        return false;
+    }
+
+    int length = 128;
+    if (slash != std::string::npos) {
+        // The spelling picks the length's scale: ::ffff:0:0/96 is an IPv6
+        // length over the same block as 0.0.0.0/0
+        bool v4_text = text.find(':') == std::string::npos;
+        const char* digits = text.c_str() + slash + 1;
+        char* end = nullptr;
+        long bits = strtol(digits, &end, 10);
+        int max_bits = v4_text ? 32 : 128;
+        if (end == digits || *end != '\0' || bits < 0 || bits > max_bits) {
+            return false;
+        }
+        length = (int)bits + (v4_text ? 96 : 0);
+    }
+
+    uint64_t mask_hi, mask_lo;
+    PrefixMask(length, mask_hi, mask_lo);
+    out.address.hi = address.hi & mask_hi;
+    out.address.lo = address.lo & mask_lo;
+    out.length = length;
+    return true;
+}
+
+IpAddress IpPrefix::Last() const {
+    uint64_t mask_hi, mask_lo;
+    PrefixMask(length, mask_hi, mask_lo);
+    return IpAddress{address.hi | ~mask_hi, address.lo | ~mask_lo};
+}
+
+std::string IpPrefix::ToString() const {
+    bool v4 = address.IsV4() && length >= 96;
+    return address.ToString() + "/" + std::to_string(v4 ? length - 96 : length);
+}
@@ -0,0 +1,84 @@
+#ifndef IP_ADDRESS_H
+#define IP_ADDRESS_H
+
+#include <cstdint>
+#include <string>
+
+struct sockaddr;
+
+/**
+ * @brief Binary IPv4 or IPv6 address, without the port
+ *
+ * Always 128 bits: IPv4 is held IPv4-mapped (::ffff:a.b.c.d), so one
+ * comparison covers both families and a v4 address has one spelling.
+ */
+struct IpAddress {
+    uint64_t hi = 0;    // Network-order bits 0..63
+    uint64_t lo = 0;    // Bits 64..127
+
+    // `address` in host byte order: 1.2.3.4 is 0x01020304
+    static IpAddress FromV4(uint32_t address) {
+        return IpAddress{0, V4_MAPPED | address};
+    }
+
+    bool IsV4() const { return hi == 0 && (lo >> 32) == (V4_MAPPED >> 32); }
+    uint32_t V4() const { return (uint32_t)lo; }
+
+    /**
+     * @brief Parse "a.b.c.d", IPv6 text, or either with a port
+     *        ("a.b.c.d:port", "[v6]:port"); the port is dropped
+     */
+    static bool Parse(const std::string& text, IpAddress& out);
+
+    /**
+     * @brief Address of a sockaddr_in or sockaddr_in6
+     */
+    static bool FromSockaddr(const sockaddr* address, IpAddress& out);
+
+    /**
+     * @brief Dotted quad for IPv4, RFC 5952 text otherwise
+     */
+    std::string ToString() const;
+
+    bool operator==(const IpAddress& other) const { return hi == other.hi && lo == other.lo; }
+    bool operator!=(const IpAddress& other) const { return !(*this == other); }
+    bool operator<(const IpAddress& other) const {
+        return hi != other.hi ? hi < other.hi : lo < other.lo;
+    }
+
+    static constexpr uint64_t V4_MAPPED = 0xFFFFull << 32;
+};
+
+/**
+ * @brief CIDR block; host bits of `address` are always zero
+ */
+struct IpPrefix {
+    IpAddress address;
+    int length = 128;   // Over the 128-bit form, so IPv4 /24 is 120
+
+    /**
+     * @brief Parse an address or "address/length" (0-32 after a dotted
+     *        quad, 0-128 after IPv6 text, mapped or not); a bare address
+     *        is a single host
+     */
+    static bool Parse(const std::string& text, IpPrefix& out);
+
+    /**
+     * @brief Single-host prefix
+     */
+    static IpPrefix Host(const IpAddress& address) { return IpPrefix{address, 128}; }
+
+    IpAddress First() const { return address; }
+    IpAddress Last() const;
+
+    std::string ToString() const;
+
+    bool operator==(const IpPrefix& other) const {
+        return length == other.length && address == other.address;
+    }
+    bool operator<(const IpPrefix& other) const {
+        return address != other.address ? address < other.address : length < other.length;
+    }
+};
+
+#endif // IP_ADDRESS_H
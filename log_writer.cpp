@@ -0,0 +1,195 @@
+#include "log_writer.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Longest idle sleep; the writer re-checks for shutdown in between
+constexpr uint32_t IDLE_WAIT_MS = 1000;
+
+uint32_t ToWaitMs(std::chrono::steady_clock::duration d) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    return ms <= 0 ? 0 : (uint32_t)std::min<long long>(ms + 1, IDLE_WAIT_MS);
+}
+
+} // namespace
+
+LogWriter::LogWriter(SegmentLog& l, const MessageStore::Config& config)
+    : log(l)
+    , max_batch(std::max<size_t>(config.write_batch, 1))
+    , flush_interval(std::chrono::milliseconds(config.flush_interval_ms))
+    , sync_policy(config.sync_policy)
+    , sync_interval(std::chrono::milliseconds(config.sync_interval_ms))
+    , ring(config.write_queue_capacity)
+    , last_sync(Clock::now())
+{
+    thread = w32::Thread([this] { Run(); });
+    thread.SetName("log-writer");
+}
+
+LogWriter::~LogWriter() {
+    {
+        w32::LockGuard lock(mutex);
+        stopping = true;
+        sleeping.store(false);
+        wake_cv.notify_one();
+    }
+    thread.join();
+
+    PersistenceStats stats = GetStats();
+    if (stats.dropped > 0) {
+        std::cerr << "[LogWriter] " << stats.dropped << " of "
+                  << (stats.submitted + stats.dropped)
+                  << " messages were dropped (queue high water "
+                  << stats.queue_high_water << "/" << ring.capacity() << ")" << std::endl;
+    }
+}
+
+bool LogWriter::Submit(const ChatMessage& message) {
+    if (!ring.try_push(message)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Pairs with the fence in Run(): either the writer sees the new item
+    // before it sleeps, or we see it sleeping and wake it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) {
+        w32::LockGuard lock(mutex);
+        wake_cv.notify_one();
+    }
+    return true;
+}
+
+void LogWriter::Flush() {
+    uint64_t target = ring.pushed();
+    w32::LockGuard lock(mutex);
+    if (stopped) {
+        return;
+    }
+    flush_target = std::max(flush_target, target);
+    sleeping.store(false);
+    wake_cv.notify_one();
+    commit_cv.wait(lock, [&] { return committed.load() >= target || stopped; });
+}
+
+PersistenceStats LogWriter::GetStats() const {
+    PersistenceStats stats;
+    stats.submitted = ring.pushed();
+    stats.written = ring.popped();
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.commits = commits.load(std::memory_order_relaxed);
+    stats.syncs = syncs.load(std::memory_order_relaxed);
+    stats.queue_depth = ring.size();
+    stats.queue_high_water = high_water.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void LogWriter::Run() {
+    ChatMessage message;
+    size_t pending = 0;  // Appended since the last commit
+    Clock::time_point batch_start;
+
+    for (;;) {
+        size_t depth = ring.size();
+        if (depth > high_water.load(std::memory_order_relaxed)) {
+            high_water.store(depth, std::memory_order_relaxed);
+        }
+
+        while (pending < max_batch && ring.try_pop(message)) {
+            if (pending == 0) {
+                batch_start = Clock::now();
+            }
+            log.Append(message);
+            ++pending;
+        }
+
+        bool stop;
+        uint64_t wanted;
+        {
+            w32::LockGuard lock(mutex);
+            stop = stopping;
+            wanted = flush_target;
+        }
+
+        Clock::time_point now = Clock::now();
+        if (pending > 0 &&
+            (pending >= max_batch || stop || wanted > committed.load() ||
+             now - batch_start >= flush_interval)) {
+            Commit(now);
+            pending = 0;
+        } else if (pending == 0 && unsynced && sync_policy == SyncPolicy::INTERVAL &&
+                   now - last_sync >= sync_interval) {
+            Sync(now);
+        }
+
+        if (ring.size() > 0) {
+            continue;
+        }
+        if (stop) {
+            if (pending == 0) {
+                break;
+            }
+            continue;
+        }
+
+        // Sleep until a producer arrives, the batch window closes or an
+        // interval sync falls due
+        uint32_t wait_ms = IDLE_WAIT_MS;
+        if (pending > 0) {
+            wait_ms = ToWaitMs(flush_interval - (now - batch_start));
+        } else if (unsynced && sync_policy == SyncPolicy::INTERVAL) {
+            wait_ms = ToWaitMs(sync_interval - (now - last_sync));
+        }
+
+        // A Flush since flush_target was read above has already notified,
+        // so its target must be re-checked here rather than slept through
+        w32::LockGuard lock(mutex);
+        sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake_cv.wait_for(lock, wait_ms, [&] {
+            return !sleeping.load() || stopping || ring.size() > 0 ||
+                   flush_target > committed.load();
+        });
+        sleeping.store(false);
+    }
+
+    if (unsynced && sync_policy != SyncPolicy::NONE) {
+        Sync(Clock::now());
+    }
+
+    // Release anyone still in Flush()
+    w32::LockGuard lock(mutex);
+    stopped = true;
+    commit_cv.notify_all();
+}
+
+void LogWriter::Commit(Clock::time_point now) {
+    log.Flush();
+    unsynced = true;
+    if (sync_policy == SyncPolicy::EVERY_BATCH ||
+        (sync_policy == SyncPolicy::INTERVAL && now - last_sync >= sync_interval)) {
+        Sync(now);
+    }
+    commits.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        w32::LockGuard lock(mutex);
+        committed.store(ring.popped());
+        commit_cv.notify_all();
+    }
+
+    uint64_t drops = dropped.load(std::memory_order_relaxed);
+    if (drops != reported_drops) {
+        std::cerr << "[LogWriter] Queue full, dropped " << (drops - reported_drops)
+                  << " messages (" << drops << " total)" << std::endl;
+        reported_drops = drops;
+    }
+}
+
+void LogWriter::Sync(Clock::time_point now) {
+    log.Sync();
+    unsynced = false;
+    last_sync = now;
+    syncs.fetch_add(1, std::memory_order_relaxed);
+}
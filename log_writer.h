@@ -0,0 +1,89 @@
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include "message_store.h"
+#include "mpsc_ring.h"
+#include "segment_log.h"
+#include "win32_compat.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Background group-commit writer in front of a SegmentLog
+ *
+ * Producers hand messages to a bounded MPSC ring and return at once; the
+ * ring never blocks them. One writer thread drains the ring, appends
+ * records into the log's buffer, and commits (flushes to the OS, then
+ * optionally fsyncs) once per batch: when max_batch records are waiting,
+ * when the oldest uncommitted record is flush_interval_ms old, or when
+ * someone calls Flush(). Batch size, interval and fsync policy come from
+ * MessageStore::Config.
+ *
+ * If the disk falls behind and the ring fills, Submit() drops the message
+ * and returns false. Drops are counted in PersistenceStats and reported
+ * by the writer thread, off the producers' path.
+ */
+class LogWriter {
+public:
+    LogWriter(SegmentLog& log, const MessageStore::Config& config);
+
+    /**
+     * @brief Commit everything still queued, then stop the writer thread
+     */
+    ~LogWriter();
+
+    // Non-copyable
+    LogWriter(const LogWriter&) = delete;
+    LogWriter& operator=(const LogWriter&) = delete;
+
+    /**
+     * @brief Queue a message for the log (never blocks)
+     * @return false if the ring is full and the message was dropped
+     */
+    bool Submit(const ChatMessage& message);
+
+    /**
+     * @brief Wait until every message submitted before this call is committed
+     */
+    void Flush();
+
+    PersistenceStats GetStats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    SegmentLog& log;
+    size_t max_batch;
+    Clock::duration flush_interval;
+    SyncPolicy sync_policy;
+    Clock::duration sync_interval;
+    MpscRing<ChatMessage> ring;
+
+    w32::Mutex mutex;
+    w32::ConditionVariable wake_cv;     // Writer sleeps here
+    w32::ConditionVariable commit_cv;   // Flush() waits here
+    std::atomic<bool> sleeping{false};  // Writer is (about to be) waiting
+    bool stopping = false;              // Protected by mutex
+    bool stopped = false;               // Protected by mutex
+    uint64_t flush_target = 0;          // Protected by mutex
+
+    std::atomic<uint64_t> committed{0};  // Ring positions committed so far
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> commits{0};
+    std::atomic<uint64_t> syncs{0};
+    std::atomic<size_t> high_water{0};
+
+    // Writer thread only
+    Clock::time_point last_sync;
+    bool unsynced = false;
+    uint64_t reported_drops = 0;
+
+    w32::Thread thread;
+
+    void Run();
+    void Commit(Clock::time_point now);
+    void Sync(Clock::time_point now);
+};
+
+#endif // LOG_WRITER_H
@@ -1,27 +1,22 @@
 #include "message_store.h"
+#include "log_writer.h"
+#include "text_search.h"
 #include <algorithm>
-#include <iomanip>
 #include <iostream>
-#include <sstream>
+
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
 
 
 std::string ChatMessage::GetTimestampString() const {
-  auto time_t = std::chrono::system_clock::to_time_t(timestamp);
-  std::tm tm;
-  w32::LocalTime(&tm, &time_t);
-
-  std::stringstream ss;
-  ss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-  return ss.str();
+  return FormatTimestamp(timestamp);
 }
 
 std::string ChatMessage::ToString() const {
-  std::stringstream ss;
-  ss << "[" << GetTimestampString() << "] ";
-  ss << "[#" << room << "] ";
-  ss << sender_name << ": " << content;
-  return ss.str();
+  return FormatMessage(timestamp, room, sender_name, content);
 }
 
 MessageStore::MessageStore() : MessageStore(Config()) {}
@@ -29,115 +24,202 @@ MessageStore::MessageStore() : MessageStore(Config()) {}
 MessageStore::MessageStore(const Config &cfg) : config(cfg) {
   if (config.enable_persistence) {
     // Create log directory if it doesn't exist
+#ifdef _WIN32
     // Windows implementation using CreateDirectory
     if (GetFileAttributesA(config.log_directory.c_str()) ==
         INVALID_FILE_ATTRIBUTES) {
       CreateDirectoryA(config.log_directory.c_str(), NULL);
     }
-    OpenLogFile();
+#else
+    mkdir(config.log_directory.c_str(), 0755); // EEXIST is fine
+#endif
+    log.reset(new SegmentLog(config.log_directory,
+                             config.max_file_size_mb * 1024 * 1024));
+    if (!log->Open()) {
+      std::cerr << "[MessageStore] Failed to open message log in "
+                << config.log_directory << std::endl;
+      log.reset();
+      config.enable_persistence = false;
+    } else {
+      if (config.warm_start) {
+        WarmStart();
+      }
+      writer.reset(new LogWriter(*log, config));
+    }
   }
 }
 
 MessageStore::~MessageStore() {
-  Flush();
-  if (log_file.is_open()) {
-    log_file.close();
-  }
+  // The writer commits what is still queued before the log closes
+  writer.reset();
+  log.reset();
 }
 
-void MessageStore::Store(const ChatMessage &message) {
-  // Store in memory cache
-  {
-    w32::LockGuard lock(cache_mutex);
-    auto &messages = room_messages[message.room];
-    messages.push_back(message);
+void MessageStore::WarmStart() {
+  auto start = std::chrono::steady_clock::now();
 
-    // Trim if over limit
-    while (messages.size() > config.max_messages_per_room) {
-      messages.pop_front();
+  SYSTEM_INFO sysinfo;
+  GetSystemInfo(&sysinfo);
+  size_t segments = 0;
+  SegmentLog::RecentRecords recent = log->LoadRecent(
+      config.max_messages_per_room, sysinfo.dwNumberOfProcessors, &segments);
+
+  size_t total = 0;
+  for (auto &entry : recent) {
+    RoomId room = RoomInterner::Intern(entry.first);
+    if (room == INVALID_ROOM) {
+      continue;
     }
+    for (const LogRecord &record : entry.second) {
+      // The persisted id belonged to an earlier run's client
+      AppendToCache(room, HISTORICAL_SENDER, record.sender_name,
+                    record.content, record.timestamp);
+    }
+    total += entry.second.size();
   }
 
-  // Write to file
-  if (config.enable_persistence) {
-    WriteToFile(message);
-  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  std::cout << "[MessageStore] Warm start: " << total << " messages in "
+            << recent.size() << " rooms from " << segments << " segments in "
+            << elapsed.count() << " ms" << std::endl;
 }
 
-std::vector<ChatMessage> MessageStore::GetRecent(const std::string &room,
-                                                 size_t count) {
-  w32::LockGuard lock(cache_mutex);
+std::shared_ptr<MessageStore::CachedRoom>
+MessageStore::FindRoom(RoomId room) const {
+  w32::ReadLockGuard lock(rooms_mutex);
+  return room < rooms.size() ? rooms[room] : nullptr;
+}
 
-  std::vector<ChatMessage> result;
+std::vector<std::shared_ptr<MessageStore::CachedRoom>>
+MessageStore::AllRooms() const {
+  std::vector<std::shared_ptr<CachedRoom>> result;
+  w32::ReadLockGuard lock(rooms_mutex);
+  for (const auto &room : rooms) {
+    if (room) {
+      result.push_back(room);
+    }
+  }
+  return result;
+}
 
-  auto it = room_messages.find(room);
-  if (it == room_messages.end()) {
-    return result;
+void MessageStore::AppendToCache(
+    RoomId room, int sender_id, const std::string &sender_name,
+    const std::string &content,
+    std::chrono::system_clock::time_point timestamp) {
+  std::shared_ptr<CachedRoom> cached = FindRoom(room);
+  if (!cached) {
+    w32::WriteLockGuard lock(rooms_mutex);
+    if (room >= rooms.size()) {
+      rooms.resize(room + 1);
+    }
+    if (!rooms[room]) {
+      // Start past every sequence handed out so far, so sender handles
+      // into a cleared room never resolve in its replacement
+      rooms[room] = std::make_shared<CachedRoom>(
+          room, config.max_messages_per_room, next_order.load());
+    }
+    cached = rooms[room];
   }
 
-  const auto &messages = it->second;
-  size_t start = messages.size() > count ? messages.size() - count : 0;
+  // Sender handles change under the room lock, so they follow the ring
+  w32::LockGuard lock(cached->mutex);
+  RoomCache::Appended appended =
+      cached->cache.Append(sender_id, sender_name, content, timestamp);
+  if (appended.evicted && appended.evicted_sender != HISTORICAL_SENDER) {
+    senders.Remove(appended.evicted_sender, room, appended.evicted_sequence);
+  }
+  if (sender_id != HISTORICAL_SENDER) {
+    senders.Add(sender_id, room, appended.sequence, next_order.fetch_add(1));
+  }
+}
 
-  for (size_t i = start; i < messages.size(); ++i) {
-    result.push_back(messages[i]);
+bool MessageStore::Store(const ChatMessage &message) {
+  // Store in memory cache; the ring evicts the oldest once full
+  if (message.room != INVALID_ROOM) {
+    AppendToCache(message.room, message.sender_id, message.sender_name,
+                  message.content, message.timestamp);
   }
 
-  return result;
+  // Hand off to the background writer
+  if (writer) {
+    return writer->Submit(message);
+  }
+  return true;
 }
 
-std::vector<ChatMessage> MessageStore::GetBySender(int sender_id,
-                                                   size_t count) {
-  w32::LockGuard lock(cache_mutex);
+MessageViews MessageStore::GetRecent(const std::string &room, size_t count) {
+  RoomId id = RoomInterner::Find(room);
+  if (id == INVALID_ROOM) {
+    return {};
+  }
+  return GetRecent(id, count);
+}
 
-  std::vector<ChatMessage> result;
+MessageViews MessageStore::GetRecent(RoomId room, size_t count) {
+  MessageViews result;
+  if (std::shared_ptr<CachedRoom> cached = FindRoom(room)) {
+    w32::LockGuard lock(cached->mutex);
+    cached->cache.GetRecent(count, result);
+  }
+  return result;
+}
 
-  for (const auto &pair : room_messages) {
-    for (const auto &msg : pair.second) {
-      if (msg.sender_id == sender_id) {
-        result.push_back(msg);
-        if (result.size() >= count) {
-          return result;
-        }
+MessageViews MessageStore::GetBySender(int sender_id, size_t count) {
+  std::vector<SenderPost> posts;
+  senders.Newest(sender_id, count, posts);
+
+  // One room lock per run of posts in the same room; a post evicted since
+  // the lookup is skipped
+  MessageViews result;
+  for (size_t i = 0; i < posts.size();) {
+    size_t end = i + 1;
+    while (end < posts.size() && posts[end].room == posts[i].room) {
+      ++end;
+    }
+    if (std::shared_ptr<CachedRoom> cached = FindRoom(posts[i].room)) {
+      w32::LockGuard lock(cached->mutex);
+      for (size_t j = i; j < end; ++j) {
+        cached->cache.ViewAt(posts[j].sequence, sender_id, result);
       }
     }
+    i = end;
   }
-
   return result;
 }
 
-std::vector<ChatMessage> MessageStore::Search(const std::string &query,
-                                              const std::string &room,
-                                              size_t max_results) {
-  w32::LockGuard lock(cache_mutex);
-
-  std::vector<ChatMessage> result;
+MessageViews MessageStore::Search(const std::string &query,
+                                  const std::string &room,
+                                  size_t max_results) {
+  MessageViews result;
   std::string lower_query = query;
   std::transform(lower_query.begin(), lower_query.end(), lower_query.begin(),
                  ::tolower);
 
-  auto search_in_room = [&](const std::deque<ChatMessage> &messages) {
-    for (const auto &msg : messages) {
-      if (result.size() >= max_results)
-        break;
-
-      std::string lower_content = msg.content;
-      std::transform(lower_content.begin(), lower_content.end(),
-                     lower_content.begin(), ::tolower);
-
-      if (lower_content.find(lower_query) != std::string::npos) {
-        result.push_back(msg);
-      }
+  // The room lock covers only the index lookup; candidates are confirmed
+  // afterwards, through views that pin their bytes
+  auto search_in_room = [&](CachedRoom &cached) {
+    MessageViews candidates;
+    {
+      w32::LockGuard lock(cached.mutex);
+      cached.cache.FindCandidates(lower_query, candidates);
     }
+    result.Take(
+        std::move(candidates),
+        [&](const MessageView &msg) {
+          return ContainsIgnoreCase(msg.content, lower_query);
+        },
+        max_results);
   };
 
   if (!room.empty()) {
-    auto it = room_messages.find(room);
-    if (it != room_messages.end()) {
-      search_in_room(it->second);
+    if (std::shared_ptr<CachedRoom> cached =
+            FindRoom(RoomInterner::Find(room))) {
+      search_in_room(*cached);
     }
   } else {
-    for (const auto &pair : room_messages) {
-      search_in_room(pair.second);
+    for (const auto &cached : AllRooms()) {
+      search_in_room(*cached);
       if (result.size() >= max_results)
         break;
     }
@@ -147,85 +229,45 @@ std::vector<ChatMessage> MessageStore::Search(const std::string &query,
 }
 
 size_t MessageStore::GetTotalCount() const {
-  w32::LockGuard lock(cache_mutex);
-
   size_t total = 0;
-  for (const auto &pair : room_messages) {
-    total += pair.second.size();
+  for (const auto &cached : AllRooms()) {
+    w32::LockGuard lock(cached->mutex);
+    total += cached->cache.size();
   }
   return total;
 }
 
 void MessageStore::Clear(const std::string &room) {
-  w32::LockGuard lock(cache_mutex);
-
-  if (room.empty()) {
-    room_messages.clear();
-  } else {
-    room_messages.erase(room);
-  }
-}
-
-void MessageStore::Flush() {
-  w32::LockGuard lock(file_mutex);
-  if (log_file.is_open()) {
-    log_file.flush();
+  RoomId id = room.empty() ? INVALID_ROOM : RoomInterner::Find(room);
+  if (!room.empty() && id == INVALID_ROOM) {
+    return;
   }
-}
-
-void MessageStore::OpenLogFile() {
-  w32::LockGuard lock(file_mutex);
-
-  // Create filename with date
-  auto now = std::chrono::system_clock::now();
-  auto time_t = std::chrono::system_clock::to_time_t(now);
-  std::tm tm;
-  w32::LocalTime(&tm, &time_t);
-
-  std::stringstream filename;
-  filename << config.log_directory << "\\chat_"; // Use Windows backslash
-  filename << std::put_time(&tm, "%Y%m%d");
-  filename << ".log";
-
-  log_file.open(filename.str(), std::ios::app);
-  if (!log_file.is_open()) {
-    std::cerr << "[MessageStore] Failed to open log file: " << filename.str()
-              << std::endl;
-    config.enable_persistence = false;
-  } else {
-    // Get file size using Windows API
-    HANDLE hFile = CreateFileA(filename.str().c_str(), GENERIC_READ,
-                               FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
-                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (hFile != INVALID_HANDLE_VALUE) {
-      current_file_size = GetFileSize(hFile, NULL);
-      CloseHandle(hFile);
+  {
+    w32::WriteLockGuard lock(rooms_mutex);
+    if (id == INVALID_ROOM) {
+      rooms.clear();
+    } else if (id < rooms.size()) {
+      rooms[id].reset();
     }
   }
+  senders.Clear(id);
 }
 
-void MessageStore::RotateLogFile() {
-  if (log_file.is_open()) {
-    log_file.close();
+void MessageStore::Flush() {
+  if (writer) {
+    writer->Flush();
   }
-
-  current_file_size = 0;
-  OpenLogFile();
 }
 
-void MessageStore::WriteToFile(const ChatMessage &message) {
-  w32::LockGuard lock(file_mutex);
-
-  if (!log_file.is_open()) {
-    return;
-  }
-
-  std::string line = message.ToString() + "\n";
-  log_file << line;
-  current_file_size += line.size();
+PersistenceStats MessageStore::GetPersistenceStats() const {
+  return writer ? writer->GetStats() : PersistenceStats();
+}
 
-  // Check if rotation needed
-  if (current_file_size >= config.max_file_size_mb * 1024 * 1024) {
-    RotateLogFile();
+void MessageStore::Replay(std::chrono::system_clock::time_point since,
+                          const std::string &room,
+                          const SegmentLog::RecordHandler &handler) {
+  if (log) {
+    writer->Flush(); // Include messages still queued
+    log->Replay(since, room, handler);
   }
 }
@@ -1,26 +1,31 @@
 #ifndef MESSAGE_STORE_H
 #define MESSAGE_STORE_H
 
+#include <atomic>
 #include <string>
 #include <vector>
-#include <deque>
-#include <unordered_map>
 #include <chrono>
-#include <fstream>
+#include <memory>
+#include "room_cache.h"
+#include "room_id.h"
+#include "segment_log.h"
+#include "sender_index.h"
 #include "win32_compat.h"
 
+class LogWriter;
+
 /**
  * @brief A chat message record
  */
 struct ChatMessage {
     int sender_id;
     std::string sender_name;
-    std::string room;
+    RoomId room;                 // Name via RoomInterner::Name when displayed
     std::string content;
     std::chrono::system_clock::time_point timestamp;
     
-    ChatMessage() : sender_id(0) {}
-    ChatMessage(int id, const std::string& name, const std::string& r, const std::string& msg)
+    ChatMessage() : sender_id(0), room(INVALID_ROOM) {}
+    ChatMessage(int id, const std::string& name, RoomId r, const std::string& msg)
         : sender_id(id), sender_name(name), room(r), content(msg) {
         timestamp = std::chrono::system_clock::now();
     }
@@ -29,8 +34,24 @@ struct ChatMessage {
     std::string ToString() const;
 };
 
+/**
+ * @brief Background writer counters
+ */
+struct PersistenceStats {
+    uint64_t submitted = 0;        // Accepted by the writer queue
+    uint64_t dropped = 0;          // Rejected because the queue was full
+    uint64_t written = 0;          // Appended to the log
+    uint64_t commits = 0;
+    uint64_t syncs = 0;
+    size_t queue_depth = 0;
+    size_t queue_high_water = 0;
+};
+
 /**
  * @brief Persistent message storage with in-memory cache
+ *
+ * The cache keeps each room's newest max_messages_per_room messages in a
+ * RoomCache ring; queries return zero-copy MessageViews.
  */
 class MessageStore {
 public:
@@ -39,9 +60,17 @@ public:
      */
     struct Config {
         size_t max_messages_per_room = 100;  // In-memory cache size
-        size_t max_file_size_mb = 10;        // Max log file size before rotation
+        size_t max_file_size_mb = 10;        // Segment size before rotation
         std::string log_directory = "./chat_logs";
         bool enable_persistence = true;
+        bool warm_start = true;              // Refill the cache from the log on startup
+
+        // Background writer (see LogWriter)
+        size_t write_queue_capacity = 8192;  // Messages buffered before drops
+        size_t write_batch = 256;            // Messages per group commit
+        uint32_t flush_interval_ms = 20;     // Longest a message waits for commit
+        SyncPolicy sync_policy = SyncPolicy::INTERVAL;
+        uint32_t sync_interval_ms = 1000;    // For SyncPolicy::INTERVAL
     };
     
     explicit MessageStore(const Config& config);
@@ -55,25 +84,45 @@ public:
     
     /**
      * @brief Store a message
+     *
+     * Updates the cache and queues the message for the background writer;
+     * never waits on disk.
+     * @return false if the writer is backlogged and the message was not persisted
      */
-    void Store(const ChatMessage& message);
+    bool Store(const ChatMessage& message);
     
     /**
-     * @brief Get recent messages from a room
+     * @brief Get recent messages from a room, oldest first
      * @param room Room name
      * @param count Number of messages to retrieve
+     * @return Views into the cache, valid while the result lives
      */
-    std::vector<ChatMessage> GetRecent(const std::string& room, size_t count = 10);
+    MessageViews GetRecent(const std::string& room, size_t count = 10);
+    MessageViews GetRecent(RoomId room, size_t count = 10);
     
     /**
-     * @brief Get messages from a specific sender
+     * @brief Sender of messages recovered from the log by warm start
+     *
+     * Client ids restart at 1 with every run, so a persisted id names a
+     * different client today; recovered messages keep their sender name
+     * but are filed under this id, which no client has and which is
+     * never indexed, so GetBySender only returns this run's messages.
      */
-    std::vector<ChatMessage> GetBySender(int sender_id, size_t count = 10);
+    static constexpr int HISTORICAL_SENDER = -1;
+
+    /**
+     * @brief Get a sender's newest messages across all rooms, oldest first
+     *
+     * Served from a per-sender index, so the cost follows the number of
+     * results rather than the size of the cache. Warm-started messages
+     * are not included (see HISTORICAL_SENDER).
+     */
+    MessageViews GetBySender(int sender_id, size_t count = 10);
     
     /**
      * @brief Search messages containing text
      */
-    std::vector<ChatMessage> Search(const std::string& query, const std::string& room = "", size_t max_results = 20);
+    MessageViews Search(const std::string& query, const std::string& room = "", size_t max_results = 20);
     
     /**
      * @brief Get total message count
@@ -86,25 +135,57 @@ public:
     void Clear(const std::string& room = "");
     
     /**
-     * @brief Flush pending writes to disk
+     * @brief Wait until every stored message has been written to disk
      */
     void Flush();
 
+    /**
+     * @brief Background writer counters (all zero when persistence is off)
+     */
+    PersistenceStats GetPersistenceStats() const;
+
+    /**
+     * @brief Replay persisted messages from disk, oldest first
+     * @param since Skip messages older than this
+     * @param room Only this room (empty: all rooms)
+     * @param handler Return false to stop early
+     */
+    void Replay(std::chrono::system_clock::time_point since, const std::string& room,
+                const SegmentLog::RecordHandler& handler);
+
 private:
     Config config;
     
-    // In-memory cache per room
-    mutable w32::Mutex cache_mutex;
-    std::unordered_map<std::string, std::deque<ChatMessage>> room_messages;
-    
-    // File output
-    w32::Mutex file_mutex;
-    std::ofstream log_file;
-    size_t current_file_size = 0;
+    // In-memory cache per room, indexed by RoomId (null until first
+    // message). rooms_mutex guards only the table; each room has its own
+    // lock, so stores to different rooms never contend and a search never
+    // holds a lock while it checks content.
+    struct CachedRoom {
+        w32::Mutex mutex;
+        RoomCache cache;
+
+        CachedRoom(RoomId room, size_t capacity, uint64_t first_sequence)
+            : cache(room, capacity, first_sequence) {}
+    };
+    mutable w32::SharedMutex rooms_mutex;
+    std::vector<std::shared_ptr<CachedRoom>> rooms;
+
+    // Handles to each sender's cached messages, ordered store-wide by
+    // next_order (which also seeds new rooms' sequences)
+    SenderIndex senders;
+    std::atomic<uint64_t> next_order{0};
+
+    std::shared_ptr<CachedRoom> FindRoom(RoomId room) const;
+    std::vector<std::shared_ptr<CachedRoom>> AllRooms() const;
+    void AppendToCache(RoomId room, int sender_id, const std::string& sender_name,
+                       const std::string& content,
+                       std::chrono::system_clock::time_point timestamp);
     
-    void OpenLogFile();
-    void RotateLogFile();
-    void WriteToFile(const ChatMessage& message);
+    // Binary segment log and its writer (null when persistence is off)
+    std::unique_ptr<SegmentLog> log;
+    std::unique_ptr<LogWriter> writer;
+
+    void WarmStart();
 };
 
 #endif // MESSAGE_STORE_H
@@ -0,0 +1,108 @@
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * @brief Bounded multi-producer, single-consumer ring
+ *
+ * Each slot carries a sequence number (Vyukov's bounded queue): a
+ * producer claims a position with one CAS on the shared tail, fills the
+ * slot, then publishes it by bumping the slot's sequence. The consumer
+ * owns the head outright and never contends with producers. A full ring
+ * fails the push instead of waiting, so producers never block.
+ *
+ * Slots are constructed once up front and reused; T is moved in and out.
+ */
+template <typename T>
+class MpscRing {
+public:
+    explicit MpscRing(size_t min_capacity) {
+        size_t capacity = 2;
+        while (capacity < min_capacity) capacity <<= 1;
+        mask = capacity - 1;
+        slots.reset(new Slot[capacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    /**
+     * @brief Append an item (any thread)
+     * @return false if the ring is full; the item is left untouched
+     */
+    template <typename U>
+    bool try_push(U&& item) {
+        uint64_t pos = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots[pos & mask];
+            uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+            int64_t diff = (int64_t)(seq - pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // Consumer has not freed this slot yet
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::forward<U>(item);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest item (consumer thread only)
+     * @return false if empty (or the next producer has not finished)
+     */
+    bool try_pop(T& out) {
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[pos & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        out = std::move(slot.value);
+        slot.sequence.store(pos + mask + 1, std::memory_order_release);
+        head.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Approximate number of queued items (any thread)
+     */
+    size_t size() const {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_relaxed);
+        return t > h ? (size_t)(t - h) : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // Positions claimed by producers / consumed so far. Once popped()
+    // reaches a value pushed() returned, every item before it is out.
+    uint64_t pushed() const { return tail.load(std::memory_order_acquire); }
+    uint64_t popped() const { return head.load(std::memory_order_acquire); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(64) std::atomic<uint64_t> tail{0};  // Next position to claim
+    alignas(64) std::atomic<uint64_t> head{0};  // Written by the consumer only
+};
+
+#endif // MPSC_RING_H
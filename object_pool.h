@@ -0,0 +1,210 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include "win32_compat.h"
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+/**
+ * @brief Per-type object recycler: per-thread magazines over a lock-free depot
+ *
+ * Bonwick-style magazine layer. Each thread caches up to two magazines of
+ * MAGAZINE_SIZE free objects, so Acquire/Release are a couple of plain
+ * loads and stores. Threads exchange whole magazines with the depot, a
+ * pair of Treiber stacks (full and empty magazines) whose heads pack a
+ * 32-bit magazine index with a 32-bit tag to rule out ABA; magazines are
+ * never freed while the process runs, so a stale index is always safe to
+ * read.
+ *
+ * Objects are default-constructed once when first created and are handed
+ * out again as they were released: callers reset only the fields they
+ * need (e.g. the OVERLAPPED, not a 2 KB receive buffer).
+ */
+template <typename T, size_t MAGAZINE_SIZE = 32>
+class ObjectPool {
+public:
+    /**
+     * @brief Get an object; allocates only while the pool warms up
+     */
+    static T* Acquire() { return Cache().Acquire(); }
+
+    /**
+     * @brief Return an object for reuse by any thread
+     */
+    static void Release(T* object) { Cache().Release(object); }
+
+private:
+    static constexpr uint32_t NIL = 0xFFFFFFFFu;
+    static constexpr uint32_t CHUNK_SHIFT = 6;     // 64 magazines per chunk
+    static constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_SHIFT;
+    static constexpr uint32_t MAX_CHUNKS = 4096;   // 256K magazines per type
+
+    struct Magazine {
+        T* items[MAGAZINE_SIZE];
+        size_t count = 0;
+        uint32_t index = NIL;
+        std::atomic<uint32_t> next{NIL};
+    };
+
+    class Depot {
+    public:
+        Depot() {
+            for (auto& chunk : chunks) chunk.store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~Depot() {
+            while (Magazine* magazine = Pop(full_head)) {
+                for (size_t i = 0; i < magazine->count; ++i) delete magazine->items[i];
+            }
+            for (auto& chunk : chunks) delete[] chunk.load(std::memory_order_relaxed);
+        }
+
+        Magazine* PopFull() { return Pop(full_head); }
+
+        void PushFull(Magazine* magazine) { Push(full_head, magazine); }
+
+        void PushEmpty(Magazine* magazine) { Push(empty_head, magazine); }
+
+        // Reuse an empty magazine or carve a new one; nullptr once exhausted
+        Magazine* GetEmpty() {
+            if (Magazine* magazine = Pop(empty_head)) {
+                return magazine;
+            }
+
+            uint32_t index = magazine_count.fetch_add(1, std::memory_order_relaxed);
+            if (index >= MAX_CHUNKS * CHUNK_SIZE) {
+                return nullptr;
+            }
+            uint32_t c = index >> CHUNK_SHIFT;
+            Magazine* chunk = chunks[c].load(std::memory_order_acquire);
+            if (!chunk) {
+                w32::LockGuard lock(grow_mutex);
+                chunk = chunks[c].load(std::memory_order_acquire);
+                if (!chunk) {
+                    chunk = new Magazine[CHUNK_SIZE];
+                    for (uint32_t i = 0; i < CHUNK_SIZE; ++i) {
+                        chunk[i].index = (c << CHUNK_SHIFT) | i;
+                    }
+                    chunks[c].store(chunk, std::memory_order_release);
+                }
+            }
+            return &chunk[index & (CHUNK_SIZE - 1)];
+        }
+
+    private:
+        Magazine* Get(uint32_t index) {
+            return &chunks[index >> CHUNK_SHIFT].load(std::memory_order_acquire)[index & (CHUNK_SIZE - 1)];
+        }
+
+        static uint64_t Pack(uint64_t old_head, uint32_t index) {
+            return (((old_head >> 32) + 1) << 32) | index;
+        }
+
+        void Push(std::atomic<uint64_t>& head, Magazine* magazine) {
+            uint64_t old_head = head.load(std::memory_order_relaxed);
+            do {
+                magazine->next.store((uint32_t)old_head, std::memory_order_relaxed);
+            } while (!head.compare_exchange_weak(old_head, Pack(old_head, magazine->index),
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+        }
+
+        Magazine* Pop(std::atomic<uint64_t>& head) {
+            uint64_t old_head = head.load(std::memory_order_acquire);
+            while ((uint32_t)old_head != NIL) {
+                Magazine* magazine = Get((uint32_t)old_head);
+                uint32_t next = magazine->next.load(std::memory_order_relaxed);
+                if (head.compare_exchange_weak(old_head, Pack(old_head, next),
+                                               std::memory_order_acquire,
+                                               std::memory_order_acquire)) {
+                    return magazine;
+                }
+            }
+            return nullptr;
+        }
+
+        alignas(64) std::atomic<uint64_t> full_head{NIL};
+        alignas(64) std::atomic<uint64_t> empty_head{NIL};
+        alignas(64) std::atomic<uint32_t> magazine_count{0};
+        w32::Mutex grow_mutex;
+        std::atomic<Magazine*> chunks[MAX_CHUNKS];
+    };
+
+    class ThreadCache {
+    public:
+        T* Acquire() {
+            if (loaded && loaded->count > 0) {
+                return loaded->items[--loaded->count];
+            }
+            if (previous && previous->count > 0) {
+                std::swap(loaded, previous);
+                return loaded->items[--loaded->count];
+            }
+
+            // Both empty: trade one for a full magazine from the depot
+            Depot& depot = GetDepot();
+            if (Magazine* full = depot.PopFull()) {
+                if (previous) depot.PushEmpty(previous);
+                previous = loaded;
+                loaded = full;
+                return loaded->items[--loaded->count];
+            }
+            return new T();
+        }
+
+        void Release(T* object) {
+            if (loaded && loaded->count < MAGAZINE_SIZE) {
+                loaded->items[loaded->count++] = object;
+                return;
+            }
+            if (previous && previous->count < MAGAZINE_SIZE) {
+                std::swap(loaded, previous);
+                loaded->items[loaded->count++] = object;
+                return;
+            }
+
+            // Both full (or missing): hand one to the depot, start an empty one
+            Depot& depot = GetDepot();
+            if (previous) depot.PushFull(previous);
+            previous = loaded;
+            loaded = depot.GetEmpty();
+            if (!loaded) {
+                delete object; // Magazine table exhausted
+                return;
+            }
+            loaded->items[loaded->count++] = object;
+        }
+
+        ~ThreadCache() {
+            Depot& depot = GetDepot();
+            for (Magazine* magazine : {loaded, previous}) {
+                if (!magazine) continue;
+                if (magazine->count > 0) {
+                    depot.PushFull(magazine);
+                } else {
+                    depot.PushEmpty(magazine);
+                }
+            }
+        }
+
+    private:
+        Magazine* loaded = nullptr;
+        Magazine* previous = nullptr;
+    };
+
+    static Depot& GetDepot() {
+        static Depot depot;
+        return depot;
+    }
+
+    static ThreadCache& Cache() {
+        // Touch the depot first so it outlives every thread cache
+        static Depot& depot = GetDepot();
+        (void)depot;
+        thread_local ThreadCache cache;
+        return cache;
+    }
+};
+
+#endif // OBJECT_POOL_H
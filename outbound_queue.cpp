@@ -0,0 +1,89 @@
+#include "outbound_queue.h"
+
+OutboundQueue::PushResult OutboundQueue::Push(SharedBuffer data) {
+    w32::LockGuard lock(mutex);
+    if (queued_bytes + data.size() > MAX_PENDING_BYTES) {
+        return PushResult::BACKLOG_FULL;
+    }
+    if (data.empty()) {
+        return PushResult::QUEUED;
+    }
+
+    queued_bytes += data.size();
+    messages.push_back(std::move(data));
+
+    if (writing || parked) {
+        return PushResult::QUEUED;
+    }
+    writing = true;
+    return PushResult::START_WRITE;
+}
+
+size_t OutboundQueue::Gather(OutboundSegment* segments, size_t max_segments) {
+    w32::LockGuard lock(mutex);
+    size_t count = 0;
+    size_t offset = head_offset;
+    for (auto it = messages.begin(); it != messages.end() && count < max_segments; ++it) {
+        segments[count].data = it->data() + offset;
+        segments[count].length = it->size() - offset;
+        offset = 0;
+        ++count;
+    }
+    if (count == 0) {
+        writing = false;
+        writable_signal = false;
+    }
+    return count;
+}
+
+void OutboundQueue::Consume(size_t bytes) {
+    w32::LockGuard lock(mutex);
+    queued_bytes -= bytes;
+    while (bytes > 0 && !messages.empty()) {
+        size_t remaining = messages.front().size() - head_offset;
+        if (bytes < remaining) {
+            head_offset += bytes;
+            return;
+        }
+        bytes -= remaining;
+        messages.pop_front();
+        head_offset = 0;
+    }
+}
+
+bool OutboundQueue::Park() {
+    w32::LockGuard lock(mutex);
+    if (writable_signal) {
+        writable_signal = false;
+        return true;
+    }
+    writing = false;
+    parked = true;
+    return false;
+}
+
+bool OutboundQueue::OnWritable() {
+    w32::LockGuard lock(mutex);
+    if (writing) {
+        writable_signal = true; // Raced the writer's EAGAIN; it will retry
+        return false;
+    }
+    if (!parked) {
+        return false;
+    }
+    parked = false;
+    writing = true;
+    return true;
+}
+
+void OutboundQueue::Abort() {
+    w32::LockGuard lock(mutex);
+    writing = false;
+    parked = false;
+    writable_signal = false;
+}
+
+size_t OutboundQueue::pending_bytes() const {
+    w32::LockGuard lock(mutex);
+    return queued_bytes;
+}
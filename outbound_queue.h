@@ -0,0 +1,94 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include "shared_buffer.h"
+#include "win32_compat.h"
+#include <cstddef>
+#include <deque>
+
+// Unsent bytes allowed per client before it is dropped as a slow consumer
+constexpr size_t MAX_PENDING_BYTES = 4 * 1024 * 1024;
+
+// Buffers gathered into one vectored send (WSABUF array / iovec)
+constexpr size_t MAX_SEND_SEGMENTS = 32;
+
+/**
+ * @brief One contiguous piece of queued output
+ */
+struct OutboundSegment {
+    const char* data;
+    size_t length;
+};
+
+/**
+ * @brief Per-connection send queue with a single-writer protocol
+ *
+ * Any thread may Push. The push that finds the queue idle makes its
+ * caller the writer; the writer repeatedly Gathers the queued messages
+ * into one vectored send and Consumes what the kernel accepted, partial
+ * sends included, until Gather reports the queue drained. At most one
+ * send is therefore in flight per socket and bytes leave in push order.
+ *
+ * Messages are shared buffers, so a broadcast queues the same bytes on
+ * every connection without copying them. Gathered segments point into
+ * those buffers and stay valid until the writer consumes them.
+ */
+class OutboundQueue {
+public:
+    enum class PushResult {
+        START_WRITE,  // Caller is now the writer and must start sending
+        QUEUED,       // A write is in flight; it will pick this up
+        BACKLOG_FULL  // Over MAX_PENDING_BYTES; drop the connection
+                      // (not OVERFLOW: <math.h> on Windows defines it)
+    };
+
+    /**
+     * @brief Append a message
+     */
+    PushResult Push(SharedBuffer data);
+
+    /**
+     * @brief Writer only: fill up to max_segments from the queue head
+     * @return Segments filled; 0 means drained and the caller is no
+     *         longer the writer
+     */
+    size_t Gather(OutboundSegment* segments, size_t max_segments);
+
+    /**
+     * @brief Writer only: drop bytes the kernel accepted
+     */
+    void Consume(size_t bytes);
+
+    /**
+     * @brief Writer only: the socket would block (readiness backends)
+     *
+     * Gives up the writer role until the socket becomes writable.
+     * Returns true if writability was already signalled meanwhile, in
+     * which case the caller stays the writer and should retry now.
+     */
+    bool Park();
+
+    /**
+     * @brief Socket became writable (readiness backends)
+     * @return true if the caller must resume writing as the writer
+     */
+    bool OnWritable();
+
+    /**
+     * @brief Writer only: abandon the write role after a send error
+     */
+    void Abort();
+
+    size_t pending_bytes() const;
+
+private:
+    mutable w32::Mutex mutex;
+    std::deque<SharedBuffer> messages;
+    size_t head_offset = 0;         // Bytes of messages.front() already sent
+    size_t queued_bytes = 0;
+    bool writing = false;           // A writer owns the queue
+    bool parked = false;            // Writer gave up on EAGAIN
+    bool writable_signal = false;   // Writable edge seen while writing
+};
+
+#endif // OUTBOUND_QUEUE_H
@@ -0,0 +1,122 @@
+#include "rate_limiter.h"
+#include <algorithm>
+
+namespace {
+
+// Slots a lookup inspects before giving up; at half load the run to an
+// owner or a free slot is almost always a few slots long
+constexpr size_t MAX_PROBE = 64;
+
+// Slots a keyed lookup inspects; reclaimable slots are plentiful, so the
+// window only has to outlast a cluster of active keys
+constexpr size_t KEYED_PROBE = 8;
+
+inline size_t HashKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key;
+}
+
+} // namespace
+
+GcraLimit::GcraLimit(double rate_per_second, uint32_t burst)
+    : interval(std::max<int64_t>(1, (int64_t)(1e9 / rate_per_second)))
+    , tolerance(interval * ((int64_t)std::max<uint32_t>(burst, 1) - 1))
+{
+}
+
+bool GcraLimit::TryConsume(std::atomic<int64_t>& tat, int64_t now) const {
+    int64_t current = tat.load(std::memory_order_relaxed);
+    for (;;) {
+        int64_t start = std::max(current, now);
+        if (start - now > tolerance) {
+            return false;
+        }
+        if (tat.compare_exchange_weak(current, start + interval, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+ClientRateLimiter::ClientRateLimiter(size_t max_clients, double rate_per_second, uint32_t burst)
+    : limit(rate_per_second, burst)
+{
+    size_t size = 64;
+    while (size < max_clients * 2) size <<= 1;
+    mask = size - 1;
+    slots.reset(new Slot[size]);
+}
+
+ClientRateLimiter::Slot* ClientRateLimiter::Find(int client_id, bool claim) {
+    size_t home = (unsigned)client_id & mask;
+    for (size_t i = 0; i < MAX_PROBE; ++i) {
+        Slot& slot = slots[(home + i) & mask];
+        if (slot.owner.load(std::memory_order_acquire) == client_id) {
+            return &slot;
+        }
+    }
+    if (!claim) {
+        return nullptr;
+    }
+
+    // First use: take the nearest free slot. A client's callbacks are
+    // serialized, so only other clients compete for it
+    for (size_t i = 0; i < MAX_PROBE; ++i) {
+        Slot& slot = slots[(home + i) & mask];
+        int expected = EMPTY;
+        if (slot.owner.load(std::memory_order_relaxed) == EMPTY &&
+            slot.owner.compare_exchange_strong(expected, client_id, std::memory_order_acq_rel)) {
+            slot.tat.store(0, std::memory_order_relaxed);  // Full bucket
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+bool ClientRateLimiter::TryConsume(int client_id) {
+    Slot* slot = Find(client_id, true);
+    if (!slot) {
+        // Every nearby slot is held by a live client; let this one through
+        // rather than throttle it for the table's shape
+        return true;
+    }
+    return limit.TryConsume(slot->tat, GcraLimit::Now());
+}
+
+void ClientRateLimiter::Release(int client_id) {
+    if (Slot* slot = Find(client_id, false)) {
+        slot->owner.store(EMPTY, std::memory_order_release);
+    }
+}
+
+KeyedRateLimiter::KeyedRateLimiter(size_t size, double rate_per_second, uint32_t burst)
+    : limit(rate_per_second, burst)
+{
+    size_t capacity = 64;
+    while (capacity < size) capacity <<= 1;
+    mask = capacity - 1;
+    slots.reset(new Slot[capacity]);
+}
+
+bool KeyedRateLimiter::TryConsume(uint64_t key, int64_t now) {
+    size_t home = HashKey(key);
+    for (size_t i = 0; i < KEYED_PROBE; ++i) {
+        Slot& slot = slots[(home + i) & mask];
+        if (slot.key.load(std::memory_order_relaxed) == key) {
+            return limit.TryConsume(slot.tat, now);
+        }
+    }
+
+    // New or long idle: take over a full bucket. Its TAT is already in
+    // the past, which is a full bucket for the new key too
+    for (size_t i = 0; i < KEYED_PROBE; ++i) {
+        Slot& slot = slots[(home + i) & mask];
+        uint64_t owner = slot.key.load(std::memory_order_relaxed);
+        if (slot.tat.load(std::memory_order_relaxed) <= now &&
+            slot.key.compare_exchange_strong(owner, key, std::memory_order_relaxed)) {
+            return limit.TryConsume(slot.tat, now);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,130 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Token bucket kept as one timestamp (generic cell rate algorithm)
+ *
+ * The bucket's whole state is its theoretical arrival time (TAT): when
+ * it would next be full again if nothing else arrived. Taking a token
+ * pushes the TAT one interval later; the bucket is empty once the TAT is
+ * more than `burst` intervals ahead of now. Holds no state itself, so
+ * one limit serves any number of buckets.
+ */
+class GcraLimit {
+public:
+    /**
+     * @param rate_per_second Sustained tokens per second (> 0)
+     * @param burst Tokens a full bucket holds (>= 1)
+     */
+    GcraLimit(double rate_per_second, uint32_t burst);
+
+    /**
+     * @brief Take one token from the bucket in `tat` with a single CAS
+     *        (retried only if another thread moved the same bucket)
+     * @param now Nanoseconds on the same clock as every other call
+     * @return false if the bucket is empty; `tat` is left unchanged
+     */
+    bool TryConsume(std::atomic<int64_t>& tat, int64_t now) const;
+
+    static int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+private:
+    int64_t interval;   // Nanoseconds per token
+    int64_t tolerance;  // How far the TAT may run ahead of now
+};
+
+/**
+ * @brief Per-client token buckets in a fixed, lock-free table
+ *
+ * Each slot is an owner (client ID) and a TAT. A client claims a slot
+ * near id % size with one CAS on first use and keeps it until Release;
+ * after that every check is one CAS on its TAT. The table is sized to
+ * twice the client limit so probes stay short.
+ */
+class ClientRateLimiter {
+public:
+    ClientRateLimiter(size_t max_clients, double rate_per_second, uint32_t burst);
+
+    ClientRateLimiter(const ClientRateLimiter&) = delete;
+    ClientRateLimiter& operator=(const ClientRateLimiter&) = delete;
+
+    /**
+     * @brief Take one token from the client's bucket
+     * @return false if the client is over its rate
+     */
+    bool TryConsume(int client_id);
+
+    /**
+     * @brief Free the client's slot (on disconnect)
+     */
+    void Release(int client_id);
+
+private:
+    static constexpr int EMPTY = -1;
+
+    struct Slot {
+        std::atomic<int> owner{EMPTY};
+        std::atomic<int64_t> tat{0};
+    };
+
+    GcraLimit limit;
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+
+    Slot* Find(int client_id, bool claim);
+};
+
+/**
+ * @brief Token buckets for an open-ended key space (addresses, subnets)
+ *        in a fixed, lock-free table
+ *
+ * Unlike clients, keys never say goodbye, so slots are reclaimed by
+ * state instead: a bucket whose TAT has passed is full, exactly as if it
+ * did not exist, and any key may take it over with one CAS. Memory stays
+ * fixed however many sources show up; only keys active within their
+ * burst window hold a slot.
+ *
+ * When every slot near a key is held by an active bucket, the key is let
+ * through uncounted, so a flood of distinct sources degrades to the
+ * coarser limits rather than to throttling the sources already tracked.
+ * A bucket reclaimed while its old owner was mid-check can be charged
+ * that owner's token once; both errors are in the admitting direction.
+ */
+class KeyedRateLimiter {
+public:
+    /**
+     * @param slots Table size, rounded up to a power of two
+     */
+    KeyedRateLimiter(size_t slots, double rate_per_second, uint32_t burst);
+
+    KeyedRateLimiter(const KeyedRateLimiter&) = delete;
+    KeyedRateLimiter& operator=(const KeyedRateLimiter&) = delete;
+
+    /**
+     * @brief Take one token from the key's bucket
+     * @param now GcraLimit::Now()
+     * @return false if the key is over its rate
+     */
+    bool TryConsume(uint64_t key, int64_t now);
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> key{0};
+        std::atomic<int64_t> tat{0};
+    };
+
+    GcraLimit limit;
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+};
+
+#endif // RATE_LIMITER_H
@@ -0,0 +1,232 @@
+#include "room_cache.h"
+#include "win32_compat.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+constexpr uint32_t MIN_CHUNK_BYTES = 256;
+constexpr uint32_t MAX_CHUNK_BYTES = 16 * 1024;
+
+int64_t ToMicros(std::chrono::system_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point FromMicros(int64_t us) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::microseconds(us)));
+}
+
+} // namespace
+
+std::string FormatTimestamp(std::chrono::system_clock::time_point timestamp) {
+    auto time_t = std::chrono::system_clock::to_time_t(timestamp);
+    std::tm tm;
+    w32::LocalTime(&tm, &time_t);
+
+    std::stringstream ss;
+    ss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
+    return ss.str();
+}
+
+std::string FormatMessage(std::chrono::system_clock::time_point timestamp, RoomId room,
+                          std::string_view sender_name, std::string_view content) {
+    std::string line = "[" + FormatTimestamp(timestamp) + "] [#" + RoomInterner::Name(room) + "] ";
+    line.append(sender_name.data(), sender_name.size());
+    line += ": ";
+    line.append(content.data(), content.size());
+    return line;
+}
+
+std::string MessageView::GetTimestampString() const {
+    return FormatTimestamp(timestamp);
+}
+
+std::string MessageView::ToString() const {
+    return FormatMessage(timestamp, room, sender_name, content);
+}
+
+void MessageViews::Add(const MessageView& view, const std::shared_ptr<const ArenaChunk>& chunk) {
+    views.push_back(view);
+    // Consecutive views mostly share a chunk; pin each run once
+    if (pins.empty() || pins.back() != chunk) {
+        pins.push_back(chunk);
+    }
+}
+
+RoomCache::RoomCache(RoomId id, size_t cap, uint64_t first_sequence)
+    : room(id)
+    , capacity(std::min(std::max<size_t>(cap, 1), MAX_INDEXED_WINDOW))
+    , next_sequence(first_sequence)
+{
+}
+
+char* RoomCache::Allocate(size_t bytes, ArenaChunk*& chunk, uint32_t& offset) {
+    if (chunks.empty() || chunks.back()->capacity - chunks.back()->used < bytes) {
+        // Size chunks to an eighth of the room's live bytes, so the
+        // partly used chunks at either end waste little; oversized
+        // messages get a chunk of their own
+        uint32_t size = MIN_CHUNK_BYTES;
+        while (size < MAX_CHUNK_BYTES && size < live_bytes / 8) {
+            size <<= 1;
+        }
+        size = std::max(size, (uint32_t)bytes);
+
+        auto fresh = std::make_shared<ArenaChunk>();
+        fresh->bytes.reset(new char[size]);
+        fresh->capacity = size;
+        chunks.push_back(std::move(fresh));
+    }
+
+    chunk = chunks.back().get();
+    offset = chunk->used;
+    chunk->used += (uint32_t)bytes;
+    chunk->live++;
+    live_bytes += bytes;
+    return chunk->bytes.get() + offset;
+}
+
+void RoomCache::Evict(const Record& record) {
+    record.chunk->live--;
+    live_bytes -= RecordBytes(record);
+
+    // Records leave in arena order, so dead chunks collect at the front
+    size_t dead = 0;
+    while (dead + 1 < chunks.size() && chunks[dead]->live == 0) {
+        ++dead;
+    }
+    if (dead > 0) {
+        chunks.erase(chunks.begin(), chunks.begin() + dead);
+    }
+}
+
+RoomCache::Appended RoomCache::Append(int sender_id, const std::string& sender_name,
+                                      std::string_view content,
+                                      std::chrono::system_clock::time_point timestamp) {
+    Record record;
+    record.timestamp_us = ToMicros(timestamp);
+    record.sender_id = sender_id;
+    record.sender = NameInterner::Intern(sender_name);
+    record.length = (uint32_t)content.size();
+
+    size_t bytes = content.size();
+    uint16_t name_length = 0;
+    if (record.sender == INVALID_NAME) {
+        // Name table full: keep this name with the content instead
+        name_length = (uint16_t)std::min(sender_name.size(), (size_t)0xFFFF);
+        bytes += sizeof(name_length) + name_length;
+    }
+
+    char* dest = Allocate(bytes, record.chunk, record.offset);
+    if (record.sender == INVALID_NAME) {
+        memcpy(dest, &name_length, sizeof(name_length));
+        memcpy(dest + sizeof(name_length), sender_name.data(), name_length);
+        dest += sizeof(name_length) + name_length;
+    }
+    memcpy(dest, content.data(), content.size());
+
+    Appended result = {next_sequence, false, 0, 0};
+    index.Add((uint16_t)next_sequence++, content);
+
+    if (ring.size() < capacity) {
+        if (ring.size() == ring.capacity()) {
+            ring.reserve(std::min(capacity, std::max<size_t>(4, ring.size() * 2)));
+        }
+        ring.push_back(record);
+        ++count;
+        return result;
+    }
+    result.evicted = true;
+    result.evicted_sender = ring[head].sender_id;
+    result.evicted_sequence = result.sequence - count;
+    index.Remove((uint16_t)result.evicted_sequence, View(ring[head]).content);
+    Evict(ring[head]);
+    ring[head] = record;
+    head = (head + 1) % ring.size();
+    return result;
+}
+
+size_t RoomCache::RecordBytes(const Record& record) const {
+    if (record.sender != INVALID_NAME) {
+        return record.length;
+    }
+    uint16_t name_length;
+    memcpy(&name_length, record.chunk->bytes.get() + record.offset, sizeof(name_length));
+    return sizeof(name_length) + name_length + record.length;
+}
+
+MessageView RoomCache::View(const Record& record) const {
+    MessageView view;
+    view.sender_id = record.sender_id;
+    view.room = room;
+    view.timestamp = FromMicros(record.timestamp_us);
+
+    const char* bytes = record.chunk->bytes.get() + record.offset;
+    if (record.sender != INVALID_NAME) {
+        view.sender_name = NameInterner::Name(record.sender);
+    } else {
+        uint16_t name_length;
+        memcpy(&name_length, bytes, sizeof(name_length));
+        view.sender_name = std::string_view(bytes + sizeof(name_length), name_length);
+        bytes += sizeof(name_length) + name_length;
+    }
+    view.content = std::string_view(bytes, record.length);
+    return view;
+}
+
+std::shared_ptr<const ArenaChunk> RoomCache::Pin(const ArenaChunk* chunk) const {
+    for (size_t i = chunks.size(); i-- > 0;) {
+        if (chunks[i].get() == chunk) {
+            return chunks[i];
+        }
+    }
+    return nullptr; // Not reached: live records always have their chunk
+}
+
+void RoomCache::GetRecent(size_t max_count, MessageViews& out) const {
+    size_t skip = count > max_count ? count - max_count : 0;
+    for (size_t i = skip; i < count; ++i) {
+        const Record& record = ring[(head + i) % ring.size()];
+        out.Add(View(record), Pin(record.chunk));
+    }
+}
+
+bool RoomCache::ViewAt(uint64_t sequence, int sender_id, MessageViews& out) const {
+    uint64_t oldest = next_sequence - count;
+    if (sequence < oldest || sequence >= next_sequence) {
+        return false;
+    }
+    const Record& record = ring[(head + (size_t)(sequence - oldest)) % ring.size()];
+    if (record.sender_id != sender_id) {
+        return false;
+    }
+    out.Add(View(record), Pin(record.chunk));
+    return true;
+}
+
+void RoomCache::FindCandidates(std::string_view lower_query, MessageViews& out) const {
+    if (lower_query.size() < MIN_INDEXED_QUERY) {
+        GetRecent(count, out);
+        return;
+    }
+
+    uint16_t oldest = (uint16_t)(next_sequence - count);
+    std::vector<uint16_t> sequences;
+    index.Candidates(lower_query, oldest, sequences);
+    for (uint16_t sequence : sequences) {
+        const Record& record = ring[(head + (uint16_t)(sequence - oldest)) % ring.size()];
+        out.Add(View(record), Pin(record.chunk));
+    }
+}
+
+size_t RoomCache::MemoryUsage() const {
+    size_t bytes = sizeof(*this) + ring.capacity() * sizeof(Record) +
+                   chunks.capacity() * sizeof(chunks[0]);
+    for (const auto& chunk : chunks) {
+        bytes += sizeof(ArenaChunk) + chunk->capacity;
+    }
+    return bytes + index.MemoryUsage();
+}
@@ -0,0 +1,186 @@
+#ifndef ROOM_CACHE_H
+#define ROOM_CACHE_H
+
+#include "room_id.h"
+#include "trigram_index.h"
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Block of message bytes owned by one room
+ *
+ * Append-only: bytes are written once, before the message that owns them
+ * is published, and never touched again. Readers pin a chunk through a
+ * shared_ptr, so evicting messages never pulls bytes out from under a
+ * view.
+ */
+struct ArenaChunk {
+    std::unique_ptr<char[]> bytes;
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+    uint32_t live = 0;   // Cached messages still pointing into this chunk
+};
+
+/**
+ * @brief "YYYY-MM-DD HH:MM:SS" in local time
+ */
+std::string FormatTimestamp(std::chrono::system_clock::time_point timestamp);
+
+/**
+ * @brief "[timestamp] [#room] sender: content", as shown by #history
+ */
+std::string FormatMessage(std::chrono::system_clock::time_point timestamp, RoomId room,
+                          std::string_view sender_name, std::string_view content);
+
+/**
+ * @brief Read-only view of one cached message
+ *
+ * The string views point into the room's arena and the name table; they
+ * stay valid as long as the MessageViews holding this view.
+ */
+struct MessageView {
+    int sender_id = 0;
+    RoomId room = INVALID_ROOM;
+    std::chrono::system_clock::time_point timestamp;
+    std::string_view sender_name;
+    std::string_view content;
+
+    std::string GetTimestampString() const;
+    std::string ToString() const;
+};
+
+/**
+ * @brief Messages returned by a cache query, with the chunks they point into
+ */
+class MessageViews {
+public:
+    using const_iterator = std::vector<MessageView>::const_iterator;
+
+    const_iterator begin() const { return views.begin(); }
+    const_iterator end() const { return views.end(); }
+    size_t size() const { return views.size(); }
+    bool empty() const { return views.empty(); }
+    const MessageView& operator[](size_t i) const { return views[i]; }
+
+    void Add(const MessageView& view, const std::shared_ptr<const ArenaChunk>& chunk);
+
+    /**
+     * @brief Move over the views of `other` that pass `keep`, up to
+     *        max_results in total, along with the chunks they need
+     */
+    template <typename Predicate>
+    void Take(MessageViews&& other, Predicate&& keep, size_t max_results) {
+        for (const MessageView& view : other.views) {
+            if (views.size() >= max_results) {
+                break;
+            }
+            if (keep(view)) {
+                views.push_back(view);
+            }
+        }
+        pins.insert(pins.end(), std::make_move_iterator(other.pins.begin()),
+                    std::make_move_iterator(other.pins.end()));
+    }
+
+private:
+    std::vector<MessageView> views;
+    std::vector<std::shared_ptr<const ArenaChunk>> pins;
+};
+
+/**
+ * @brief Fixed-capacity ring of one room's most recent messages
+ *
+ * Each message is a 32-byte record: timestamp, sender ID, interned sender
+ * name and the location of its content in the room's arena. Content is
+ * bump-allocated into chunks sized to the room's live bytes (256 B to
+ * 16 KiB), so quiet rooms stay small. A chunk is dropped once every
+ * message in it has been evicted. Capacity is capped at
+ * MAX_INDEXED_WINDOW.
+ *
+ * A TrigramIndex over the content is kept in step with the ring: a
+ * message's trigrams are indexed on append and dropped on eviction,
+ * under the low 16 bits of the message's sequence.
+ *
+ * Not thread-safe; MessageStore serializes access.
+ */
+class RoomCache {
+public:
+    /**
+     * @brief What Append() did: the new message's sequence and, once the
+     *        ring is full, the message evicted to make room for it
+     */
+    struct Appended {
+        uint64_t sequence;
+        bool evicted;
+        int evicted_sender;
+        uint64_t evicted_sequence;
+    };
+
+    /**
+     * @param first_sequence Sequence of the first message; messages are
+     *        numbered consecutively from here
+     */
+    RoomCache(RoomId room, size_t capacity, uint64_t first_sequence = 0);
+
+    Appended Append(int sender_id, const std::string& sender_name, std::string_view content,
+                    std::chrono::system_clock::time_point timestamp);
+
+    size_t size() const { return count; }
+
+    /**
+     * @brief Add a view of message `sequence` if it is still cached and
+     *        was sent by `sender_id`
+     */
+    bool ViewAt(uint64_t sequence, int sender_id, MessageViews& out) const;
+
+    /**
+     * @brief Add views of the newest `max_count` messages, oldest first
+     */
+    void GetRecent(size_t max_count, MessageViews& out) const;
+
+    /**
+     * @brief Add views of messages that may contain `lower_query`, oldest
+     *        first; callers confirm each with ContainsIgnoreCase
+     *
+     * Uses the trigram index; queries too short for it get every message.
+     */
+    void FindCandidates(std::string_view lower_query, MessageViews& out) const;
+
+    /**
+     * @brief Bytes held by records, arena chunks and the search index
+     */
+    size_t MemoryUsage() const;
+
+private:
+    struct Record {
+        int64_t timestamp_us;
+        ArenaChunk* chunk;
+        int32_t sender_id;
+        NameId sender;          // INVALID_NAME: name stored inline before the content
+        uint32_t offset;
+        uint32_t length;        // Content bytes
+    };
+
+    RoomId room;
+    size_t capacity;
+    std::vector<Record> ring;   // Grows up to capacity, then wraps
+    size_t head = 0;            // Oldest record once wrapped
+    size_t count = 0;
+    size_t live_bytes = 0;      // Arena bytes of cached messages
+    uint64_t next_sequence;     // Of the next message; the oldest is next - count
+    TrigramIndex index;
+    std::vector<std::shared_ptr<ArenaChunk>> chunks;  // Oldest first; back() takes appends
+
+    char* Allocate(size_t bytes, ArenaChunk*& chunk, uint32_t& offset);
+    void Evict(const Record& record);
+    size_t RecordBytes(const Record& record) const;
+    MessageView View(const Record& record) const;
+    std::shared_ptr<const ArenaChunk> Pin(const ArenaChunk* chunk) const;
+};
+
+#endif // ROOM_CACHE_H
@@ -0,0 +1,127 @@
+#include "room_id.h"
+#include "win32_compat.h"
+#include <atomic>
+#include <unordered_map>
+
+namespace {
+
+constexpr uint32_t CHUNK_SHIFT = 8;      // 256 names per chunk
+constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_SHIFT;
+constexpr uint32_t MAX_CHUNKS = MAX_ROOM_IDS >> CHUNK_SHIFT;
+constexpr uint32_t INVALID_ID = 0xFFFFFFFFu;
+
+static_assert(MAX_NAME_IDS == MAX_ROOM_IDS, "both tables share one layout");
+
+using NameSlot = std::atomic<const std::string*>;
+
+struct Table {
+    w32::SharedMutex mutex;
+    std::unordered_map<std::string, uint32_t> ids;
+
+    // ID -> name, pointing at the map's keys (nodes never move). Chunks
+    // are published once and never freed, so readers need no lock.
+    std::atomic<NameSlot*> chunks[MAX_CHUNKS];
+
+    explicit Table(const char* first_name);
+};
+
+Table& GetRoomTable() {
+    static Table table("general"); // GENERAL_ROOM, before anyone else
+    return table;
+}
+
+Table& GetNameTable() {
+    static Table table(nullptr);
+    return table;
+}
+
+const std::string kEmptyName;
+
+uint32_t InternLocked(Table& table, const std::string& name) {
+    auto it = table.ids.find(name);
+    if (it != table.ids.end()) {
+        return it->second;
+    }
+
+    uint32_t id = (uint32_t)table.ids.size();
+    if (id >= MAX_ROOM_IDS) {
+        return INVALID_ID;
+    }
+
+    NameSlot* chunk = table.chunks[id >> CHUNK_SHIFT].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new NameSlot[CHUNK_SIZE];
+        for (uint32_t i = 0; i < CHUNK_SIZE; ++i) {
+            chunk[i].store(nullptr, std::memory_order_relaxed);
+        }
+        table.chunks[id >> CHUNK_SHIFT].store(chunk, std::memory_order_release);
+    }
+
+    it = table.ids.emplace(name, id).first;
+    chunk[id & (CHUNK_SIZE - 1)].store(&it->first, std::memory_order_release);
+    return id;
+}
+
+Table::Table(const char* first_name) {
+    for (auto& chunk : chunks) chunk.store(nullptr, std::memory_order_relaxed);
+    if (first_name) {
+        InternLocked(*this, first_name);
+    }
+}
+
+uint32_t InternIn(Table& table, const std::string& name) {
+    {
+        w32::ReadLockGuard lock(table.mutex);
+        auto it = table.ids.find(name);
+        if (it != table.ids.end()) {
+            return it->second;
+        }
+    }
+
+    w32::WriteLockGuard lock(table.mutex);
+    return InternLocked(table, name);
+}
+
+uint32_t FindIn(Table& table, const std::string& name) {
+    w32::ReadLockGuard lock(table.mutex);
+    auto it = table.ids.find(name);
+    return it != table.ids.end() ? it->second : INVALID_ID;
+}
+
+const std::string& NameIn(Table& table, uint32_t id) {
+    if (id >= MAX_ROOM_IDS) {
+        return kEmptyName;
+    }
+    NameSlot* chunk = table.chunks[id >> CHUNK_SHIFT].load(std::memory_order_acquire);
+    if (!chunk) {
+        return kEmptyName;
+    }
+    const std::string* name = chunk[id & (CHUNK_SIZE - 1)].load(std::memory_order_acquire);
+    return name ? *name : kEmptyName;
+}
+
+} // namespace
+
+RoomId RoomInterner::Intern(const std::string& name) {
+    return InternIn(GetRoomTable(), name);
+}
+
+RoomId RoomInterner::Find(const std::string& name) {
+    return FindIn(GetRoomTable(), name);
+}
+
+const std::string& RoomInterner::Name(RoomId id) {
+    return NameIn(GetRoomTable(), id);
+}
+
+NameId NameInterner::Intern(const std::string& name) {
+    return InternIn(GetNameTable(), name);
+}
+
+NameId NameInterner::Find(const std::string& name) {
+    return FindIn(GetNameTable(), name);
+}
+
+const std::string& NameInterner::Name(NameId id) {
+    return NameIn(GetNameTable(), id);
+}
@@ -0,0 +1,77 @@
+#ifndef ROOM_ID_H
+#define ROOM_ID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Small integer naming a room; hot paths carry this, not the name
+ */
+using RoomId = uint32_t;
+
+constexpr RoomId INVALID_ROOM = 0xFFFFFFFFu;
+
+// "general" is interned first, so it is always ID 0
+constexpr RoomId GENERAL_ROOM = 0;
+
+// Distinct room names the process will ever intern
+constexpr size_t MAX_ROOM_IDS = 1u << 20;
+
+/**
+ * @brief Process-wide room name <-> ID table
+ *
+ * IDs are dense and handed out in creation order, so per-room state can
+ * live in plain arrays indexed by ID. A name keeps its ID for the life of
+ * the process (a deleted and re-created room gets the same one) and names
+ * are never freed, so Name() is a lock-free load returning a stable
+ * reference. Only names of created rooms are interned; lookups of unknown
+ * names go through Find() and leave the table untouched.
+ */
+class RoomInterner {
+public:
+    /**
+     * @brief ID for a name, assigning the next one if it is new
+     * @return INVALID_ROOM once MAX_ROOM_IDS names exist
+     */
+    static RoomId Intern(const std::string& name);
+
+    /**
+     * @brief ID for a name, or INVALID_ROOM if it was never interned
+     */
+    static RoomId Find(const std::string& name);
+
+    /**
+     * @brief Name for an ID; empty for INVALID_ROOM or unknown IDs
+     */
+    static const std::string& Name(RoomId id);
+};
+
+/**
+ * @brief Small integer naming a sender (user name) in cached messages
+ */
+using NameId = uint32_t;
+
+constexpr NameId INVALID_NAME = 0xFFFFFFFFu;
+
+// Distinct sender names the process will ever intern
+constexpr size_t MAX_NAME_IDS = 1u << 20;
+
+/**
+ * @brief Process-wide sender name <-> ID table
+ *
+ * Same structure and guarantees as RoomInterner, in a separate table so
+ * user names cannot use up room IDs. Message caches store a NameId per
+ * message instead of a copy of the name.
+ */
+class NameInterner {
+public:
+    /**
+     * @return INVALID_NAME once MAX_NAME_IDS names exist
+     */
+    static NameId Intern(const std::string& name);
+    static NameId Find(const std::string& name);
+    static const std::string& Name(NameId id);
+};
+
+#endif // ROOM_ID_H
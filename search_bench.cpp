@@ -0,0 +1,123 @@
+/**
+ * @file search_bench.cpp
+ * @brief Microbenchmark for the case-insensitive search kernels
+ *
+ * Scans a synthetic corpus of chat lines with each query, once per
+ * implementation: the old lowercase-copy + std::string::find, every
+ * ContainsIgnoreCase kernel this CPU supports, then the size-based default
+ * ("auto"). All of them must agree on the number of matching messages.
+ *
+ * Usage: search_bench [messages] (default 2000000)
+ */
+
+#include "text_search.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* const WORDS[] = {
+    "hello", "World", "the", "server", "is", "DOWN", "again", "anyone", "seen",
+    "my", "Keys", "lol", "ok", "meeting", "at", "noon", "Network", "error",
+    "deploy", "rollback", "thanks", "brb", "coffee", "LGTM", "ship", "it",
+    "latency", "spike", "on", "eu-west", "#general", "ping", "pong", "12:30",
+};
+
+std::vector<std::string> BuildCorpus(size_t messages) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> word(0, std::size(WORDS) - 1);
+    std::uniform_int_distribution<int> length(3, 16);
+
+    std::vector<std::string> corpus;
+    corpus.reserve(messages);
+    for (size_t i = 0; i < messages; ++i) {
+        std::string line;
+        for (int w = length(rng); w > 0; --w) {
+            if (!line.empty()) {
+                line += ' ';
+            }
+            line += WORDS[word(rng)];
+        }
+        corpus.push_back(std::move(line));
+    }
+    return corpus;
+}
+
+// What MessageStore::Search did per message before the kernel
+bool LowercaseCopyFind(const std::string& content, const std::string& lower_query) {
+    std::string lower_content = content;
+    std::transform(lower_content.begin(), lower_content.end(), lower_content.begin(),
+                   ::tolower);
+    return lower_content.find(lower_query) != std::string::npos;
+}
+
+size_t Run(const char* name, const std::vector<std::string>& corpus, size_t corpus_bytes,
+           const std::function<bool(const std::string&)>& matches) {
+    auto start = std::chrono::steady_clock::now();
+    size_t hits = 0;
+    for (const std::string& content : corpus) {
+        hits += matches(content) ? 1 : 0;
+    }
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "  " << std::left << std::setw(18) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(9) << seconds * 1000 << " ms"
+              << std::setw(9) << corpus_bytes / seconds / 1e6 << " MB/s  " << hits
+              << " hits" << std::endl;
+    return hits;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    std::vector<std::string> corpus = BuildCorpus(messages);
+    size_t corpus_bytes = 0;
+    for (const std::string& content : corpus) {
+        corpus_bytes += content.size();
+    }
+    std::cout << "[SearchBench] " << corpus.size() << " messages, " << corpus_bytes / (1 << 20)
+              << " MiB, default kernel " << SearchKernelName(BestSearchKernel())
+              << (SearchKernelSupported(SearchKernel::AVX2) ? ", avx2 from " : "")
+              << (SearchKernelSupported(SearchKernel::AVX2) ? std::to_string(AVX2_MIN_HAYSTACK) + " bytes" : "")
+              << std::endl;
+
+    const char* const queries[] = {"ok", "lgtm", "network error", "eu-west latency", "zebra"};
+    bool agree = true;
+    for (const char* query : queries) {
+        std::string lower_query = query;
+        std::cout << "query \"" << lower_query << "\"" << std::endl;
+
+        size_t expected = Run("lowercase+find", corpus, corpus_bytes,
+                              [&](const std::string& s) { return LowercaseCopyFind(s, lower_query); });
+        for (SearchKernel kernel : {SearchKernel::SCALAR, SearchKernel::SSE2, SearchKernel::AVX2}) {
+            if (!SearchKernelSupported(kernel)) {
+                continue;
+            }
+            size_t hits = Run(SearchKernelName(kernel), corpus, corpus_bytes,
+                              [&](const std::string& s) {
+                                  return ContainsIgnoreCase(s, lower_query, kernel);
+                              });
+            if (hits != expected) {
+                std::cerr << "[SearchBench] " << SearchKernelName(kernel) << " found " << hits
+                          << ", expected " << expected << std::endl;
+                agree = false;
+            }
+        }
+        size_t hits = Run("auto", corpus, corpus_bytes,
+                          [&](const std::string& s) { return ContainsIgnoreCase(s, lower_query); });
+        if (hits != expected) {
+            std::cerr << "[SearchBench] auto found " << hits << ", expected " << expected << std::endl;
+            agree = false;
+        }
+    }
+    return agree ? 0 : 1;
+}
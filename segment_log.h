@@ -0,0 +1,169 @@
+#ifndef SEGMENT_LOG_H
+#define SEGMENT_LOG_H
+
+#include "win32_compat.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ChatMessage;
+
+// Time index entry every this many segment bytes
+constexpr uint32_t INDEX_INTERVAL_BYTES = 4096;
+
+// Room index entry on a room's first record in a segment, then every N
+constexpr uint32_t ROOM_INDEX_INTERVAL = 64;
+
+/**
+ * @brief When committed records are forced to stable storage
+ */
+enum class SyncPolicy {
+    NONE,          // Leave it to the OS page cache
+    INTERVAL,      // fsync at most once per sync interval
+    EVERY_BATCH    // fsync after every group commit
+};
+
+/**
+ * @brief One message as stored on disk
+ */
+struct LogRecord {
+    uint64_t sequence = 0;
+    std::chrono::system_clock::time_point timestamp;
+    int sender_id = 0;
+    std::string sender_name;
+    std::string room;       // Name: RoomIds are not stable across restarts
+    std::string content;
+};
+
+/**
+ * @brief Append-only binary message log split into indexed segments
+ *
+ * Each segment `chat_<first sequence>.seg` is a fixed header followed by
+ * records: a fixed 48-byte header (magic, CRC-32, length, room key,
+ * sequence, timestamp, sender, field lengths) and then the sender name,
+ * room name and content bytes. The CRC covers everything after itself,
+ * so a torn or corrupt tail is detected and cut off on open.
+ *
+ * Next to each segment, `chat_<first sequence>.idx` holds a sparse index
+ * of (timestamp, sequence, offset, room key) entries: one per
+ * INDEX_INTERVAL_BYTES of data, plus per-room entries on a room's first
+ * record and every ROOM_INDEX_INTERVAL records after. Replay uses them to
+ * seek close to a timestamp and to skip segments that never mention the
+ * requested room. The index is a hint; records are the source of truth.
+ *
+ * Integers are stored in host byte order (little-endian on every target
+ * this server builds for).
+ */
+class SegmentLog {
+public:
+    using RecordHandler = std::function<bool(const LogRecord& record)>;
+
+    /**
+     * @param directory Directory holding the segments (must exist)
+     * @param max_segment_bytes Segment size that triggers rotation
+     */
+    SegmentLog(const std::string& directory, size_t max_segment_bytes);
+    ~SegmentLog();
+
+    // Non-copyable
+    SegmentLog(const SegmentLog&) = delete;
+    SegmentLog& operator=(const SegmentLog&) = delete;
+
+    /**
+     * @brief Open the newest segment for appending (repairing a torn tail)
+     * @return false if no segment could be opened or created
+     */
+    bool Open();
+
+    /**
+     * @brief Append one message; assigns the next sequence number
+     */
+    bool Append(const ChatMessage& message);
+
+    /**
+     * @brief Push buffered records to the OS
+     */
+    void Flush();
+
+    /**
+     * @brief Flush, then force the active segment to stable storage
+     */
+    void Sync();
+
+    /**
+     * @brief Visit stored records in order
+     * @param since Skip records older than this
+     * @param room Only this room's records (empty: all rooms)
+     * @param handler Return false to stop early
+     */
+    void Replay(std::chrono::system_clock::time_point since, const std::string& room,
+                const RecordHandler& handler);
+
+    using RecentRecords = std::unordered_map<std::string, std::vector<LogRecord>>;
+
+    /**
+     * @brief Load the newest records of every room, for a warm cache
+     *
+     * The segment indexes decide which segments can still contribute;
+     * those are then read whole and scanned in parallel.
+     * @param per_room Records to keep per room
+     * @param threads Segments scanned at once
+     * @param segments_scanned Optional: how many segments were read
+     * @return Room name -> up to per_room records, oldest first
+     */
+    RecentRecords LoadRecent(size_t per_room, size_t threads, size_t* segments_scanned = nullptr);
+
+    uint64_t next_sequence() const;
+
+    /**
+     * @brief Stable 32-bit key for a room name (never 0)
+     */
+    static uint32_t RoomKey(const char* name, size_t length);
+
+private:
+    struct IndexEntry {
+        int64_t timestamp_us;
+        uint64_t sequence;
+        uint32_t offset;
+        uint32_t room_key;  // 0: time entry covering every room
+    };
+
+    struct Segment {
+        uint64_t base_sequence;
+        std::string data_path;
+        std::string index_path;
+    };
+
+    std::string directory;
+    size_t max_segment_bytes;
+
+    mutable w32::Mutex mutex;
+    std::vector<Segment> segments;    // Oldest first; back() is active
+    FILE* data_file = nullptr;
+    FILE* index_file = nullptr;
+    uint32_t segment_size = 0;        // Bytes in the active segment
+    uint32_t next_time_index = 0;     // Offset due the next time entry
+    uint64_t sequence = 0;            // Next sequence to assign
+    std::unordered_map<uint32_t, uint32_t> room_counts; // Active segment
+    std::vector<char> scratch;        // Record serialization buffer
+
+    bool CreateSegment();             // Require mutex
+    bool OpenActiveSegment();         // Require mutex
+    void CloseActiveSegment();        // Require mutex
+    void SyncActiveSegment();         // Require mutex
+    void WriteIndexEntry(const IndexEntry& entry);
+    std::string SegmentPath(uint64_t base_sequence, const char* extension) const;
+
+    static std::vector<IndexEntry> ReadIndex(const std::string& path);
+    static uint32_t SeekOffset(const std::vector<IndexEntry>& index, int64_t since_us,
+                               uint32_t room_key, bool& room_present);
+    static RecentRecords TailOfSegment(const std::string& path, size_t per_room);
+    static bool ScanSegment(const std::string& path, uint32_t start_offset, int64_t since_us,
+                            uint32_t room_key, const RecordHandler& handler, bool& stopped);
+};
+
+#endif // SEGMENT_LOG_H
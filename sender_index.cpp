@@ -0,0 +1,119 @@
+#include "sender_index.h"
+#include <algorithm>
+#include <iterator>
+#include <queue>
+
+void SenderIndex::RoomPosts::PushBack(const Handle& handle) {
+    if (size == items.size()) {
+        std::vector<Handle> grown(std::max<size_t>(4, items.size() * 2));
+        for (size_t i = 0; i < size; ++i) {
+            grown[i] = (*this)[i];
+        }
+        items.swap(grown);
+        head = 0;
+    }
+    items[(head + size) & (items.size() - 1)] = handle;
+    ++size;
+}
+
+void SenderIndex::RoomPosts::PopFront() {
+    head = (head + 1) & (items.size() - 1);
+    --size;
+}
+
+void SenderIndex::Add(int sender_id, RoomId room, uint64_t sequence, uint64_t order) {
+    Shard& shard = ShardFor(sender_id);
+    w32::LockGuard lock(shard.mutex);
+
+    std::vector<RoomPosts>& rooms = shard.senders[sender_id].rooms;
+    auto it = std::find_if(rooms.begin(), rooms.end(),
+                           [room](const RoomPosts& posts) { return posts.room == room; });
+    if (it == rooms.end()) {
+        rooms.emplace_back();
+        rooms.back().room = room;
+        it = rooms.end() - 1;
+    }
+    it->PushBack({order, sequence});
+}
+
+void SenderIndex::Remove(int sender_id, RoomId room, uint64_t sequence) {
+    Shard& shard = ShardFor(sender_id);
+    w32::LockGuard lock(shard.mutex);
+
+    auto sender = shard.senders.find(sender_id);
+    if (sender == shard.senders.end()) {
+        return;
+    }
+    std::vector<RoomPosts>& rooms = sender->second.rooms;
+    auto it = std::find_if(rooms.begin(), rooms.end(),
+                           [room](const RoomPosts& posts) { return posts.room == room; });
+    if (it == rooms.end()) {
+        return;
+    }
+
+    while (it->size > 0 && (*it)[0].sequence <= sequence) {
+        it->PopFront();
+    }
+    if (it->size == 0) {
+        rooms.erase(it);
+        if (rooms.empty()) {
+            shard.senders.erase(sender);
+        }
+    }
+}
+
+void SenderIndex::Clear(RoomId room) {
+    for (Shard& shard : shards) {
+        w32::LockGuard lock(shard.mutex);
+        if (room == INVALID_ROOM) {
+            shard.senders.clear();
+            continue;
+        }
+        for (auto it = shard.senders.begin(); it != shard.senders.end();) {
+            std::vector<RoomPosts>& rooms = it->second.rooms;
+            rooms.erase(std::remove_if(rooms.begin(), rooms.end(),
+                                       [room](const RoomPosts& posts) {
+                                           return posts.room == room;
+                                       }),
+                        rooms.end());
+            it = rooms.empty() ? shard.senders.erase(it) : std::next(it);
+        }
+    }
+}
+
+void SenderIndex::Newest(int sender_id, size_t count, std::vector<SenderPost>& out) const {
+    out.clear();
+    const Shard& shard = ShardFor(sender_id);
+    w32::LockGuard lock(shard.mutex);
+
+    auto sender = shard.senders.find(sender_id);
+    if (sender == shard.senders.end()) {
+        return;
+    }
+    const std::vector<RoomPosts>& rooms = sender->second.rooms;
+
+    // Merge the rooms' FIFOs from the back: (order, room index, position)
+    struct Cursor {
+        uint64_t order;
+        size_t room;
+        size_t position;
+        bool operator<(const Cursor& other) const { return order < other.order; }
+    };
+    std::priority_queue<Cursor> newest;
+    for (size_t r = 0; r < rooms.size(); ++r) {
+        size_t last = rooms[r].size - 1;
+        newest.push({rooms[r][last].order, r, last});
+    }
+    while (out.size() < count && !newest.empty()) {
+        Cursor cursor = newest.top();
+        newest.pop();
+        const RoomPosts& posts = rooms[cursor.room];
+        out.push_back({posts.room, posts[cursor.position].sequence});
+        if (cursor.position > 0) {
+            --cursor.position;
+            cursor.order = posts[cursor.position].order;
+            newest.push(cursor);
+        }
+    }
+    std::reverse(out.begin(), out.end());
+}
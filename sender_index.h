@@ -0,0 +1,94 @@
+#ifndef SENDER_INDEX_H
+#define SENDER_INDEX_H
+
+#include "room_id.h"
+#include "win32_compat.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+constexpr size_t SENDER_SHARDS = 16;
+
+/**
+ * @brief Where one cached message lives: its room and sequence in that room
+ */
+struct SenderPost {
+    RoomId room;
+    uint64_t sequence;
+};
+
+/**
+ * @brief Per-sender handles to the messages in the room caches
+ *
+ * For every sender, one FIFO of handles per room they have cached
+ * messages in. A room's cache evicts oldest first, so the handle of an
+ * evicted message is always at the front of its sender's FIFO for that
+ * room and is trimmed in O(1). Each handle also carries a store-wide
+ * order, so Newest() merges a sender's rooms without touching any other
+ * sender's messages.
+ *
+ * Senders are spread over SENDER_SHARDS locks. Callers add and remove
+ * while holding the room's cache lock, so each FIFO follows its room's
+ * order exactly.
+ */
+class SenderIndex {
+public:
+    void Add(int sender_id, RoomId room, uint64_t sequence, uint64_t order);
+
+    /**
+     * @brief Drop an evicted message: the sender's handles in `room` up
+     *        to and including `sequence`
+     */
+    void Remove(int sender_id, RoomId room, uint64_t sequence);
+
+    /**
+     * @brief Drop every handle into `room` (or all rooms, for INVALID_ROOM)
+     */
+    void Clear(RoomId room);
+
+    /**
+     * @brief The sender's newest `count` messages, oldest first
+     *
+     * Costs O(count * log rooms); the handles may have been evicted by the
+     * time the caller reads them, so check each against the cache.
+     */
+    void Newest(int sender_id, size_t count, std::vector<SenderPost>& out) const;
+
+private:
+    struct Handle {
+        uint64_t order;
+        uint64_t sequence;
+    };
+
+    // Circular FIFO of one sender's handles in one room
+    struct RoomPosts {
+        RoomId room;
+        std::vector<Handle> items;  // Capacity is a power of two
+        size_t head = 0;
+        size_t size = 0;
+
+        const Handle& operator[](size_t i) const {
+            return items[(head + i) & (items.size() - 1)];
+        }
+        void PushBack(const Handle& handle);
+        void PopFront();
+    };
+
+    struct Sender {
+        std::vector<RoomPosts> rooms;
+    };
+
+    struct alignas(64) Shard {
+        mutable w32::Mutex mutex;
+        std::unordered_map<int, Sender> senders;
+    };
+
+    Shard shards[SENDER_SHARDS];
+
+    Shard& ShardFor(int sender_id) { return shards[(unsigned)sender_id % SENDER_SHARDS]; }
+    const Shard& ShardFor(int sender_id) const {
+        return shards[(unsigned)sender_id % SENDER_SHARDS];
+    }
+};
+
+#endif // SENDER_INDEX_H
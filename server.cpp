@@ -13,8 +13,10 @@
 #include "connection_manager.h"
 #include "iocp_server.h"
 #include "message_store.h"
+#include "shared_buffer.h"
 #include "sockutil.h"
 #include "thread_pool.h"
+#include "timer_wheel.h"
 #include "win32_compat.h"
 
 #include <csignal>
@@ -27,9 +29,11 @@
 // Configuration
 constexpr size_t THREAD_POOL_SIZE = 0; // 0 = auto (hardware concurrency)
 constexpr int DEFAULT_PORT = 8080;
+constexpr const char *BAN_LIST_FILE = "./banlist.txt"; // Optional blocklist
 
 // Global components
 std::unique_ptr<ThreadPool> g_thread_pool;
+std::unique_ptr<TimerWheel> g_timers;
 std::unique_ptr<IOCPServer> g_server;
 std::unique_ptr<ConnectionManager> g_connection_manager;
 std::unique_ptr<ChatRoomManager> g_chat_rooms;
@@ -41,10 +45,13 @@ std::unordered_map<int, std::string> g_client_names;
 
 // Forward declarations
 void HandleMessage(int client_id, const char *message, int length);
+bool AdmitConnection(const IpAddress &address);
 void HandleConnect(int client_id, SOCKET socket);
 void HandleDisconnect(int client_id);
-void ProcessCommand(int client_id, const std::string &command);
-void BroadcastToRoom(int sender_id, const std::string &message);
+void ProcessCommand(int client_id, const std::string &name,
+                    const std::string &command);
+void BroadcastToRoom(int sender_id, const std::string &name,
+                     const std::string &message);
 void SendToClient(int client_id, const std::string &message);
 std::string GetTimestamp();
 void PrintServerLog(const std::string &message);
@@ -107,13 +114,29 @@ int main(int argc, char *argv[]) {
   PrintServerLog("Thread pool created with " + std::to_string(pool_size) +
                  " workers");
 
+  // Timer wheel: idle timeouts and mute expiry
+  g_timers = std::make_unique<TimerWheel>(std::chrono::milliseconds(100));
+
   // Connection Manager
   ConnectionManager::Config conn_config;
   conn_config.max_connections_per_second = 50;
   conn_config.max_messages_per_minute = 60;
+  conn_config.message_burst = 10;
   conn_config.connection_timeout_seconds = 300;
   conn_config.max_total_connections = 1000;
-  g_connection_manager = std::make_unique<ConnectionManager>(conn_config);
+  g_connection_manager =
+      std::make_unique<ConnectionManager>(conn_config, g_timers.get());
+  g_connection_manager->SetTimeoutHandler([](int id) {
+    PrintServerLog("Client " + std::to_string(id) + " timed out");
+    g_server->DisconnectClient(id);
+  });
+  size_t rejected = 0;
+  long long banned = g_connection_manager->LoadBanList(BAN_LIST_FILE, &rejected);
+  if (banned >= 0) {
+    PrintServerLog("Loaded " + std::to_string(banned) + " bans from " +
+                   BAN_LIST_FILE + " (" + std::to_string(rejected) +
+                   " lines rejected)");
+  }
   PrintServerLog("Connection manager initialized");
 
   // Chat Rooms
@@ -130,6 +153,7 @@ int main(int argc, char *argv[]) {
 
   // IOCP Server
   g_server = std::make_unique<IOCPServer>(port, *g_thread_pool);
+  g_server->OnAccept(AdmitConnection);
   g_server->OnMessage(HandleMessage);
   g_server->OnConnect(HandleConnect);
   g_server->OnDisconnect(HandleDisconnect);
@@ -157,27 +181,30 @@ int main(int argc, char *argv[]) {
   std::cout << "  #mute <u>  - (Admin) Mute user\n";
   std::cout << "  #exit      - Disconnect\n\n";
 
-  // Main loop - just wait for shutdown
+  // Main loop - just wait for shutdown; timeouts run on the timer wheel
   while (g_running && g_server->IsRunning()) {
     Sleep(1000);
-
-    // Periodic tasks
-    // Check for timed out connections
-    auto timed_out =
-        g_connection_manager->CheckTimeouts(g_server->GetAllClients());
-    for (int id : timed_out) {
-      PrintServerLog("Client " + std::to_string(id) + " timed out");
-      g_server->DisconnectClient(id);
-    }
   }
 
-  // Cleanup
+  // Cleanup; timers stop first so none fires into a stopped server
   PrintServerLog("Cleaning up...");
+  g_timers->Stop();
   g_server.reset();
+
+  std::string admissions = "Connections:";
+  for (size_t i = 0; i < ConnectionManager::ADMISSION_KINDS; ++i) {
+    auto result = (ConnectionManager::Admission)i;
+    admissions += std::string(i ? ", " : " ") +
+                  std::to_string(g_connection_manager->GetAdmissionCount(result)) +
+                  " " + ConnectionManager::AdmissionName(result);
+  }
+  PrintServerLog(admissions);
+
   g_message_store.reset();
   g_chat_rooms.reset();
   g_connection_manager.reset();
   g_thread_pool.reset();
+  g_timers.reset();
 
   CleanupWinsock();
   PrintServerLog("Server stopped. Goodbye!");
@@ -214,16 +241,28 @@ void SetClientName(int client_id, const std::string &name) {
   g_client_names[client_id] = name;
 }
 
-void HandleConnect(int client_id, SOCKET socket) {
-  // Check rate limiting
-  std::string ip = GetSocketAddress(socket);
-  if (!g_connection_manager->AllowConnection(ip)) {
-    PrintServerLog("Connection rejected (rate limit): " + ip);
-    g_server->DisconnectClient(client_id);
-    return;
+bool AdmitConnection(const IpAddress &address) {
+  auto result = g_connection_manager->AdmitConnection(address);
+  if (result == ConnectionManager::Admission::ADMITTED) {
+    return true;
   }
 
-  g_connection_manager->OnConnect();
+  // Log at 1, 2, 4, 8... rejects per reason: a flood must not turn into
+  // a flood of log lines
+  uint64_t count = g_connection_manager->GetAdmissionCount(result);
+  if ((count & (count - 1)) == 0) {
+    PrintServerLog("Connection rejected (" +
+                   std::string(ConnectionManager::AdmissionName(result)) +
+                   "): " + address.ToString() + ", " + std::to_string(count) +
+                   " so far");
+  }
+  return false;
+}
+
+void HandleConnect(int client_id, SOCKET socket) {
+  std::string ip = GetSocketAddress(socket);
+  g_connection_manager->OnConnect(client_id,
+                                  g_server->GetClientActivity(client_id));
 
   // Add to general room
   g_chat_rooms->JoinRoom("general", client_id);
@@ -239,10 +278,10 @@ void HandleConnect(int client_id, SOCKET socket) {
 
 void HandleDisconnect(int client_id) {
   std::string name = GetClientName(client_id);
-  std::string room = g_chat_rooms->GetClientRoom(client_id);
+  RoomId room = g_chat_rooms->GetClientRoomId(client_id);
 
   g_chat_rooms->LeaveRoom(client_id);
-  g_connection_manager->OnDisconnect();
+  g_connection_manager->OnDisconnect(client_id);
 
   {
     w32::LockGuard lock(g_clients_mutex);
@@ -254,7 +293,7 @@ void HandleDisconnect(int client_id) {
   // We need to be careful with GetRoomMembers as it returns a vector
   // and if the room is empty/deleted it returns empty.
 
-  if (room != "") {
+  if (room != INVALID_ROOM) {
     auto members = g_chat_rooms->GetRoomMembers(room);
     for (int member_id : members) {
       // Check if member is still connected is implied by being in a room list
@@ -286,7 +325,6 @@ void HandleMessage(int client_id, const char *message, int length) {
                  "You are sending too many messages. Please slow down.");
     return;
   }
-  g_connection_manager->RecordMessage(client_id);
 
   // Check mute
   if (g_connection_manager->IsMuted(client_id)) {
@@ -294,7 +332,9 @@ void HandleMessage(int client_id, const char *message, int length) {
     return;
   }
 
-  // Check if this is a name registration (first message)
+  // Check if this is a name registration (first message). Callbacks for one
+  // client run serially on its strand, so the name read here stays valid for
+  // the rest of this message and is passed down instead of re-read.
   std::string current_name = GetClientName(client_id);
   if (current_name == "User#" + std::to_string(client_id)) {
     // First message is the username
@@ -326,16 +366,16 @@ void HandleMessage(int client_id, const char *message, int length) {
 
   // Check for commands
   if (msg[0] == '#') {
-    ProcessCommand(client_id, msg);
+    ProcessCommand(client_id, current_name, msg);
     return;
   }
 
   // Regular chat message - broadcast to room
-  BroadcastToRoom(client_id, msg);
+  BroadcastToRoom(client_id, current_name, msg);
 }
 
-void ProcessCommand(int client_id, const std::string &cmd) {
-  std::string name = GetClientName(client_id);
+void ProcessCommand(int client_id, const std::string &name,
+                    const std::string &cmd) {
   std::istringstream iss(cmd);
   std::string command;
   iss >> command;
@@ -475,11 +515,11 @@ void ProcessCommand(int client_id, const std::string &cmd) {
     if (count > 50)
       count = 50;
 
-    std::string room = g_chat_rooms->GetClientRoom(client_id);
+    RoomId room = g_chat_rooms->GetClientRoomId(client_id);
     auto messages = g_message_store->GetRecent(room, count);
 
     std::string history = "Last " + std::to_string(messages.size()) +
-                          " messages in #" + room + ":\n";
+                          " messages in #" + RoomInterner::Name(room) + ":\n";
     for (const auto &msg : messages) {
       history += "  " + msg.ToString() + "\n";
     }
@@ -525,9 +565,10 @@ void ProcessCommand(int client_id, const std::string &cmd) {
     }
 
     if (target_id != -1) {
-      auto client = g_server->GetClient(target_id);
-      if (client) {
-        g_connection_manager->Ban(client->ip_address);
+      // By value: the client can disconnect as soon as the lock drops
+      IpAddress address;
+      if (g_server->GetClientAddress(target_id, address)) {
+        g_connection_manager->Ban(IpPrefix::Host(address));
         SendToClient(target_id, "You have been banned by " + name);
         g_server->DisconnectClient(target_id);
         SendToClient(client_id, "Banned IP for " + target_name);
@@ -568,26 +609,28 @@ void ProcessCommand(int client_id, const std::string &cmd) {
   }
 }
 
-void BroadcastToRoom(int sender_id, const std::string &message) {
-  std::string name = GetClientName(sender_id);
-  std::string room = g_chat_rooms->GetClientRoom(sender_id);
+void BroadcastToRoom(int sender_id, const std::string &name,
+                     const std::string &message) {
+  RoomId room = g_chat_rooms->GetClientRoomId(sender_id);
 
   // Store message
   ChatMessage chat_msg(sender_id, name, room, message);
   g_message_store->Store(chat_msg);
 
-  // Format message
+  // Format once; every member's queue shares the same bytes
   std::string formatted = name + ": " + message;
+  if (formatted.back() != '\n') {
+    formatted += '\n';
+  }
 
-  // Send to all room members
-  auto members = g_chat_rooms->GetRoomMembers(room);
-  for (int member_id : members) {
-    if (member_id != sender_id) {
-      SendToClient(member_id, formatted);
-    }
+  // Send to all room members, straight from the published snapshot
+  MemberSnapshot members = g_chat_rooms->GetMemberSnapshot(room);
+  if (members) {
+    g_server->Multicast(*members, SharedBuffer::Copy(formatted), sender_id);
   }
 
-  PrintServerLog("[#" + room + "] " + name + ": " + message);
+  PrintServerLog("[#" + RoomInterner::Name(room) + "] " + name + ": " +
+                 message);
 }
 
 void SendToClient(int client_id, const std::string &message) {
@@ -0,0 +1,80 @@
+#ifndef SHARED_BUFFER_H
+#define SHARED_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string>
+
+/**
+ * @brief Immutable, reference-counted byte buffer
+ *
+ * The bytes live in the same allocation as the count, so a payload fanned
+ * out to N connections is one allocation and N pointer-sized handles; the
+ * bytes are freed when the last outbound queue lets go of them. Handles
+ * may be copied and released from any thread.
+ */
+class SharedBuffer {
+public:
+    SharedBuffer() = default;
+
+    /**
+     * @brief Copy bytes into a new buffer (the only copy fan-out makes)
+     */
+    static SharedBuffer Copy(const char* data, size_t length) {
+        SharedBuffer buffer;
+        if (length == 0) {
+            return buffer;
+        }
+        void* memory = ::operator new(sizeof(Header) + length);
+        buffer.header = new (memory) Header(length);
+        memcpy(reinterpret_cast<char*>(buffer.header + 1), data, length);
+        return buffer;
+    }
+
+    static SharedBuffer Copy(const std::string& data) {
+        return Copy(data.data(), data.size());
+    }
+
+    SharedBuffer(const SharedBuffer& other) : header(other.header) {
+        if (header) {
+            header->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    SharedBuffer(SharedBuffer&& other) noexcept : header(other.header) {
+        other.header = nullptr;
+    }
+
+    SharedBuffer& operator=(SharedBuffer other) noexcept {
+        std::swap(header, other.header);
+        return *this;
+    }
+
+    ~SharedBuffer() {
+        if (header && header->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            header->~Header();
+            ::operator delete(header);
+        }
+    }
+
+    const char* data() const {
+        return header ? reinterpret_cast<const char*>(header + 1) : nullptr;
+    }
+
+    size_t size() const { return header ? header->size : 0; }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    struct Header {
+        explicit Header(size_t length) : size(length) {}
+        std::atomic<size_t> refs{1};
+        size_t size;
+    };
+
+    Header* header = nullptr;
+};
+
+#endif // SHARED_BUFFER_H
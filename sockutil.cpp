@@ -1,6 +1,12 @@
 #include "sockutil.h"
+#include <cstring>
 #include <iostream>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#endif
+
 // Color codes
 std::vector<std::string> colors = {
     "\033[31m",  // Red
@@ -16,6 +22,12 @@ std::vector<std::string> colors = {
  * @return true if successful
  */
 bool InitializeWinsock() {
+#ifndef _WIN32
+    // No library setup on POSIX; just make sure a peer reset surfaces as
+    // EPIPE from send() instead of killing the process.
+    signal(SIGPIPE, SIG_IGN);
+    return true;
+#else
     WSADATA wsa_data;
     int result = WSAStartup(MAKEWORD(2, 2), &wsa_data);
     if (result != 0) {
@@ -27,14 +39,17 @@ bool InitializeWinsock() {
               << LOBYTE(wsa_data.wVersion) << "." 
               << HIBYTE(wsa_data.wVersion) << std::endl;
     return true;
+#endif
 }
 
 /**
  * @brief Cleanup Winsock library
  */
 void CleanupWinsock() {
+#ifdef _WIN32
     WSACleanup();
     std::cout << "[Winsock] Cleaned up" << std::endl;
+#endif
 }
 
 /**
@@ -43,8 +58,12 @@ void CleanupWinsock() {
  * @return Socket handle or INVALID_SOCKET on error
  */
 SOCKET CreateListenSocket(int port) {
+#ifdef _WIN32
     SOCKET listen_socket = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, 
                                       NULL, 0, WSA_FLAG_OVERLAPPED);
+#else
+    SOCKET listen_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+#endif
     if (listen_socket == INVALID_SOCKET) {
         std::cerr << "[Socket] WSASocket failed: " << WSAGetLastError() << std::endl;
         return INVALID_SOCKET;
@@ -56,7 +75,7 @@ SOCKET CreateListenSocket(int port) {
     
     // Bind to address
     sockaddr_in server_addr;
-    ZeroMemory(&server_addr, sizeof(server_addr));
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
     server_addr.sin_port = htons(port);
@@ -92,13 +111,14 @@ SOCKET CreateClientSocket(const char* ip, int port) {
     }
     
     sockaddr_in server_addr;
-    ZeroMemory(&server_addr, sizeof(server_addr));
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(port);
     server_addr.sin_addr.s_addr = inet_addr(ip);
     
     if (server_addr.sin_addr.s_addr == INADDR_NONE) {
         std::cerr << "[Socket] Invalid IP address" << std::endl;
+        closesocket(client_socket);
         return INVALID_SOCKET;
     }
     
@@ -115,14 +135,24 @@ SOCKET CreateClientSocket(const char* ip, int port) {
  * @brief Set socket to non-blocking mode
  */
 void SetSocketNonBlocking(SOCKET sock) {
+#ifdef _WIN32
     u_long mode = 1;
     ioctlsocket(sock, FIONBIO, &mode);
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags != -1) {
+        fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    }
+#endif
 }
 
 /**
  * @brief Get human-readable error message
  */
 std::string GetErrorMessage(int error_code) {
+#ifndef _WIN32
+    return std::strerror(error_code);
+#else
     char* msg_buf = nullptr;
     FormatMessageA(
         FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM,
@@ -131,6 +161,7 @@ std::string GetErrorMessage(int error_code) {
     std::string message = msg_buf ? msg_buf : "Unknown error";
     LocalFree(msg_buf);
     return message;
+#endif
 }
 
 /**
@@ -138,7 +169,11 @@ std::string GetErrorMessage(int error_code) {
  */
 std::string GetSocketAddress(SOCKET sock) {
     sockaddr_in addr;
+#ifdef _WIN32
     int len = sizeof(addr);
+#else
+    socklen_t len = sizeof(addr);
+#endif
     if (getpeername(sock, (sockaddr*)&addr, &len) == 0) {
         // Use inet_ntoa for IPv4 compatibility (older but standard on Windows)
         char* ip_str = inet_ntoa(addr.sin_addr);
@@ -1,23 +1,32 @@
 #ifndef SOCKUTIL_H
 #define SOCKUTIL_H
 
+#include "connection_activity.h"
+#include "ip_address.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+
 // Windows-specific headers
 #ifndef _WIN32_WINNT
 #define _WIN32_WINNT 0x0601 // Windows 7+
 #endif
+#ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
+#endif
 // Suppress warnings for older functions
 #ifndef _WINSOCK_DEPRECATED_NO_WARNINGS
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
 #endif
 
-#include <chrono>
-#include <mswsock.h>
-#include <string>
-#include <vector>
-#include <windows.h>
+// Order matters: mswsock.h needs the winsock2 types
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <mswsock.h>
+#include <windows.h>
 
 
 #ifdef _MSC_VER
@@ -25,6 +34,25 @@
 #pragma comment(lib, "mswsock.lib")
 #endif
 
+#else // POSIX
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Winsock names used throughout the server, mapped onto BSD sockets
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+
+inline int closesocket(SOCKET sock) { return close(sock); }
+inline int WSAGetLastError() { return errno; }
+
+#endif // _WIN32
+
 // Constants
 constexpr int MAX_CLIENTS = 1000;
 constexpr int MAX_LEN = 2048;
@@ -39,8 +67,13 @@ enum class ClientState { DISCONNECTED, CONNECTED, AUTHENTICATED };
  */
 enum class IOOperation { READ, WRITE, ACCEPT };
 
+#ifdef _WIN32
+
 /**
  * @brief Extended Overlapped structure for IOCP
+ *
+ * Pooled and reused by the server; the buffer is deliberately left
+ * uninitialized since only the bytes a completion reports are ever read.
  */
 struct PER_IO_DATA {
   OVERLAPPED overlapped;
@@ -52,12 +85,12 @@ struct PER_IO_DATA {
 
   PER_IO_DATA() {
     ZeroMemory(&overlapped, sizeof(OVERLAPPED));
-    ZeroMemory(buffer, MAX_LEN);
     wsa_buf.buf = buffer;
     wsa_buf.len = MAX_LEN;
     socket = INVALID_SOCKET;
   }
 };
+#endif // _WIN32
 
 /**
  * @brief Client Information
@@ -66,11 +99,11 @@ struct CLIENT_INFO {
   int id;
   SOCKET socket;
   std::string name;
-  std::string ip_address;
+  std::string ip_address;  // Text with port, for logs
+  IpAddress address;       // Binary, for bans
   ClientState state;
   std::chrono::steady_clock::time_point connected_at;
-  std::chrono::steady_clock::time_point last_activity;
-  int message_count = 0;
+  std::shared_ptr<ConnectionActivity> activity; // Shared with ConnectionManager
   std::string current_room;
 };
 
@@ -80,6 +113,6 @@ bool InitializeWinsock();
 void CleanupWinsock();
 SOCKET CreateListenSocket(int port);
 SOCKET CreateClientSocket(const char *ip, int port);
-void SetNonBlocking(SOCKET sock);
+void SetSocketNonBlocking(SOCKET sock);
 
 #endif // SOCKUTIL_H
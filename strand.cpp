@@ -0,0 +1,68 @@
+#include "strand.h"
+#include <iostream>
+
+Strand::Strand(ThreadPool& pool) : pool(pool) {
+    // Vyukov MPSC list: tail always points at an already-consumed stub
+    TaskNode* stub = TaskNode::Acquire();
+    head.store(stub, std::memory_order_relaxed);
+    tail = stub;
+}
+
+Strand::~Strand() {
+    // Tasks still queued here were dropped by a stopped pool
+    while (tail) {
+        TaskNode* next = tail->next.load(std::memory_order_relaxed);
+        TaskNode::Release(tail);
+        tail = next;
+    }
+}
+
+void Strand::post(Task task) {
+    TaskNode* node = TaskNode::Acquire();
+    node->task = std::move(task);
+
+    TaskNode* prev = head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+
+    // First task into an idle strand schedules it
+    if (pending_count.fetch_add(1, std::memory_order_acq_rel) == 0) {
+        auto self = shared_from_this();
+        pool.enqueue([self]() { self->Drain(); });
+    }
+}
+
+TaskNode* Strand::PopNode() {
+    // A producer may have swapped head but not linked next yet; its count
+    // is already visible, so the link is at most a few instructions away
+    TaskNode* next = tail->next.load(std::memory_order_acquire);
+    while (next == nullptr) {
+        next = tail->next.load(std::memory_order_acquire);
+    }
+
+    TaskNode::Release(tail);
+    tail = next;
+    return next; // Becomes the new stub once its task has run
+}
+
+void Strand::Drain() {
+    for (int i = 0; i < DRAIN_BATCH; ++i) {
+        TaskNode* node = PopNode();
+
+        try {
+            node->task();
+        } catch (const std::exception& e) {
+            std::cerr << "[Strand] Task exception: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "[Strand] Unknown task exception" << std::endl;
+        }
+        node->task.reset(); // Release captures before the next task runs
+
+        if (pending_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            return; // Idle; the next post reschedules
+        }
+    }
+
+    // Still busy: yield the worker so one chatty client cannot starve others
+    auto self = shared_from_this();
+    pool.enqueue([self]() { self->Drain(); });
+}
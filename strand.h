@@ -0,0 +1,53 @@
+#ifndef STRAND_H
+#define STRAND_H
+
+#include "task.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief Serial executor on top of ThreadPool
+ *
+ * Tasks posted to one strand run in FIFO order and never concurrently,
+ * but on whichever pool worker picks the strand up. Posting is wait-free
+ * (one exchange on an MPSC list of recycled TaskNodes plus one counter
+ * increment); only the post that finds the strand idle schedules it on
+ * the pool.
+ *
+ * Each connection owns one strand, so all callbacks for a client
+ * (connect, messages, disconnect) are serialized without a per-client lock.
+ * Always create with std::make_shared: scheduled drains hold a reference.
+ */
+class Strand : public std::enable_shared_from_this<Strand> {
+public:
+    explicit Strand(ThreadPool& pool);
+    ~Strand();
+
+    Strand(const Strand&) = delete;
+    Strand& operator=(const Strand&) = delete;
+
+    /**
+     * @brief Queue a task behind everything already posted to this strand
+     */
+    void post(Task task);
+
+    /**
+     * @brief Number of tasks posted but not yet finished
+     */
+    size_t pending() const { return pending_count.load(std::memory_order_relaxed); }
+
+private:
+    // Tasks run per pool slot before the strand yields its worker
+    static constexpr int DRAIN_BATCH = 64;
+
+    void Drain();
+    TaskNode* PopNode();
+
+    ThreadPool& pool;
+    std::atomic<size_t> pending_count{0};
+    alignas(64) std::atomic<TaskNode*> head; // Producers swap in here
+    alignas(64) TaskNode* tail;              // Consumer side (the draining worker)
+};
+
+#endif // STRAND_H
@@ -0,0 +1,20 @@
+#include "task.h"
+#include "object_pool.h"
+
+namespace {
+
+// I/O threads mostly acquire and pool workers mostly release, so whole
+// magazines flow between them through the pool's lock-free depot
+using TaskNodePool = ObjectPool<TaskNode, 128>;
+
+} // namespace
+
+TaskNode* TaskNode::Acquire() {
+    return TaskNodePool::Acquire();
+}
+
+void TaskNode::Release(TaskNode* node) {
+    node->task.reset();
+    node->next.store(nullptr, std::memory_order_relaxed);
+    TaskNodePool::Release(node);
+}
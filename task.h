@@ -0,0 +1,136 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Move-only callable with inline storage
+ *
+ * Replacement for std::function<void()> on the dispatch path. Callables up
+ * to TASK_INLINE_SIZE bytes (e.g. [this, client_id, std::string message])
+ * are stored in place; larger ones fall back to the heap. Unlike
+ * std::function it never copies, so captured strings are only ever moved.
+ */
+constexpr size_t TASK_INLINE_SIZE = 96;
+
+class Task {
+public:
+    Task() noexcept : ops(nullptr) {}
+
+    template <typename F,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) : ops(nullptr) {
+        using Fn = typename std::decay<F>::type;
+        if constexpr (FitsInline<Fn>()) {
+            new (storage) Fn(std::forward<F>(f));
+            ops = &InlineOps<Fn>::table;
+        } else {
+            *reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(f));
+            ops = &HeapOps<Fn>::table;
+        }
+    }
+
+    Task(Task&& other) noexcept : ops(other.ops) {
+        if (ops) {
+            ops->move(storage, other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops) {
+                ops = other.ops;
+                ops->move(storage, other.storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops->invoke(storage); }
+    explicit operator bool() const { return ops != nullptr; }
+
+    /**
+     * @brief Destroy the held callable (and its captures) now
+     */
+    void reset() noexcept {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* dst, void* src); // Leaves src destroyed
+        void (*destroy)(void* storage);
+    };
+
+    template <typename Fn>
+    static constexpr bool FitsInline() {
+        return sizeof(Fn) <= TASK_INLINE_SIZE &&
+               alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    template <typename Fn>
+    struct InlineOps {
+        static void Invoke(void* s) { (*static_cast<Fn*>(s))(); }
+        static void Move(void* dst, void* src) {
+            new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        }
+        static void Destroy(void* s) { static_cast<Fn*>(s)->~Fn(); }
+        static constexpr Ops table = {&Invoke, &Move, &Destroy};
+    };
+
+    template <typename Fn>
+    struct HeapOps {
+        static void Invoke(void* s) { (**static_cast<Fn**>(s))(); }
+        static void Move(void* dst, void* src) {
+            *static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+        }
+        static void Destroy(void* s) { delete *static_cast<Fn**>(s); }
+        static constexpr Ops table = {&Invoke, &Move, &Destroy};
+    };
+
+    alignas(std::max_align_t) unsigned char storage[TASK_INLINE_SIZE];
+    const Ops* ops;
+};
+
+/**
+ * @brief Recyclable list node carrying one Task
+ *
+ * Used by ThreadPool inboxes and Strand queues; `next` links the node into
+ * whichever list currently owns it. Nodes come from per-thread caches, so
+ * steady-state dispatch does not touch the global allocator.
+ */
+struct TaskNode {
+    std::atomic<TaskNode*> next{nullptr};
+    Task task;
+
+    /**
+     * @brief Get an empty node from the calling thread's cache
+     */
+    static TaskNode* Acquire();
+
+    /**
+     * @brief Destroy the node's task and return it to the calling thread's cache
+     */
+    static void Release(TaskNode* node);
+};
+
+#endif // TASK_H
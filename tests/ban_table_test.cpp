@@ -0,0 +1,258 @@
+#include "ban_table.h"
+#include "check.h"
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+IpAddress Addr(const char* text) {
+    IpAddress address;
+    if (!IpAddress::Parse(text, address)) {
+        std::fprintf(stderr, "bad test address %s\n", text);
+        ++CheckFailures();
+    }
+    return address;
+}
+
+IpPrefix Prefix(const char* text) {
+    IpPrefix prefix;
+    if (!IpPrefix::Parse(text, prefix)) {
+        std::fprintf(stderr, "bad test prefix %s\n", text);
+        ++CheckFailures();
+    }
+    return prefix;
+}
+
+bool Banned(const IpBanTable& table, const char* text) {
+    return table.IsBanned(Addr(text));
+}
+
+void TestAdjacentAndOverlapping() {
+    IpBanTable table;
+
+    // Two halves of a /24 merge into one range
+    CHECK(table.Ban(Prefix("10.0.0.0/25")));
+    CHECK(table.Ban(Prefix("10.0.0.128/25")));
+    CHECK(!Banned(table, "9.255.255.255"));
+    CHECK(Banned(table, "10.0.0.0"));
+    CHECK(Banned(table, "10.0.0.127"));
+    CHECK(Banned(table, "10.0.0.128"));
+    CHECK(Banned(table, "10.0.0.255"));
+    CHECK(!Banned(table, "10.0.1.0"));
+
+    // Adjacent /24s with a one-block gap stay two ranges
+    CHECK(table.Ban(Prefix("10.2.0.0/24")));
+    CHECK(table.Ban(Prefix("10.2.1.0/24")));
+    CHECK(table.Ban(Prefix("10.2.3.0/24")));
+    CHECK(Banned(table, "10.2.1.255"));
+    CHECK(!Banned(table, "10.2.2.0"));
+    CHECK(!Banned(table, "10.2.2.255"));
+    CHECK(Banned(table, "10.2.3.0"));
+    CHECK(!Banned(table, "10.2.4.0"));
+
+    // Nested and overlapping blocks: the widest one decides the edges
+    CHECK(table.Ban(Prefix("10.1.128.0/17")));
+    CHECK(table.Ban(Prefix("10.1.200.5")));
+    CHECK(table.Ban(Prefix("10.1.0.0/16")));
+    CHECK(!table.Ban(Prefix("10.1.0.0/16")));  // Already present
+    CHECK(!table.Ban(Prefix("10.1.0.7/16")));  // Same block, host bits ignored
+    CHECK(Banned(table, "10.1.0.0"));
+    CHECK(Banned(table, "10.1.127.255"));
+    CHECK(Banned(table, "10.1.200.5"));
+    CHECK(Banned(table, "10.1.255.255"));
+    CHECK(!Banned(table, "10.0.255.255"));
+
+    CHECK_EQ(table.size(), 8u);
+}
+
+void TestRangeCrossingSixteenBoundary() {
+    IpBanTable table;
+
+    // Merged from two /25s on either side of 10.7.0.0: the range starts
+    // in the 10.6 bucket and the 10.7 bucket must still find it
+    CHECK(table.Ban(Prefix("10.6.255.128/25")));
+    CHECK(table.Ban(Prefix("10.7.0.0/25")));
+    CHECK(!Banned(table, "10.6.255.127"));
+    CHECK(Banned(table, "10.6.255.128"));
+    CHECK(Banned(table, "10.6.255.255"));
+    CHECK(Banned(table, "10.7.0.0"));
+    CHECK(Banned(table, "10.7.0.127"));
+    CHECK(!Banned(table, "10.7.0.128"));
+
+    // A single block spanning many buckets
+    CHECK(table.Ban(Prefix("11.0.0.0/8")));
+    CHECK(!Banned(table, "10.255.255.255"));
+    CHECK(Banned(table, "11.0.0.0"));
+    CHECK(Banned(table, "11.128.77.1"));
+    CHECK(Banned(table, "11.255.255.255"));
+    CHECK(!Banned(table, "12.0.0.0"));
+
+    // The ends of the address space
+    CHECK(table.Ban(Prefix("255.255.255.0/24")));
+    CHECK(table.Ban(Prefix("0.0.0.0/24")));
+    CHECK(Banned(table, "255.255.255.255"));
+    CHECK(Banned(table, "0.0.0.0"));
+    CHECK(!Banned(table, "0.0.1.0"));
+    CHECK(!Banned(table, "255.255.254.255"));
+}
+
+void TestMappedBlockVersusNativeV6() {
+    IpBanTable table;
+
+    // ::ffff:0:0/96 is exactly the IPv4 space, spelt as IPv6
+    IpPrefix mapped = Prefix("::ffff:0:0/96");
+    CHECK(mapped == Prefix("0.0.0.0/0"));
+    CHECK(table.Ban(mapped));
+    CHECK(!table.Ban(Prefix("0.0.0.0/0")));
+    CHECK(Banned(table, "0.0.0.0"));
+    CHECK(Banned(table, "1.2.3.4"));
+    CHECK(Banned(table, "::ffff:1.2.3.4"));
+    CHECK(Banned(table, "255.255.255.255"));
+    CHECK(!Banned(table, "::1"));
+    CHECK(!Banned(table, "::fffe:ffff:ffff"));   // Just below the block
+    CHECK(!Banned(table, "::1:0:0:0"));          // Just above it
+    CHECK(!Banned(table, "2001:db8::1"));
+    CHECK(table.Unban(Prefix("0.0.0.0/0")));
+    CHECK(!Banned(table, "1.2.3.4"));
+
+    // A native IPv6 ban leaves IPv4 alone
+    CHECK(table.Ban(Prefix("2001:db8::/32")));
+    CHECK(Banned(table, "2001:db8::1"));
+    CHECK(Banned(table, "[2001:db8:ffff::1]:443"));
+    CHECK(!Banned(table, "2001:db9::"));
+    CHECK(!Banned(table, "32.1.13.184"));  // 0x20010db8 as IPv4
+
+    // An IPv6 block wider than the mapped space covers IPv4 too
+    CHECK(table.Ban(Prefix("::/80")));
+    CHECK(Banned(table, "::1"));
+    CHECK(Banned(table, "8.8.8.8"));
+    CHECK(!Banned(table, "::1:0:0:0"));
+    CHECK(table.Unban(Prefix("::/80")));
+    CHECK(!Banned(table, "8.8.8.8"));
+    CHECK(!Banned(table, "::1"));
+}
+
+void TestUnbanNested() {
+    IpBanTable table;
+    CHECK(table.Ban(Prefix("10.8.0.0/16")));
+    CHECK(table.Ban(Prefix("10.8.5.0/24")));
+
+    // Lifting the inner ban leaves the outer one covering it
+    CHECK(table.Unban(Prefix("10.8.5.0/24")));
+    CHECK(!table.Unban(Prefix("10.8.5.0/24")));
+    CHECK(!table.Unban(Prefix("10.8.7.0/24")));  // Never banned, though covered
+    CHECK(Banned(table, "10.8.5.1"));
+    CHECK(Banned(table, "10.8.6.1"));
+
+    // The other order: the inner ban survives the outer one
+    CHECK(table.Ban(Prefix("10.8.5.0/24")));
+    CHECK(table.Unban(Prefix("10.8.0.0/16")));
+    CHECK(Banned(table, "10.8.5.1"));
+    CHECK(!Banned(table, "10.8.6.1"));
+    CHECK(!Banned(table, "10.8.4.255"));
+    CHECK(table.Unban(Prefix("10.8.5.0/24")));
+    CHECK(!Banned(table, "10.8.5.1"));
+    CHECK_EQ(table.size(), 0u);
+}
+
+void TestLoadFileRejects() {
+    const char* path = "ban_table_test_list.txt";
+    {
+        std::ofstream out(path);
+        out << "# blocklist\n"
+            << "\n"
+            << "   \t\n"
+            << "192.0.2.1\n"
+            << "198.51.100.0/24   # trailing comment\n"
+            << "  203.0.113.0/25\r\n"
+            << "2001:db8::/48\n"
+            << "192.0.2.1\n"              // Duplicate
+            << "300.1.1.1\n"              // Bad octet
+            << "10.0.0.0/33\n"            // Too long for IPv4
+            << "10.0.0.0/\n"              // No length
+            << "2001:db8::/129\n"
+            << "not-an-address\n"
+            << "10.0.0.0/8x\n";
+    }
+
+    IpBanTable table;
+    size_t rejected = 99;
+    CHECK_EQ(table.LoadFile(path, &rejected), 4);
+    CHECK_EQ(rejected, 6u);
+    CHECK_EQ(table.size(), 4u);
+    CHECK(Banned(table, "192.0.2.1"));
+    CHECK(Banned(table, "198.51.100.77"));
+    CHECK(Banned(table, "203.0.113.127"));
+    CHECK(!Banned(table, "203.0.113.128"));
+    CHECK(Banned(table, "2001:db8:0:ffff::1"));
+    CHECK(!Banned(table, "10.1.1.1"));
+
+    // A second load adds only what is new
+    CHECK_EQ(table.LoadFile(path, &rejected), 0);
+    CHECK_EQ(rejected, 6u);
+    std::remove(path);
+
+    CHECK_EQ(table.LoadFile("ban_table_test_missing.txt", &rejected), -1);
+}
+
+void TestMatchesBruteForce() {
+    // Random blocks in a small corner of both families, so they nest,
+    // overlap and touch often; every probe is checked against the rules
+    std::mt19937 rng(2024);
+    IpBanTable table;
+    std::vector<IpPrefix> rules;
+
+    auto random_address = [&](bool v4) {
+        uint32_t low = rng() & 0x0003FFFF;  // Spans four /16 buckets
+        if (v4) {
+            return IpAddress::FromV4(0x0A000000u | low);
+        }
+        return IpAddress{0x20010DB800000000ull, low};
+    };
+
+    for (int round = 0; round < 400; ++round) {
+        bool v4 = rng() % 4 != 0;
+        // Up to 19 host bits, cleared as Parse would
+        int host_bits = (int)(rng() % 20);
+        IpPrefix prefix;
+        prefix.length = 128 - host_bits;
+        prefix.address = random_address(v4);
+        prefix.address.lo &= ~((1ull << host_bits) - 1);
+
+        if (rng() % 3 == 0 && !rules.empty()) {
+            size_t victim = rng() % rules.size();
+            CHECK(table.Unban(rules[victim]));
+            rules.erase(rules.begin() + (long)victim);
+        } else if (table.Ban(prefix)) {
+            rules.push_back(prefix);
+        }
+
+        for (int probe = 0; probe < 50; ++probe) {
+            IpAddress target = random_address(rng() % 4 != 0);
+            bool expected = false;
+            for (const IpPrefix& rule : rules) {
+                if (!(target < rule.First()) && !(rule.Last() < target)) {
+                    expected = true;
+                    break;
+                }
+            }
+            CHECK_EQ(table.IsBanned(target), expected);
+        }
+    }
+    CHECK_EQ(table.size(), rules.size());
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(TestAdjacentAndOverlapping);
+    RUN_TEST(TestRangeCrossingSixteenBoundary);
+    RUN_TEST(TestMappedBlockVersusNativeV6);
+    RUN_TEST(TestUnbanNested);
+    RUN_TEST(TestLoadFileRejects);
+    RUN_TEST(TestMatchesBruteForce);
+    return TEST_EXIT();
+}
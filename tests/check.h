@@ -0,0 +1,49 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+
+/**
+ * @brief Minimal assertions for the unit tests
+ *
+ * A failed CHECK reports and the test carries on, so one run shows every
+ * broken expectation; TEST_EXIT() turns the count into the exit status
+ * CTest looks at.
+ */
+inline int& CheckFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                         #condition);                                           \
+            ++CheckFailures();                                                  \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                              \
+    do {                                                                        \
+        auto actual_value = (actual);                                           \
+        auto expected_value = (expected);                                       \
+        if (!(actual_value == expected_value)) {                                \
+            std::fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld vs %lld\n", \
+                         __FILE__, __LINE__, #actual, #expected,                \
+                         (long long)actual_value, (long long)expected_value);   \
+            ++CheckFailures();                                                  \
+        }                                                                       \
+    } while (0)
+
+#define RUN_TEST(test)                                                          \
+    do {                                                                        \
+        int failures_before = CheckFailures();                                  \
+        test();                                                                 \
+        std::printf("%s %s\n", CheckFailures() == failures_before ? "PASS" : "FAIL", \
+                    #test);                                                     \
+    } while (0)
+
+#define TEST_EXIT() (CheckFailures() == 0 ? 0 : 1)
+
+#endif // CHECK_H
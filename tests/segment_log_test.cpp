@@ -0,0 +1,359 @@
+#include "check.h"
+#include "message_store.h"
+#include "room_id.h"
+#include "segment_log.h"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+using std::chrono::seconds;
+using std::chrono::system_clock;
+
+constexpr size_t RECORD_HEADER_BYTES = 48;
+constexpr size_t SEGMENT_HEADER_BYTES = 32;
+constexpr size_t LARGE_SEGMENT = 64 * 1024 * 1024;
+
+const system_clock::time_point BASE_TIME = system_clock::time_point(seconds(1700000000));
+
+// A fresh, empty directory per test
+std::string TestDirectory(const char* name) {
+    fs::path path = fs::path("segment_log_test_data") / name;
+    fs::remove_all(path);
+    fs::create_directories(path);
+    return path.string();
+}
+
+std::string SegmentFile(const std::string& directory, uint64_t base_sequence) {
+    char name[40];
+    std::snprintf(name, sizeof(name), "chat_%020llu.seg", (unsigned long long)base_sequence);
+    return (fs::path(directory) / name).string();
+}
+
+// Message i is sent at BASE_TIME + i seconds
+bool AppendMessage(SegmentLog& log, int i, const std::string& room) {
+    ChatMessage message(i, "user", RoomInterner::Intern(room), "message " + std::to_string(i));
+    message.timestamp = BASE_TIME + seconds(i);
+    return log.Append(message);
+}
+
+// Record size on disk for AppendMessage(log, i, room)
+size_t RecordBytes(int i, const std::string& room) {
+    return RECORD_HEADER_BYTES + 4 + room.size() + ("message " + std::to_string(i)).size();
+}
+
+std::vector<LogRecord> ReplayAll(SegmentLog& log, const std::string& room = "",
+                                 system_clock::time_point since = system_clock::time_point()) {
+    std::vector<LogRecord> records;
+    log.Replay(since, room, [&](const LogRecord& record) {
+        records.push_back(record);
+        return true;
+    });
+    return records;
+}
+
+// Records 1..count of message i, in order, with nothing else
+bool HoldsMessages(const std::vector<LogRecord>& records, int count) {
+    if ((int)records.size() != count) {
+        return false;
+    }
+    for (int i = 1; i <= count; ++i) {
+        const LogRecord& record = records[i - 1];
+        if (record.sequence != (uint64_t)i || record.sender_id != i ||
+            record.content != "message " + std::to_string(i) ||
+            record.timestamp != BASE_TIME + seconds(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Message numbers from here on keep every record the same size, so a
+// segment holds an exact number of them
+constexpr int FIRST_MESSAGE = 10000;
+
+size_t SegmentOf(size_t records, const std::string& room) {
+    return SEGMENT_HEADER_BYTES + records * RecordBytes(FIRST_MESSAGE, room);
+}
+
+// LoadRecent must agree with the last per_room records Replay finds
+size_t CheckRecentMatchesReplay(SegmentLog& log, size_t per_room, size_t threads) {
+    std::map<std::string, std::vector<uint64_t>> expected;
+    for (const LogRecord& record : ReplayAll(log)) {
+        expected[record.room].push_back(record.sequence);
+    }
+    for (auto& entry : expected) {
+        std::vector<uint64_t>& sequences = entry.second;
+        if (sequences.size() > per_room) {
+            sequences.erase(sequences.begin(), sequences.end() - (long)per_room);
+        }
+    }
+
+    size_t scanned = 0;
+    SegmentLog::RecentRecords recent = log.LoadRecent(per_room, threads, &scanned);
+    CHECK_EQ(recent.size(), expected.size());
+    for (const auto& entry : expected) {
+        auto found = recent.find(entry.first);
+        CHECK(found != recent.end());
+        if (found == recent.end()) {
+            continue;
+        }
+        const std::vector<LogRecord>& records = found->second;
+        CHECK_EQ(records.size(), entry.second.size());
+        for (size_t i = 0; i < records.size() && i < entry.second.size(); ++i) {
+            CHECK_EQ(records[i].sequence, entry.second[i]);
+            CHECK(records[i].content == "message " + std::to_string(records[i].sender_id));
+        }
+    }
+    return scanned;
+}
+
+void FlipByte(const std::string& path, uintmax_t offset) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg((std::streamoff)offset);
+    char byte = 0;
+    file.read(&byte, 1);
+    byte ^= 0x5A;
+    file.seekp((std::streamoff)offset);
+    file.write(&byte, 1);
+}
+
+void TestReopenKeepsSequence() {
+    std::string directory = TestDirectory("reopen");
+    {
+        SegmentLog log(directory, LARGE_SEGMENT);
+        CHECK(log.Open());
+        CHECK_EQ(log.next_sequence(), 1u);
+        for (int i = 1; i <= 10; ++i) {
+            CHECK(AppendMessage(log, i, "lobby"));
+        }
+        CHECK_EQ(log.next_sequence(), 11u);
+    }
+
+    SegmentLog log(directory, LARGE_SEGMENT);
+    CHECK(log.Open());
+    CHECK_EQ(log.next_sequence(), 11u);
+    CHECK(HoldsMessages(ReplayAll(log), 10));
+    CHECK(AppendMessage(log, 11, "lobby"));
+    CHECK(HoldsMessages(ReplayAll(log), 11));
+}
+
+void TestTornTailIsCut() {
+    // The last record cut short inside its body, then inside its header
+    for (size_t keep : {RECORD_HEADER_BYTES + 3, (size_t)7}) {
+        std::string directory = TestDirectory("torn");
+        std::string path = SegmentFile(directory, 1);
+        uintmax_t good_size = SEGMENT_HEADER_BYTES;
+        {
+            SegmentLog log(directory, LARGE_SEGMENT);
+            CHECK(log.Open());
+            for (int i = 1; i <= 20; ++i) {
+                CHECK(AppendMessage(log, i, i % 2 ? "odd" : "even"));
+                if (i < 20) {
+                    good_size += RecordBytes(i, i % 2 ? "odd" : "even");
+                }
+            }
+        }
+        CHECK_EQ(fs::file_size(path), good_size + RecordBytes(20, "even"));
+        fs::resize_file(path, good_size + keep);
+
+        {
+            SegmentLog log(directory, LARGE_SEGMENT);
+            CHECK(log.Open());
+            CHECK_EQ(fs::file_size(path), good_size);
+            CHECK_EQ(log.next_sequence(), 20u);
+            CHECK(HoldsMessages(ReplayAll(log), 19));
+            CHECK_EQ(ReplayAll(log, "even").size(), 9u);
+
+            // The lost sequence number is reused by the next record
+            CHECK(AppendMessage(log, 20, "even"));
+            CHECK(AppendMessage(log, 21, "odd"));
+            CHECK_EQ(log.next_sequence(), 22u);
+            CHECK(HoldsMessages(ReplayAll(log), 21));
+        }
+
+        // Nothing left to repair on the next open
+        SegmentLog log(directory, LARGE_SEGMENT);
+        CHECK(log.Open());
+        CHECK_EQ(log.next_sequence(), 22u);
+        CHECK(HoldsMessages(ReplayAll(log), 21));
+        CHECK_EQ(ReplayAll(log, "odd").size(), 11u);
+        CHECK_EQ(ReplayAll(log, "", BASE_TIME + seconds(15)).size(), 7u);
+    }
+}
+
+void TestCorruptLastRecordIsCut() {
+    std::string directory = TestDirectory("corrupt");
+    std::string path = SegmentFile(directory, 1);
+    {
+        SegmentLog log(directory, LARGE_SEGMENT);
+        CHECK(log.Open());
+        for (int i = 1; i <= 30; ++i) {
+            CHECK(AppendMessage(log, i, "lobby"));
+        }
+    }
+
+    // One byte of the last record's content: the length still fits, only
+    // the CRC gives it away
+    uintmax_t size = fs::file_size(path);
+    FlipByte(path, size - 2);
+
+    {
+        SegmentLog log(directory, LARGE_SEGMENT);
+        CHECK(log.Open());
+        CHECK_EQ(fs::file_size(path), size - RecordBytes(30, "lobby"));
+        CHECK_EQ(log.next_sequence(), 30u);
+        CHECK(HoldsMessages(ReplayAll(log), 29));
+        CHECK(AppendMessage(log, 30, "lobby"));
+    }
+
+    SegmentLog log(directory, LARGE_SEGMENT);
+    CHECK(log.Open());
+    CHECK_EQ(fs::file_size(path), size);
+    CHECK_EQ(log.next_sequence(), 31u);
+    CHECK(HoldsMessages(ReplayAll(log), 30));
+}
+
+void TestTornTailAfterRotation() {
+    // Three records per segment: 1-3, 4-6, 7-9, 10-12 (active)
+    std::string directory = TestDirectory("rotated");
+    size_t max_segment = SEGMENT_HEADER_BYTES + 3 * RecordBytes(10, "lobby");
+    {
+        SegmentLog log(directory, max_segment);
+        CHECK(log.Open());
+        for (int i = 1; i <= 12; ++i) {
+            CHECK(AppendMessage(log, i, "lobby"));
+        }
+    }
+    for (uint64_t base : {1u, 4u, 7u, 10u}) {
+        CHECK(fs::exists(SegmentFile(directory, base)));
+    }
+
+    std::string active = SegmentFile(directory, 10);
+    fs::resize_file(active, fs::file_size(active) - 1);
+
+    SegmentLog log(directory, max_segment);
+    CHECK(log.Open());
+    CHECK_EQ(log.next_sequence(), 12u);
+    CHECK(HoldsMessages(ReplayAll(log), 11));
+    CHECK_EQ(ReplayAll(log, "", BASE_TIME + seconds(5)).size(), 7u);
+
+    // Sealed segments are left alone; the active one fills up and rotates
+    CHECK(AppendMessage(log, 12, "lobby"));
+    CHECK(AppendMessage(log, 13, "lobby"));
+    CHECK(fs::exists(SegmentFile(directory, 13)));
+    CHECK(HoldsMessages(ReplayAll(log), 13));
+}
+
+void TestBadSegmentHeaderStartsAfresh() {
+    std::string directory = TestDirectory("bad_header");
+    size_t max_segment = SEGMENT_HEADER_BYTES + 3 * RecordBytes(1, "lobby");
+    {
+        SegmentLog log(directory, max_segment);
+        CHECK(log.Open());
+        for (int i = 1; i <= 5; ++i) {
+            CHECK(AppendMessage(log, i, "lobby"));
+        }
+    }
+    FlipByte(SegmentFile(directory, 4), 0);  // Segment magic
+
+    {
+        // The sealed segment still replays; the broken one is set aside
+        SegmentLog log(directory, max_segment);
+        CHECK(log.Open());
+        CHECK_EQ(log.next_sequence(), 5u);
+        CHECK(HoldsMessages(ReplayAll(log), 3));
+        CHECK(AppendMessage(log, 5, "lobby"));
+        CHECK_EQ(ReplayAll(log).size(), 4u);
+        CHECK(fs::exists(SegmentFile(directory, 4)));
+        CHECK(fs::exists(SegmentFile(directory, 5)));
+    }
+
+    SegmentLog log(directory, max_segment);
+    CHECK(log.Open());
+    CHECK_EQ(log.next_sequence(), 6u);
+}
+
+void TestLoadRecentSkipsCoveredSegments() {
+    // Segment 1 holds the only "old" records; 2-6 are all "new"
+    std::string directory = TestDirectory("recent_small");
+    SegmentLog log(directory, SegmentOf(10, "new"));
+    CHECK(log.Open());
+    int next = FIRST_MESSAGE;
+    for (int i = 0; i < 5; ++i) {
+        CHECK(AppendMessage(log, next++, "old"));
+    }
+    for (int i = 0; i < 55; ++i) {
+        CHECK(AppendMessage(log, next++, "new"));
+    }
+    CHECK(fs::exists(SegmentFile(directory, 51)));
+
+    // Each segment's single "new" entry vouches for one record, so
+    // per_room 2 takes the two newest segments, then the oldest for "old"
+    for (size_t threads : {(size_t)1, (size_t)4}) {
+        CHECK_EQ(CheckRecentMatchesReplay(log, 1, threads), 2u);
+        CHECK_EQ(CheckRecentMatchesReplay(log, 2, threads), 3u);
+        CHECK_EQ(CheckRecentMatchesReplay(log, 3, threads), 4u);
+        CHECK_EQ(CheckRecentMatchesReplay(log, 5, threads), 6u);
+        CHECK_EQ(CheckRecentMatchesReplay(log, 100, threads), 6u);
+    }
+
+    SegmentLog::RecentRecords recent = log.LoadRecent(2, 2);
+    CHECK_EQ(recent["new"].size(), 2u);
+    CHECK_EQ(recent["new"][0].sequence, 59u);
+    CHECK_EQ(recent["new"][1].sequence, 60u);
+    CHECK_EQ(recent["old"].size(), 2u);
+    CHECK_EQ(recent["old"][0].sequence, 4u);
+    CHECK_EQ(recent["old"][1].sequence, 5u);
+
+    size_t scanned = 99;
+    CHECK(log.LoadRecent(0, 1, &scanned).empty());
+    CHECK_EQ(scanned, 0u);
+}
+
+void TestLoadRecentCountsWholeIntervals() {
+    // 200 records per segment: four entries per room, worth 3 * 64 + 1
+    std::string directory = TestDirectory("recent_intervals");
+    SegmentLog log(directory, SegmentOf(200, "new"));
+    CHECK(log.Open());
+    int next = FIRST_MESSAGE;
+    for (int i = 0; i < 100; ++i) {
+        CHECK(AppendMessage(log, next++, "old"));
+    }
+    for (int i = 0; i < 500; ++i) {
+        CHECK(AppendMessage(log, next++, "new"));
+    }
+    CHECK(fs::exists(SegmentFile(directory, 201)));
+    CHECK(fs::exists(SegmentFile(directory, 401)));
+
+    // The newest segment alone is enough for "new" up to 193 records
+    CHECK_EQ(CheckRecentMatchesReplay(log, 100, 2), 2u);
+    CHECK_EQ(CheckRecentMatchesReplay(log, 193, 2), 2u);
+    CHECK_EQ(CheckRecentMatchesReplay(log, 194, 2), 3u);
+    CHECK_EQ(CheckRecentMatchesReplay(log, 400, 2), 3u);
+
+    // A sealed segment without its index cannot be judged, so it is read
+    fs::remove(fs::path(directory) / "chat_00000000000000000201.idx");
+    CHECK_EQ(CheckRecentMatchesReplay(log, 100, 2), 3u);
+    CHECK_EQ(CheckRecentMatchesReplay(log, 400, 2), 3u);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(TestReopenKeepsSequence);
+    RUN_TEST(TestTornTailIsCut);
+    RUN_TEST(TestCorruptLastRecordIsCut);
+    RUN_TEST(TestTornTailAfterRotation);
+    RUN_TEST(TestBadSegmentHeaderStartsAfresh);
+    RUN_TEST(TestLoadRecentSkipsCoveredSegments);
+    RUN_TEST(TestLoadRecentCountsWholeIntervals);
+    std::filesystem::remove_all("segment_log_test_data");
+    return TEST_EXIT();
+}
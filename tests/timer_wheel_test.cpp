@@ -0,0 +1,206 @@
+#include "check.h"
+#include "timer_wheel.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+// With 1 us ticks level 1 starts at 256 us and level 2 at 65.5 ms, so
+// delays of a few hundred milliseconds cross both cascades
+constexpr std::chrono::microseconds FINE_TICK(1);
+
+template <typename Predicate>
+bool WaitFor(Predicate done, milliseconds limit = milliseconds(5000)) {
+    auto deadline = Clock::now() + limit;
+    while (!done()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+}
+
+void SpinFor(std::chrono::nanoseconds duration) {
+    auto until = Clock::now() + duration;
+    while (Clock::now() < until) {
+    }
+}
+
+void TestOrderAndNeverEarlyAcrossCascades() {
+    constexpr int COUNT = 3000;
+    TimerWheel wheel(FINE_TICK);
+
+    std::vector<Clock::time_point> due_low(COUNT), due_high(COUNT), fired_at(COUNT);
+    std::vector<int> order;
+    order.reserve(COUNT);
+    std::atomic<int> fired{0};
+
+    // Up to 300 ms: level 0, level 1 and level 2 timers, interleaved
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> delay_ms(0, 300);
+    for (int i = 0; i < COUNT; ++i) {
+        milliseconds delay(delay_ms(rng));
+        due_low[i] = Clock::now() + delay;
+        wheel.Schedule(delay, [&, i] {
+            fired_at[i] = Clock::now();
+            order.push_back(i);  // Callbacks all run on the wheel's thread
+            fired.fetch_add(1, std::memory_order_release);
+        });
+        due_high[i] = Clock::now() + delay;
+    }
+
+    CHECK(WaitFor([&] { return fired.load(std::memory_order_acquire) == COUNT; }));
+    CHECK_EQ(wheel.size(), 0u);
+    if (fired.load(std::memory_order_acquire) != COUNT) {
+        return;
+    }
+
+    std::vector<int> seen(COUNT, 0);
+    for (int i : order) {
+        seen[i]++;
+    }
+    for (int i = 0; i < COUNT; ++i) {
+        CHECK_EQ(seen[i], 1);
+        CHECK(fired_at[i] >= due_low[i]);
+    }
+
+    // The deadline tick is taken somewhere between due_low and due_high;
+    // a timer may only fire after another whose deadline is a tick later
+    // if both rounded to the same tick
+    for (int k = 0; k + 1 < COUNT; ++k) {
+        int a = order[k];
+        int b = order[k + 1];
+        CHECK(due_low[a] <= due_high[b] + FINE_TICK);
+    }
+}
+
+void TestCancelRacingFire() {
+    constexpr int ROUNDS = 2000;
+    TimerWheel wheel(FINE_TICK);
+
+    std::unique_ptr<std::atomic<int>[]> runs(new std::atomic<int>[ROUNDS]);
+    std::vector<bool> cancelled(ROUNDS);
+    std::atomic<int> total{0};
+    std::mt19937 rng(777);
+    std::uniform_int_distribution<int> spin_us(0, 40);
+
+    for (int r = 0; r < ROUNDS; ++r) {
+        runs[r].store(0);
+        TimerId id = wheel.Schedule(milliseconds(0), [&, r] {
+            runs[r].fetch_add(1);
+            total.fetch_add(1);
+        });
+        SpinFor(std::chrono::microseconds(spin_us(rng)));
+        cancelled[r] = wheel.Cancel(id);
+        CHECK(!wheel.Cancel(id));  // Stale either way now
+    }
+
+    int expected = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        expected += cancelled[r] ? 0 : 1;
+    }
+    CHECK(WaitFor([&] { return total.load() >= expected; }));
+    std::this_thread::sleep_for(milliseconds(20));  // Nothing further may run
+    CHECK_EQ(total.load(), expected);
+    CHECK_EQ(wheel.size(), 0u);
+
+    // A successful Cancel means the callback never runs; a failed one
+    // means it ran exactly once
+    for (int r = 0; r < ROUNDS; ++r) {
+        CHECK_EQ(runs[r].load(), cancelled[r] ? 0 : 1);
+    }
+    std::printf("  %d of %d cancels beat the fire\n", ROUNDS - expected, ROUNDS);
+}
+
+void TestRearmRacingFire() {
+    constexpr int ROUNDS = 2000;
+    TimerWheel wheel(FINE_TICK);
+
+    std::unique_ptr<std::atomic<int>[]> runs(new std::atomic<int>[ROUNDS]);
+    std::vector<Clock::time_point> fired_at(ROUNDS), rearm_started(ROUNDS);
+    std::vector<bool> rearmed(ROUNDS);
+    std::atomic<int> total{0};
+    std::mt19937 rng(4242);
+    std::uniform_int_distribution<int> spin_us(0, 40);
+
+    for (int r = 0; r < ROUNDS; ++r) {
+        runs[r].store(0);
+        TimerId id = wheel.Schedule(milliseconds(0), [&, r] {
+            fired_at[r] = Clock::now();
+            runs[r].fetch_add(1);
+            total.fetch_add(1, std::memory_order_release);
+        });
+        SpinFor(std::chrono::microseconds(spin_us(rng)));
+        rearm_started[r] = Clock::now();
+        rearmed[r] = wheel.Rearm(id, milliseconds(2));
+    }
+
+    // Rearm never loses or duplicates a timer: each fires exactly once
+    CHECK(WaitFor([&] { return total.load(std::memory_order_acquire) >= ROUNDS; }));
+    std::this_thread::sleep_for(milliseconds(20));
+    CHECK_EQ(total.load(std::memory_order_acquire), ROUNDS);
+    CHECK_EQ(wheel.size(), 0u);
+
+    int moved = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        CHECK_EQ(runs[r].load(), 1);
+        if (rearmed[r]) {
+            // Moved before it fired: the new deadline holds
+            CHECK(fired_at[r] >= rearm_started[r] + milliseconds(2));
+            ++moved;
+        }
+    }
+    std::printf("  %d of %d rearms beat the fire\n", moved, ROUNDS);
+}
+
+void TestStaleIdAfterGenerationReuse() {
+    TimerWheel wheel(milliseconds(1));
+    std::atomic<int> first_runs{0};
+    std::atomic<int> second_runs{0};
+    std::atomic<int> third_runs{0};
+
+    // A cancelled ID must not reach the timer that reuses its node
+    TimerId first = wheel.Schedule(milliseconds(60000), [&] { first_runs++; });
+    CHECK(wheel.Cancel(first));
+    TimerId second = wheel.Schedule(milliseconds(20), [&] { second_runs++; });
+    CHECK_EQ((uint32_t)second, (uint32_t)first);  // Same node, next generation
+    CHECK(second != first);
+    CHECK(!wheel.Cancel(first));
+    CHECK(!wheel.Rearm(first, milliseconds(0)));
+    CHECK_EQ(wheel.size(), 1u);
+
+    CHECK(WaitFor([&] { return second_runs.load() == 1; }));
+    CHECK_EQ(first_runs.load(), 0);
+
+    // Likewise an ID that already fired
+    TimerId third = wheel.Schedule(milliseconds(60000), [&] { third_runs++; });
+    CHECK_EQ((uint32_t)third, (uint32_t)second);
+    CHECK(!wheel.Rearm(second, milliseconds(0)));
+    CHECK(!wheel.Cancel(second));
+    CHECK_EQ(wheel.size(), 1u);
+    CHECK(wheel.Cancel(third));
+    CHECK_EQ(wheel.size(), 0u);
+
+    CHECK(!wheel.Cancel(INVALID_TIMER));
+    CHECK(!wheel.Rearm(INVALID_TIMER, milliseconds(0)));
+    CHECK_EQ(third_runs.load(), 0);
+    CHECK_EQ(second_runs.load(), 1);
+}
+
+} // namespace
+
+int main() {
+    RUN_TEST(TestOrderAndNeverEarlyAcrossCascades);
+    RUN_TEST(TestCancelRacingFire);
+    RUN_TEST(TestRearmRacingFire);
+    RUN_TEST(TestStaleIdAfterGenerationReuse);
+    return TEST_EXIT();
+}
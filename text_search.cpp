@@ -0,0 +1,208 @@
+#include "text_search.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHAT_SEARCH_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CHAT_TARGET_AVX2
+#else
+#define CHAT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+inline unsigned char FoldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// One needle byte as a masked compare: for a lowercase letter, setting
+// bit 0x20 folds both cases of it (and nothing else) onto the letter, so
+// (byte | fold) == value matches exactly the bytes FoldCase maps to it
+struct ByteMatch {
+    uint8_t value;
+    uint8_t fold;
+
+    explicit ByteMatch(unsigned char c) : value(c), fold(c >= 'a' && c <= 'z' ? 0x20 : 0) {}
+    bool operator()(unsigned char c) const { return (uint8_t)(c | fold) == value; }
+};
+
+// Bytes 1..n-2 of a candidate whose first and last bytes already match
+inline bool MiddleMatches(const char* p, std::string_view needle) {
+    for (size_t j = 1; j + 1 < needle.size(); ++j) {
+        if (FoldCase(p[j]) != (unsigned char)needle[j]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ContainsScalar(const char* h, size_t size, std::string_view needle) {
+    size_t last = needle.size() - 1;
+    ByteMatch first_byte((unsigned char)needle[0]);
+    ByteMatch last_byte((unsigned char)needle[last]);
+    for (size_t i = 0; i + last < size; ++i) {
+        if (first_byte(h[i]) && last_byte(h[i + last]) && MiddleMatches(h + i, needle)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef CHAT_SEARCH_X86
+
+inline int LowestBit(uint32_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctz(bits);
+#endif
+}
+
+bool ContainsSse2(const char* h, size_t size, std::string_view needle) {
+    size_t last = needle.size() - 1;
+    ByteMatch first_byte((unsigned char)needle[0]);
+    ByteMatch last_byte((unsigned char)needle[last]);
+    const __m128i first_value = _mm_set1_epi8((char)first_byte.value);
+    const __m128i first_fold = _mm_set1_epi8((char)first_byte.fold);
+    const __m128i last_value = _mm_set1_epi8((char)last_byte.value);
+    const __m128i last_fold = _mm_set1_epi8((char)last_byte.fold);
+
+    size_t i = 0;
+    for (; i + last + 16 <= size; i += 16) {
+        __m128i front = _mm_loadu_si128((const __m128i*)(h + i));
+        __m128i back = _mm_loadu_si128((const __m128i*)(h + i + last));
+        __m128i hits = _mm_and_si128(
+            _mm_cmpeq_epi8(_mm_or_si128(front, first_fold), first_value),
+            _mm_cmpeq_epi8(_mm_or_si128(back, last_fold), last_value));
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(hits);
+        while (bits) {
+            if (MiddleMatches(h + i + LowestBit(bits), needle)) {
+                return true;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return ContainsScalar(h + i, size - i, needle);
+}
+
+CHAT_TARGET_AVX2
+bool ContainsAvx2(const char* h, size_t size, std::string_view needle) {
+    size_t last = needle.size() - 1;
+    if (last + 32 > size) {
+        return ContainsSse2(h, size, needle);  // Most chat lines are shorter than one block
+    }
+    ByteMatch first_byte((unsigned char)needle[0]);
+    ByteMatch last_byte((unsigned char)needle[last]);
+    const __m256i first_value = _mm256_set1_epi8((char)first_byte.value);
+    const __m256i first_fold = _mm256_set1_epi8((char)first_byte.fold);
+    const __m256i last_value = _mm256_set1_epi8((char)last_byte.value);
+    const __m256i last_fold = _mm256_set1_epi8((char)last_byte.fold);
+
+    size_t i = 0;
+    for (; i + last + 32 <= size; i += 32) {
+        __m256i front = _mm256_loadu_si256((const __m256i*)(h + i));
+        __m256i back = _mm256_loadu_si256((const __m256i*)(h + i + last));
+        __m256i hits = _mm256_and_si256(
+            _mm256_cmpeq_epi8(_mm256_or_si256(front, first_fold), first_value),
+            _mm256_cmpeq_epi8(_mm256_or_si256(back, last_fold), last_value));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(hits);
+        while (bits) {
+            if (MiddleMatches(h + i + LowestBit(bits), needle)) {
+                return true;
+            }
+            bits &= bits - 1;
+        }
+    }
+    // Clear the upper halves before running SSE code; compilers do not
+    // reliably do so ahead of a tail call
+    _mm256_zeroupper();
+    return ContainsSse2(h + i, size - i, needle);
+}
+
+bool CpuHasAvx2() {
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) {
+        return false;
+    }
+    __cpuid(regs, 1);
+    bool os_saves_ymm = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) &&
+                        (_xgetbv(0) & 6) == 6;
+    __cpuidex(regs, 7, 0);
+    return os_saves_ymm && (regs[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // CHAT_SEARCH_X86
+
+} // namespace
+
+bool SearchKernelSupported(SearchKernel kernel) {
+    switch (kernel) {
+    case SearchKernel::SCALAR:
+        return true;
+#ifdef CHAT_SEARCH_X86
+    case SearchKernel::SSE2:
+        return true;  // Baseline on x86-64
+    case SearchKernel::AVX2: {
+        static const bool has_avx2 = CpuHasAvx2();
+        return has_avx2;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+SearchKernel BestSearchKernel() {
+    static const SearchKernel best =
+        SearchKernelSupported(SearchKernel::SSE2) ? SearchKernel::SSE2 : SearchKernel::SCALAR;
+    return best;
+}
+
+SearchKernel BestSearchKernel(size_t haystack_size) {
+    if (haystack_size >= AVX2_MIN_HAYSTACK && SearchKernelSupported(SearchKernel::AVX2)) {
+        return SearchKernel::AVX2;
+    }
+    return BestSearchKernel();
+}
+
+const char* SearchKernelName(SearchKernel kernel) {
+    switch (kernel) {
+    case SearchKernel::SSE2: return "sse2";
+    case SearchKernel::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+bool ContainsIgnoreCase(std::string_view haystack, std::string_view lower_needle) {
+    return ContainsIgnoreCase(haystack, lower_needle, BestSearchKernel(haystack.size()));
+}
+
+bool ContainsIgnoreCase(std::string_view haystack, std::string_view lower_needle,
+                        SearchKernel kernel) {
+    if (lower_needle.empty()) {
+        return true;
+    }
+    if (haystack.size() < lower_needle.size()) {
+        return false;
+    }
+    switch (kernel) {
+#ifdef CHAT_SEARCH_X86
+    case SearchKernel::AVX2:
+        return ContainsAvx2(haystack.data(), haystack.size(), lower_needle);
+    case SearchKernel::SSE2:
+        return ContainsSse2(haystack.data(), haystack.size(), lower_needle);
+#endif
+    default:
+        return ContainsScalar(haystack.data(), haystack.size(), lower_needle);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief Implementations of the case-insensitive substring kernel
+ *
+ * All of them give the same answers; SSE2 and AVX2 exist only on x86.
+ */
+enum class SearchKernel {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+/**
+ * @brief Shortest haystack for which AVX2 beats SSE2
+ *
+ * Below this, one or two 32-byte blocks plus the scalar tail and the
+ * vzeroupper cost as much as SSE2's 16-byte blocks or more (up to 13%
+ * slower at 48-64 bytes); AVX2 pulls ahead by 7-12% from a few hundred
+ * bytes. Most chat lines are well under it.
+ */
+constexpr size_t AVX2_MIN_HAYSTACK = 256;
+
+/**
+ * @brief Kernel for a typical (short) chat line: SSE2 on x86, else scalar
+ */
+SearchKernel BestSearchKernel();
+
+/**
+ * @brief Kernel for a haystack of this size: AVX2 where supported and the
+ *        haystack is at least AVX2_MIN_HAYSTACK, else BestSearchKernel()
+ */
+SearchKernel BestSearchKernel(size_t haystack_size);
+
+/**
+ * @brief Whether this build and CPU can run `kernel`
+ */
+bool SearchKernelSupported(SearchKernel kernel);
+
+const char* SearchKernelName(SearchKernel kernel);
+
+/**
+ * @brief Case-insensitive substring test (ASCII folding), on the bytes in place
+ *
+ * Filters positions by the needle's first and last bytes a block at a
+ * time, then checks the bytes in between only where both match.
+ *
+ * Picks the kernel with BestSearchKernel(haystack.size()).
+ *
+ * @param lower_needle Needle already lowercased
+ */
+bool ContainsIgnoreCase(std::string_view haystack, std::string_view lower_needle);
+
+/**
+ * @brief As above, with a specific kernel; it must be supported
+ */
+bool ContainsIgnoreCase(std::string_view haystack, std::string_view lower_needle,
+                        SearchKernel kernel);
+
+#endif // TEXT_SEARCH_H
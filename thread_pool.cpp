@@ -1,5 +1,29 @@
 #include "thread_pool.h"
 #include <iostream>
+#include <string>
+
+namespace {
+
+// Worker identity of the calling thread, so nested enqueues stay local
+thread_local ThreadPool* tls_pool = nullptr;
+thread_local size_t tls_worker = 0;
+
+// Victim/inbox selection for threads outside the pool
+thread_local uint32_t tls_rng = 0;
+
+// Steal attempts before a worker parks
+constexpr int SPIN_ROUNDS = 64;
+
+inline uint32_t NextRandom(uint32_t& state) {
+    // xorshift32; a zero state would stick at zero
+    if (state == 0) state = 0x9E3779B9u ^ static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&state));
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+} // namespace
 
 ThreadPool::ThreadPool(size_t num_threads) {
     // Ensure at least 1 thread
@@ -9,45 +33,19 @@ ThreadPool::ThreadPool(size_t num_threads) {
         num_threads = sysinfo.dwNumberOfProcessors;
         if (num_threads == 0) num_threads = 1;
     }
-    
+
+    // All deques must exist before any worker starts stealing
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers.emplace_back(new Worker());
+        workers.back()->rng = static_cast<uint32_t>(i * 2654435761u + 1);
+    }
+
     // Create worker threads (w32::Thread automatically starts)
     for (size_t i = 0; i < num_threads; ++i) {
-        workers.push_back(w32::Thread([this, i] {
-            while (true) {
-                std::function<void()> task;
-                
-                {
-                    w32::LockGuard lock(queue_mutex);
-                    
-                    // Wait until there's a task or we're stopping
-                    condition.wait(lock, [this] {
-                        return stop.load() || !tasks.empty();
-                    });
-                    
-                    // Exit if stopping and no tasks left
-                    if (stop.load() && tasks.empty()) {
-                        return;
-                    }
-                    
-                    // Get the next task
-                    task = std::move(tasks.front());
-                    tasks.pop();
-                }
-                
-                // Execute the task
-                active_tasks++;
-                try {
-                    task();
-                } catch (const std::exception& e) {
-                    std::cerr << "[ThreadPool] Task exception: " << e.what() << std::endl;
-                } catch (...) {
-                    std::cerr << "[ThreadPool] Unknown task exception" << std::endl;
-                }
-                active_tasks--;
-            }
-        }));
+        workers[i]->thread = w32::Thread([this, i] { WorkerLoop(i); });
+        workers[i]->thread.SetName(("pool-" + std::to_string(i)).c_str());
     }
-    
+
     std::cout << "[ThreadPool] Created with " << num_threads << " worker threads" << std::endl;
 }
 
@@ -55,29 +53,223 @@ ThreadPool::~ThreadPool() {
     shutdown();
 }
 
+void ThreadPool::enqueue(Task task) {
+    if (stop.load()) {
+        return;
+    }
+
+    TaskNode* node = TaskNode::Acquire();
+    node->task = std::move(task);
+
+    if (tls_pool == this) {
+        // Nested submission from a worker: lock-free push to its own deque
+        workers[tls_worker]->deque.push(node);
+    } else {
+        Worker& target = *workers[NextRandom(tls_rng) % workers.size()];
+        w32::LockGuard lock(target.inbox_mutex);
+        if (target.inbox_tail) {
+            target.inbox_tail->next.store(node, std::memory_order_relaxed);
+        } else {
+            target.inbox_head = node;
+        }
+        target.inbox_tail = node;
+        target.inbox_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Pairs with the fence in Park(): either we see the idle worker or it
+    // sees our task on its final re-check
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle_workers.load(std::memory_order_relaxed) > 0) {
+        WakeOne();
+    }
+}
+
 void ThreadPool::shutdown() {
     {
-        w32::LockGuard lock(queue_mutex);
-        if (stop.load()) {
+        w32::LockGuard lock(shutdown_mutex);
+        if (stop.exchange(true)) {
             return; // Already stopped
         }
-        stop.store(true);
     }
-    
-    // Wake up all threads
-    condition.notify_all();
-    
+
+    // Wake up all threads; they exit once every queue is empty
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto& worker : workers) {
+        if (worker->sleeping.exchange(false)) {
+            idle_workers.fetch_sub(1);
+        }
+        {
+            w32::LockGuard lock(worker->park_mutex);
+            worker->wake = true;
+        }
+        worker->park_cv.notify_one();
+    }
+
     // Wait for all threads to finish
     for (auto& worker : workers) {
-        if (worker.joinable()) {
-            worker.join();
+        if (worker->thread.joinable()) {
+            worker->thread.join();
         }
     }
-    
+
     std::cout << "[ThreadPool] Shutdown complete" << std::endl;
 }
 
 size_t ThreadPool::pending_tasks() const {
-    w32::LockGuard lock(queue_mutex);
-    return tasks.size();
+    size_t total = 0;
+    for (const auto& worker : workers) {
+        total += worker->deque.size() + worker->inbox_size.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    tls_pool = this;
+    tls_worker = index;
+    Worker& self = *workers[index];
+
+    while (true) {
+        TaskNode* task = nullptr;
+        for (int spin = 0; spin < SPIN_ROUNDS && task == nullptr; ++spin) {
+            task = FindTask(index);
+        }
+
+        if (task) {
+            RunTask(task);
+            continue;
+        }
+
+        // Exit if stopping and no tasks left
+        if (stop.load() && !HasWork()) {
+            return;
+        }
+
+        Park(self);
+    }
+}
+
+TaskNode* ThreadPool::FindTask(size_t index) {
+    Worker& self = *workers[index];
+
+    if (TaskNode* task = self.deque.take()) {
+        return task;
+    }
+    if (TaskNode* task = PopInbox(self, true)) {
+        return task;
+    }
+
+    // Random victim, then sweep the rest once
+    size_t count = workers.size();
+    size_t start = NextRandom(self.rng) % count;
+    for (size_t n = 0; n < count; ++n) {
+        size_t victim_index = (start + n) % count;
+        if (victim_index == index) continue;
+
+        Worker& victim = *workers[victim_index];
+        if (TaskNode* task = victim.deque.steal()) {
+            return task;
+        }
+        if (TaskNode* task = PopInbox(victim, false)) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+TaskNode* ThreadPool::PopInbox(Worker& worker, bool drain_to_deque) {
+    if (worker.inbox_size.load(std::memory_order_relaxed) == 0) {
+        return nullptr;
+    }
+
+    TaskNode* task;
+    TaskNode* rest = nullptr;
+    {
+        w32::LockGuard lock(worker.inbox_mutex);
+        task = worker.inbox_head;
+        if (!task) {
+            return nullptr;
+        }
+
+        if (drain_to_deque) {
+            // The owner takes the whole list and moves the backlog into its
+            // deque so thieves can take it without the inbox lock
+            rest = task->next.load(std::memory_order_relaxed);
+            worker.inbox_head = nullptr;
+            worker.inbox_tail = nullptr;
+            worker.inbox_size.store(0, std::memory_order_relaxed);
+        } else {
+            worker.inbox_head = task->next.load(std::memory_order_relaxed);
+            if (!worker.inbox_head) {
+                worker.inbox_tail = nullptr;
+            }
+            worker.inbox_size.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    while (rest) {
+        TaskNode* next = rest->next.load(std::memory_order_relaxed);
+        rest->next.store(nullptr, std::memory_order_relaxed);
+        worker.deque.push(rest);
+        rest = next;
+    }
+    task->next.store(nullptr, std::memory_order_relaxed);
+    return task;
+}
+
+bool ThreadPool::HasWork() const {
+    for (const auto& worker : workers) {
+        if (!worker->deque.empty() || worker->inbox_size.load() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Park(Worker& self) {
+    self.sleeping.store(true);
+    idle_workers.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Re-check after advertising: a producer that missed our idle count
+    // must have published its task before we look
+    if (stop.load() || HasWork()) {
+        if (self.sleeping.exchange(false)) {
+            idle_workers.fetch_sub(1);
+            return;
+        }
+        // A waker already claimed us; consume its token below
+    }
+
+    w32::LockGuard lock(self.park_mutex);
+    self.park_cv.wait(lock, [&self] { return self.wake; });
+    self.wake = false;
+}
+
+void ThreadPool::WakeOne() {
+    size_t count = workers.size();
+    size_t start = NextRandom(tls_rng) % count;
+    for (size_t n = 0; n < count; ++n) {
+        Worker& worker = *workers[(start + n) % count];
+        if (!worker.sleeping.load(std::memory_order_relaxed)) continue;
+        if (!worker.sleeping.exchange(false)) continue;
+
+        idle_workers.fetch_sub(1);
+        {
+            w32::LockGuard lock(worker.park_mutex);
+            worker.wake = true;
+        }
+        worker.park_cv.notify_one();
+        return;
+    }
+}
+
+void ThreadPool::RunTask(TaskNode* node) {
+    try {
+        node->task();
+    } catch (const std::exception& e) {
+        std::cerr << "[ThreadPool] Task exception: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "[ThreadPool] Unknown task exception" << std::endl;
+    }
+    TaskNode::Release(node);
 }
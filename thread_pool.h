@@ -2,58 +2,79 @@
 #define THREAD_POOL_H
 
 #include <vector>
-#include <queue>
-#include <functional>
 #include <atomic>
-#include <future>
 #include <memory>
-#include <type_traits>
+#include "task.h"
 #include "win32_compat.h"
+#include "work_stealing_deque.h"
 
 /**
- * @brief High-performance thread pool for Windows
+ * @brief Work-stealing thread pool
+ *
+ * Each worker owns a Chase-Lev deque. Tasks enqueued from a worker go to
+ * its own deque; tasks enqueued from outside (I/O threads) go to a randomly
+ * chosen worker's inbox, so producers spread over N locks instead of one.
+ * Idle workers steal from random victims, then park on a private condition
+ * variable; producers only touch a parked worker when the idle count says
+ * one exists.
+ *
+ * Tasks travel in recycled TaskNodes with inline capture storage, so the
+ * enqueue path does not allocate once the node caches are warm.
  */
 class ThreadPool {
 public:
     explicit ThreadPool(size_t num_threads);
     ~ThreadPool();
-    
+
     ThreadPool(const ThreadPool&) = delete;
     ThreadPool& operator=(const ThreadPool&) = delete;
     ThreadPool(ThreadPool&&) = delete;
     ThreadPool& operator=(ThreadPool&&) = delete;
-    
+
     /**
      * @brief Enqueue a task for execution.
-     * simplified to accept std::function<void()> directly.
-     * Return value removed as it is unused in this server.
+     * Accepts any void() callable; tasks enqueued after shutdown() are dropped.
      */
-    void enqueue(std::function<void()> task) {
-        {
-            w32::LockGuard lock(queue_mutex);
-            if (stop.load()) {
-                // throw std::runtime_error("Cannot enqueue on stopped ThreadPool");
-                return; 
-            }
-            tasks.push(std::move(task));
-        }
-        condition.notify_one();
-    }
-    
+    void enqueue(Task task);
+
     size_t pending_tasks() const;
     size_t thread_count() const { return workers.size(); }
     bool is_running() const { return !stop.load(); }
     void shutdown();
 
 private:
-    std::vector<w32::Thread> workers;
-    std::queue<std::function<void()>> tasks;
-    
-    mutable w32::Mutex queue_mutex;
-    w32::ConditionVariable condition;
+    struct alignas(64) Worker {
+        WorkStealingDeque<TaskNode> deque;
+
+        // External submissions, linked through TaskNode::next; drained into
+        // the deque by the owner
+        w32::Mutex inbox_mutex;
+        TaskNode* inbox_head = nullptr;
+        TaskNode* inbox_tail = nullptr;
+        std::atomic<size_t> inbox_size{0};
+
+        // Parking
+        std::atomic<bool> sleeping{false};
+        w32::Mutex park_mutex;
+        w32::ConditionVariable park_cv;
+        bool wake = false;
+
+        uint32_t rng = 0;
+        w32::Thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
     std::atomic<bool> stop{false};
-    std::atomic<size_t> active_tasks{0};
+    std::atomic<int> idle_workers{0};
+    w32::Mutex shutdown_mutex;
+
+    void WorkerLoop(size_t index);
+    TaskNode* FindTask(size_t index);
+    TaskNode* PopInbox(Worker& worker, bool drain_to_deque);
+    bool HasWork() const;
+    void Park(Worker& self);
+    void WakeOne();
+    void RunTask(TaskNode* node);
 };
 
-// Template implementation removed
 #endif // THREAD_POOL_H
@@ -0,0 +1,287 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Longest sleep with no timers pending; Schedule wakes the thread earlier
+constexpr uint32_t IDLE_WAIT_MS = 1000;
+
+inline uint32_t LowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(bits);
+#endif
+}
+
+} // namespace
+
+TimerWheel::TimerWheel(std::chrono::microseconds t)
+    : tick(std::max<std::chrono::steady_clock::duration>(t, std::chrono::microseconds(1)))
+    , start(std::chrono::steady_clock::now())
+{
+    for (Level& level : levels) {
+        std::fill(std::begin(level.heads), std::end(level.heads), NIL);
+        memset(level.occupied, 0, sizeof(level.occupied));
+    }
+    thread = w32::Thread([this] { Run(); });
+    thread.SetName("timer-wheel");
+}
+
+TimerWheel::~TimerWheel() {
+    Stop();
+}
+
+void TimerWheel::Stop() {
+    {
+        w32::LockGuard lock(mutex);
+        stopping = true;
+        wake_cv.notify_one();
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+uint64_t TimerWheel::Now() const {
+    return (uint64_t)((std::chrono::steady_clock::now() - start) / tick);
+}
+
+uint64_t TimerWheel::DeadlineFor(std::chrono::milliseconds delay) const {
+    // First tick boundary at or after now + delay, and never a tick that
+    // is already processed
+    auto when = std::chrono::steady_clock::now() - start +
+                std::max<std::chrono::steady_clock::duration>(delay, {});
+    uint64_t ticks = (uint64_t)((when + tick - std::chrono::steady_clock::duration(1)) / tick);
+    return std::max(ticks, current + 1);
+}
+
+TimerId TimerWheel::Schedule(std::chrono::milliseconds delay, Task callback) {
+    w32::LockGuard lock(mutex);
+    uint32_t index = free_head;
+    if (index != NIL) {
+        free_head = nodes[index].next;
+    } else {
+        index = (uint32_t)nodes.size();
+        nodes.emplace_back();
+    }
+    Node& node = nodes[index];
+    node.callback = std::move(callback);
+    node.deadline = DeadlineFor(delay);
+    Link(index);
+    ++pending;
+
+    if (node.deadline < wake_tick) {
+        wake_tick = 0;
+        wake_cv.notify_one();
+    }
+    return ((TimerId)node.generation << 32) | index;
+}
+
+TimerWheel::Node* TimerWheel::Lookup(TimerId id) {
+    uint32_t index = (uint32_t)id;
+    if (index >= nodes.size()) {
+        return nullptr;
+    }
+    Node& node = nodes[index];
+    if (node.generation != (uint32_t)(id >> 32) || node.slot == NIL) {
+        return nullptr;
+    }
+    return &node;
+}
+
+bool TimerWheel::Rearm(TimerId id, std::chrono::milliseconds delay) {
+    w32::LockGuard lock(mutex);
+    Node* node = Lookup(id);
+    if (!node) {
+        return false;
+    }
+    uint32_t index = (uint32_t)id;
+    Unlink(index);
+    node->deadline = DeadlineFor(delay);
+    Link(index);
+
+    if (node->deadline < wake_tick) {
+        wake_tick = 0;
+        wake_cv.notify_one();
+    }
+    return true;
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+    Task dropped;  // Destroyed after the lock is released
+    {
+        w32::LockGuard lock(mutex);
+        Node* node = Lookup(id);
+        if (!node) {
+            return false;
+        }
+        dropped = std::move(node->callback);
+        Unlink((uint32_t)id);
+        Free((uint32_t)id);
+        --pending;
+    }
+    return true;
+}
+
+size_t TimerWheel::size() const {
+    w32::LockGuard lock(mutex);
+    return pending;
+}
+
+void TimerWheel::Link(uint32_t index) {
+    Node& node = nodes[index];
+
+    // Finest level whose 256 slots still reach the deadline; past the
+    // coarsest, park in its last slot and re-place on the way down
+    uint32_t level = 0;
+    uint64_t slot_tick = node.deadline;
+    while (level < LEVELS &&
+           (node.deadline >> (level * SLOT_BITS)) - (current >> (level * SLOT_BITS)) >= SLOTS) {
+        ++level;
+    }
+    if (level == LEVELS) {
+        level = LEVELS - 1;
+        slot_tick = ((current >> (level * SLOT_BITS)) + SLOTS - 1) << (level * SLOT_BITS);
+    }
+    uint32_t slot = (uint32_t)(slot_tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+
+    Level& wheel = levels[level];
+    node.slot = level * SLOTS + slot;
+    node.prev = NIL;
+    node.next = wheel.heads[slot];
+    if (node.next != NIL) {
+        nodes[node.next].prev = index;
+    }
+    wheel.heads[slot] = index;
+    wheel.occupied[slot / 64] |= (uint64_t)1 << (slot % 64);
+}
+
+void TimerWheel::Unlink(uint32_t index) {
+    Node& node = nodes[index];
+    Level& wheel = levels[node.slot / SLOTS];
+    uint32_t slot = node.slot % SLOTS;
+
+    if (node.prev != NIL) {
+        nodes[node.prev].next = node.next;
+    } else {
+        wheel.heads[slot] = node.next;
+    }
+    if (node.next != NIL) {
+        nodes[node.next].prev = node.prev;
+    }
+    if (wheel.heads[slot] == NIL) {
+        wheel.occupied[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+    }
+    node.slot = NIL;
+}
+
+void TimerWheel::Free(uint32_t index) {
+    Node& node = nodes[index];
+    node.generation++;
+    node.next = free_head;
+    free_head = index;
+}
+
+void TimerWheel::Advance(uint64_t target, std::vector<Task>& due) {
+    // Visit only ticks where something happens, not every tick up to target
+    for (;;) {
+        uint64_t t = NextEvent();
+        if (t > target) {
+            current = std::max(current, target);
+            return;
+        }
+        current = t;
+
+        // Wraps cascade coarse to fine, so a timer can drop several levels
+        // in one tick
+        for (uint32_t level = LEVELS - 1; level > 0; --level) {
+            if ((t & (((uint64_t)1 << (level * SLOT_BITS)) - 1)) != 0) {
+                continue;
+            }
+            uint32_t slot = (uint32_t)(t >> (level * SLOT_BITS)) & (SLOTS - 1);
+            uint32_t index = levels[level].heads[slot];
+            while (index != NIL) {
+                uint32_t next = nodes[index].next;
+                Unlink(index);
+                Link(index);
+                index = next;
+            }
+        }
+
+        Level& wheel = levels[0];
+        uint32_t slot = (uint32_t)t & (SLOTS - 1);
+        while (wheel.heads[slot] != NIL) {
+            uint32_t index = wheel.heads[slot];
+            due.push_back(std::move(nodes[index].callback));
+            Unlink(index);
+            Free(index);
+            --pending;
+        }
+    }
+}
+
+uint64_t TimerWheel::NextEvent() const {
+    // A level-0 slot holds timers due within the next revolution, so the
+    // first occupied one after `current` is the next deadline there
+    uint64_t next = UINT64_MAX;
+    const Level& wheel = levels[0];
+    for (uint64_t distance = 1; distance <= SLOTS;) {
+        uint32_t slot = (uint32_t)(current + distance) & (SLOTS - 1);
+        uint64_t bits = wheel.occupied[slot / 64] >> (slot % 64);
+        if (bits) {
+            next = current + distance + LowestBit(bits);
+            break;
+        }
+        distance += 64 - slot % 64;
+    }
+
+    // Coarser timers move down when level 0 next wraps
+    for (uint32_t level = 1; level < LEVELS; ++level) {
+        for (uint64_t word : levels[level].occupied) {
+            if (word) {
+                return std::min(next, (current | (SLOTS - 1)) + 1);
+            }
+        }
+    }
+    return next;
+}
+
+void TimerWheel::Run() {
+    std::vector<Task> due;
+    for (;;) {
+        {
+            w32::LockGuard lock(mutex);
+            if (stopping) {
+                break;
+            }
+            Advance(Now(), due);
+            if (due.empty()) {
+                // Sleep until the next event; Schedule and Rearm reset
+                // wake_tick to wake us for anything earlier
+                wake_tick = NextEvent();
+                uint32_t wait_ms = IDLE_WAIT_MS;
+                if (wake_tick != UINT64_MAX) {
+                    auto wait = start + tick * (std::chrono::steady_clock::rep)wake_tick -
+                                std::chrono::steady_clock::now();
+                    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(wait).count();
+                    wait_ms = (uint32_t)std::max<long long>(
+                        0, std::min<long long>(ms + 1, IDLE_WAIT_MS));
+                }
+                if (wait_ms > 0) {
+                    wake_cv.wait_for(lock, wait_ms, [&] { return stopping || wake_tick == 0; });
+                }
+                wake_tick = 0;
+                continue;
+            }
+        }
+
+        for (Task& callback : due) {
+            callback();
+        }
+        due.clear();
+    }
+}
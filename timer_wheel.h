@@ -0,0 +1,126 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "task.h"
+#include "win32_compat.h"
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Handle to a scheduled timer; stale once it fires or is cancelled
+ */
+using TimerId = uint64_t;
+
+constexpr TimerId INVALID_TIMER = 0;
+
+/**
+ * @brief Hierarchical timing wheel running callbacks on its own thread
+ *
+ * Four levels of 256 slots; level N slots are 256^N ticks wide, so 2^32
+ * ticks are covered (about 16 months at 10 ms). A timer sits in the
+ * finest level whose span reaches its deadline and moves down a level
+ * each time the level below wraps, so every timer is touched at most
+ * four times before it fires. Schedule, Rearm and Cancel are O(1)
+ * list operations under one mutex.
+ *
+ * The thread sleeps until the next occupied level-0 slot (or the next
+ * wrap, when only coarser levels hold timers) instead of waking every
+ * tick, and fires only the timers that are due. Timers never fire early;
+ * they may fire up to one tick late (a millisecond for finer ticks, the
+ * resolution of the wait).
+ *
+ * Callbacks run on the wheel's thread without the wheel's lock, so they
+ * may schedule, rearm or cancel timers; they should be short and hand
+ * real work to the thread pool.
+ */
+class TimerWheel {
+public:
+    /**
+     * @brief Start the wheel's thread
+     * @param tick Resolution; finer than a millisecond is allowed, which
+     *        lets tests reach the coarse levels in well under a second
+     */
+    explicit TimerWheel(std::chrono::microseconds tick = std::chrono::milliseconds(10));
+
+    ~TimerWheel();
+
+    /**
+     * @brief Stop firing timers and join the thread
+     *
+     * Timers that have not fired never will; the wheel stays usable, so
+     * owners that still hold timer IDs can cancel them safely.
+     */
+    void Stop();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * @brief Run `callback` once, `delay` from now
+     */
+    TimerId Schedule(std::chrono::milliseconds delay, Task callback);
+
+    /**
+     * @brief Move a pending timer to `delay` from now
+     * @return false if it already fired or was cancelled
+     */
+    bool Rearm(TimerId id, std::chrono::milliseconds delay);
+
+    /**
+     * @brief Drop a pending timer
+     * @return false if it already fired or was cancelled
+     */
+    bool Cancel(TimerId id);
+
+    /**
+     * @brief Timers waiting to fire
+     */
+    size_t size() const;
+
+private:
+    static constexpr uint32_t LEVELS = 4;
+    static constexpr uint32_t SLOT_BITS = 8;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint32_t NIL = 0xFFFFFFFFu;
+
+    struct Node {
+        Task callback;
+        uint64_t deadline = 0;      // Tick it fires at
+        uint32_t prev = NIL;
+        uint32_t next = NIL;        // Also links the free list
+        uint32_t generation = 1;    // Bumped when the node is freed
+        uint32_t slot = NIL;        // level * SLOTS + index while pending
+    };
+
+    struct Level {
+        uint32_t heads[SLOTS];
+        uint64_t occupied[SLOTS / 64];
+    };
+
+    const std::chrono::steady_clock::duration tick;
+    const std::chrono::steady_clock::time_point start;
+
+    mutable w32::Mutex mutex;
+    w32::ConditionVariable wake_cv;
+    std::vector<Node> nodes;
+    uint32_t free_head = NIL;
+    size_t pending = 0;
+    Level levels[LEVELS];
+    uint64_t current = 0;           // Last tick processed
+    uint64_t wake_tick = 0;         // Tick the thread sleeps until; 0 while awake
+    bool stopping = false;
+    w32::Thread thread;
+
+    uint64_t Now() const;
+    uint64_t DeadlineFor(std::chrono::milliseconds delay) const;
+    Node* Lookup(TimerId id);
+    void Link(uint32_t index);
+    void Unlink(uint32_t index);
+    void Free(uint32_t index);
+    void Advance(uint64_t target, std::vector<Task>& due);
+    uint64_t NextEvent() const;
+    void Run();
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,237 @@
+#include "trigram_index.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t MIN_TABLE_SIZE = 16;
+
+inline unsigned char FoldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+inline uint32_t Trigram(const char* p) {
+    return (uint32_t)FoldCase(p[0]) | ((uint32_t)FoldCase(p[1]) << 8) |
+           ((uint32_t)FoldCase(p[2]) << 16);
+}
+
+inline size_t Hash(uint32_t key) {
+    return (size_t)(key * 2654435761u);
+}
+
+} // namespace
+
+void TrigramIndex::Slot::Resize(uint32_t new_shift) {
+    static_assert(sizeof(Slot) == 16, "slot packs key, list header and inline postings");
+    size_t new_capacity = (size_t)1 << new_shift;
+    uint16_t* fresh = new_shift > INLINE_SHIFT ? new uint16_t[new_capacity] : nullptr;
+    uint16_t moved[1u << INLINE_SHIFT];
+    uint16_t* dest = fresh ? fresh : moved;
+    for (uint16_t i = 0; i < size; ++i) {
+        dest[i] = (*this)[i];
+    }
+    Release();
+    shift = new_shift;
+    head = 0;
+    if (fresh) {
+        heap_items = fresh;
+    } else {
+        memcpy(inline_items, moved, sizeof(moved));
+    }
+}
+
+void TrigramIndex::Slot::Release() {
+    if (shift > INLINE_SHIFT) {
+        delete[] heap_items;
+        shift = INLINE_SHIFT;
+    }
+}
+
+void TrigramIndex::Slot::PushBack(uint16_t sequence) {
+    if (size == capacity()) {
+        Resize(shift + 1);
+    }
+    items()[(head + size) & (capacity() - 1)] = sequence;
+    ++size;
+}
+
+void TrigramIndex::Slot::PopFront() {
+    head = (uint16_t)((head + 1) & (capacity() - 1));
+    --size;
+    // Give memory back once a burst has drained
+    if (shift > INLINE_SHIFT && size <= capacity() / 4) {
+        Resize(shift - 1);
+    }
+}
+
+TrigramIndex::~TrigramIndex() {
+    for (size_t i = 0; mask && i <= mask; ++i) {
+        slots[i].Release();
+    }
+}
+
+TrigramIndex::Slot* TrigramIndex::Find(uint32_t trigram) const {
+    if (!mask) {
+        return nullptr;
+    }
+    uint32_t key = trigram + 1;
+    for (size_t i = Hash(key) & mask;; i = (i + 1) & mask) {
+        if (slots[i].key == key) {
+            return &slots[i];
+        }
+        if (slots[i].key == 0) {
+            return nullptr;
+        }
+    }
+}
+
+TrigramIndex::Slot& TrigramIndex::Insert(uint32_t trigram) {
+    // Grow at 7/8 load; probe runs stay short at this table size
+    if (!mask || (used + 1) * 8 > (mask + 1) * 7) {
+        Rehash(mask ? (mask + 1) * 2 : MIN_TABLE_SIZE);
+    }
+    uint32_t key = trigram + 1;
+    size_t i = Hash(key) & mask;
+    while (slots[i].key != 0 && slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    if (slots[i].key == 0) {
+        slots[i].key = key;
+        ++used;
+    }
+    return slots[i];
+}
+
+void TrigramIndex::Erase(Slot* slot) {
+    size_t hole = (size_t)(slot - slots.get());
+    slots[hole].Release();
+    slots[hole] = Slot();
+    --used;
+
+    // Backward-shift: pull later entries of the probe run into the hole
+    for (size_t i = (hole + 1) & mask; slots[i].key != 0; i = (i + 1) & mask) {
+        size_t home = Hash(slots[i].key) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            slots[hole] = slots[i];
+            slots[i] = Slot();
+            hole = i;
+        }
+    }
+
+    if (mask + 1 > MIN_TABLE_SIZE && used * 8 < mask + 1) {
+        Rehash((mask + 1) / 2);
+    }
+}
+
+void TrigramIndex::Rehash(size_t new_size) {
+    std::unique_ptr<Slot[]> old = std::move(slots);
+    size_t old_size = mask ? mask + 1 : 0;
+
+    slots.reset(new Slot[new_size]);
+    mask = new_size - 1;
+    for (size_t i = 0; i < old_size; ++i) {
+        if (old[i].key == 0) {
+            continue;
+        }
+        size_t j = Hash(old[i].key) & mask;
+        while (slots[j].key != 0) {
+            j = (j + 1) & mask;
+        }
+        slots[j] = old[i]; // Posting buffers move bitwise; `old` never frees them
+    }
+}
+
+void TrigramIndex::Extract(std::string_view text) {
+    scratch.clear();
+    for (size_t i = 0; i + 3 <= text.size(); ++i) {
+        scratch.push_back(Trigram(text.data() + i));
+    }
+    std::sort(scratch.begin(), scratch.end());
+    scratch.erase(std::unique(scratch.begin(), scratch.end()), scratch.end());
+}
+
+void TrigramIndex::Add(uint16_t sequence, std::string_view text) {
+    Extract(text);
+    for (uint32_t trigram : scratch) {
+        Insert(trigram).PushBack(sequence);
+    }
+}
+
+void TrigramIndex::Remove(uint16_t sequence, std::string_view text) {
+    Extract(text);
+    for (uint32_t trigram : scratch) {
+        Slot* slot = Find(trigram);
+        if (!slot || slot->size == 0 || (*slot)[0] != sequence) {
+            continue;
+        }
+        slot->PopFront();
+        if (slot->size == 0) {
+            Erase(slot);
+        }
+    }
+}
+
+void TrigramIndex::Candidates(std::string_view lower_query, uint16_t oldest,
+                              std::vector<uint16_t>& out) const {
+    out.clear();
+
+    // Gather the query's posting lists, shortest first
+    std::vector<const Slot*> lists;
+    for (size_t i = 0; i + 3 <= lower_query.size(); ++i) {
+        const Slot* slot = Find(Trigram(lower_query.data() + i));
+        if (!slot) {
+            return; // A trigram no message has
+        }
+        lists.push_back(slot);
+    }
+    if (lists.empty()) {
+        return;
+    }
+    std::sort(lists.begin(), lists.end());
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+    std::sort(lists.begin(), lists.end(),
+              [](const Slot* a, const Slot* b) { return a->size < b->size; });
+
+    const Slot& first = *lists[0];
+    for (uint16_t i = 0; i < first.size; ++i) {
+        out.push_back(first[i]);
+    }
+
+    // Intersect in window order (sequence - oldest), which survives wrap
+    auto rank = [oldest](uint16_t sequence) { return (uint16_t)(sequence - oldest); };
+    for (size_t l = 1; l < lists.size() && !out.empty(); ++l) {
+        const Slot& list = *lists[l];
+        size_t pos = 0;
+        size_t kept = 0;
+        for (uint16_t sequence : out) {
+            // Galloping would help skewed lists; these are short
+            size_t lo = pos, hi = list.size;
+            while (lo < hi) {
+                size_t mid = (lo + hi) / 2;
+                if (rank(list[mid]) < rank(sequence)) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            pos = lo;
+            if (pos == list.size) {
+                break;
+            }
+            if (list[pos] == sequence) {
+                out[kept++] = sequence;
+            }
+        }
+        out.resize(kept);
+    }
+}
+
+size_t TrigramIndex::MemoryUsage() const {
+    size_t bytes = (mask ? mask + 1 : 0) * sizeof(Slot) + scratch.capacity() * sizeof(uint32_t);
+    for (size_t i = 0; mask && i <= mask; ++i) {
+        if (slots[i].shift > INLINE_SHIFT) {
+            bytes += slots[i].capacity() * sizeof(uint16_t);
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,104 @@
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include "text_search.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Shorter queries have no trigram and are answered by scanning
+constexpr size_t MIN_INDEXED_QUERY = 3;
+
+// Postings hold 16-bit sequence numbers in lists of at most 2^15, so the
+// window is at most this
+constexpr size_t MAX_INDEXED_WINDOW = 0x8000;
+
+/**
+ * @brief Inverted index from lowercased byte trigrams to message sequence numbers
+ *
+ * Built for a FIFO window of messages: Add() is called with increasing
+ * sequence numbers and Remove() with the oldest one, so every posting
+ * list only ever grows at the back and shrinks at the front. A query's
+ * candidates are the intersection of its trigrams' posting lists; every
+ * match is a candidate, but candidates still need the substring check.
+ *
+ * Sized for thousands of small indexes: the table is open-addressed
+ * (linear probing, backward-shift deletion) and each slot holds its
+ * trigram's posting list: a circular buffer of 16-bit sequences, inline
+ * up to four entries.
+ * Sequences are compared relative to the oldest one in the window, so
+ * they may wrap; the window must stay within MAX_INDEXED_WINDOW.
+ */
+class TrigramIndex {
+public:
+    TrigramIndex() = default;
+    ~TrigramIndex();
+
+    TrigramIndex(const TrigramIndex&) = delete;
+    TrigramIndex& operator=(const TrigramIndex&) = delete;
+
+    void Add(uint16_t sequence, std::string_view text);
+
+    /**
+     * @brief Drop the oldest message; `text` must be what was added for it
+     */
+    void Remove(uint16_t sequence, std::string_view text);
+
+    /**
+     * @brief Sequences of messages that may contain the query, oldest first
+     * @param lower_query Lowercased, at least MIN_INDEXED_QUERY bytes
+     * @param oldest Oldest sequence still in the window
+     */
+    void Candidates(std::string_view lower_query, uint16_t oldest,
+                    std::vector<uint16_t>& out) const;
+
+    /**
+     * @brief Bytes held by the table and posting lists
+     */
+    size_t MemoryUsage() const;
+
+private:
+    static constexpr uint32_t INLINE_SHIFT = 2;  // Up to 4 postings live in the slot
+
+    // One trigram and its posting list: a FIFO of sequences in a circular
+    // buffer of 1 << shift entries. 16 bytes.
+    struct Slot {
+        uint32_t key : 26;      // Trigram + 1; 0 marks an empty slot
+        uint32_t shift : 5;
+        uint16_t head;
+        uint16_t size;
+        union {
+            uint16_t inline_items[1u << INLINE_SHIFT];
+            uint16_t* heap_items;
+        };
+
+        Slot() : key(0), shift(INLINE_SHIFT), head(0), size(0) {}
+
+        size_t capacity() const { return (size_t)1 << shift; }
+        uint16_t* items() { return shift > INLINE_SHIFT ? heap_items : inline_items; }
+        const uint16_t* items() const {
+            return shift > INLINE_SHIFT ? heap_items : inline_items;
+        }
+        uint16_t operator[](size_t i) const { return items()[(head + i) & (capacity() - 1)]; }
+
+        void PushBack(uint16_t sequence);
+        void PopFront();
+        void Resize(uint32_t new_shift);
+        void Release();
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;        // Table size - 1 (0 while unallocated)
+    size_t used = 0;
+    std::vector<uint32_t> scratch;  // Trigrams of one message
+
+    void Extract(std::string_view text);
+    Slot* Find(uint32_t trigram) const;
+    Slot& Insert(uint32_t trigram);
+    void Erase(Slot* slot);
+    void Rehash(size_t new_size);
+};
+
+#endif // TRIGRAM_INDEX_H
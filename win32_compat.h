@@ -1,18 +1,128 @@
 #ifndef WIN32_COMPAT_H
 #define WIN32_COMPAT_H
 
-#ifndef _WIN32_WINNT
-#define _WIN32_WINNT 0x0601
-#endif
-
 #include <ctime>
 #include <exception>
 #include <functional>
-#include <process.h>
 #include <vector>
-#include <windows.h>
+
+#ifdef _WIN32
+
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#endif
+
+// winsock2.h must precede windows.h, which otherwise pulls in the old
+// winsock.h; lean windows.h leaves it out whatever the include order
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
 #include <winsock2.h>
+#include <windows.h>
+#include <process.h>
+
+#else // POSIX
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// Minimal Win32 surface used by the platform-neutral modules (server.cpp,
+// thread_pool.cpp) so they build unchanged on POSIX hosts.
+typedef int BOOL;
+typedef uint32_t DWORD;
+typedef void *HANDLE;
+
+#define WINAPI
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+#define INFINITE 0xFFFFFFFF
+#define STD_OUTPUT_HANDLE ((DWORD)-11)
+#define CTRL_C_EVENT 0
+#define CTRL_BREAK_EVENT 1
+
+struct SYSTEM_INFO {
+  DWORD dwNumberOfProcessors;
+};
+
+inline void GetSystemInfo(SYSTEM_INFO *info) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  info->dwNumberOfProcessors = n > 0 ? (DWORD)n : 1;
+}
+
+inline void Sleep(DWORD milliseconds) {
+  struct timespec ts;
+  ts.tv_sec = milliseconds / 1000;
+  ts.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+  while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+  }
+}
+
+inline HANDLE GetStdHandle(DWORD) { return NULL; }
+inline BOOL GetConsoleMode(HANDLE, DWORD *mode) {
+  if (mode)
+    *mode = 0;
+  return TRUE;
+}
+inline BOOL SetConsoleMode(HANDLE, DWORD) { return TRUE; } // ANSI is native
+
+typedef BOOL(WINAPI *PHANDLER_ROUTINE)(DWORD);
+
+/**
+ * @brief Console control handler emulation.
+ *
+ * Windows runs console handlers on a separate thread, so we do the same:
+ * SIGINT/SIGTERM are blocked in the calling thread (and inherited by every
+ * thread created afterwards) and a dedicated thread picks them up with
+ * sigwait() and invokes the handler outside of signal context.
+ * Must be called before other threads are started.
+ */
+inline BOOL SetConsoleCtrlHandler(PHANDLER_ROUTINE handler, BOOL add) {
+  if (!add || handler == NULL)
+    return FALSE;
+
+  static sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  if (pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0)
+    return FALSE;
+
+  pthread_t waiter;
+  int rc = pthread_create(
+      &waiter, NULL,
+      [](void *arg) -> void * {
+        auto routine = reinterpret_cast<PHANDLER_ROUTINE>(arg);
+        int sig = 0;
+        while (sigwait(&signals, &sig) == 0) {
+          routine(sig == SIGINT ? CTRL_C_EVENT : CTRL_BREAK_EVENT);
+        }
+        return NULL;
+      },
+      reinterpret_cast<void *>(handler));
+  if (rc != 0)
+    return FALSE;
+  pthread_detach(waiter);
+  return TRUE;
+}
 
+#endif // _WIN32
 
 // Define missing console constant if needed
 #ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
@@ -25,6 +135,8 @@
 
 namespace w32 {
 
+#ifdef _WIN32
+
 class Mutex {
 public:
   Mutex() { InitializeCriticalSection(&cs); }
@@ -41,6 +153,94 @@ private:
   CRITICAL_SECTION cs;
 };
 
+#else
+
+#ifdef __linux__
+
+inline void FutexWait(std::atomic<int> *addr, int expected,
+                      const struct timespec *timeout = NULL) {
+  syscall(SYS_futex, reinterpret_cast<int *>(addr), FUTEX_WAIT_PRIVATE,
+          expected, timeout, NULL, 0);
+}
+
+inline void FutexWake(std::atomic<int> *addr, int count) {
+  syscall(SYS_futex, reinterpret_cast<int *>(addr), FUTEX_WAKE_PRIVATE, count,
+          NULL, NULL, 0);
+}
+
+// Futex mutex (Drepper, "Futexes Are Tricky", mutex #3).
+// state: 0 = unlocked, 1 = locked, 2 = locked with possible waiters.
+// Uncontended lock/unlock is a single atomic op and never enters the kernel.
+class Mutex {
+public:
+  Mutex() : state(0) {}
+  ~Mutex() {}
+
+  void lock() {
+    int c = 0;
+    if (state.compare_exchange_strong(c, 1, std::memory_order_acquire))
+      return;
+    lock_slow(c);
+  }
+
+  void unlock() {
+    if (state.exchange(0, std::memory_order_release) == 2)
+      FutexWake(&state, 1);
+  }
+
+  // Prevent copy/move
+  Mutex(const Mutex &) = delete;
+  Mutex &operator=(const Mutex &) = delete;
+
+private:
+  friend class ConditionVariable;
+  std::atomic<int> state;
+
+  void lock_slow(int c) {
+    // Brief spin: critical sections in this server are a few hundred ns
+    for (int spin = 0; spin < 64 && c == 1; ++spin) {
+      c = 0;
+      if (state.compare_exchange_weak(c, 1, std::memory_order_acquire))
+        return;
+    }
+    if (c != 2)
+      c = state.exchange(2, std::memory_order_acquire);
+    while (c != 0) {
+      FutexWait(&state, 2);
+      c = state.exchange(2, std::memory_order_acquire);
+    }
+  }
+
+  // Re-acquire after a condition wait. Always marks the lock contended
+  // since other waiters may have been woken alongside us.
+  void lock_contended() {
+    while (state.exchange(2, std::memory_order_acquire) != 0)
+      FutexWait(&state, 2);
+  }
+};
+
+#else
+
+class Mutex {
+public:
+  Mutex() { pthread_mutex_init(&mtx, NULL); }
+  ~Mutex() { pthread_mutex_destroy(&mtx); }
+  void lock() { pthread_mutex_lock(&mtx); }
+  void unlock() { pthread_mutex_unlock(&mtx); }
+  pthread_mutex_t *native_handle() { return &mtx; }
+
+  // Prevent copy/move
+  Mutex(const Mutex &) = delete;
+  Mutex &operator=(const Mutex &) = delete;
+
+private:
+  pthread_mutex_t mtx;
+};
+
+#endif // __linux__
+
+#endif // _WIN32
+
 class ConditionVariable; // Forward declaration
 
 class LockGuard {
@@ -57,6 +257,64 @@ private:
   Mutex &mutex;
 };
 
+// Reader/writer lock: SRWLOCK on Windows, pthread rwlock elsewhere (futex
+// based on glibc). Readers never block each other.
+class SharedMutex {
+public:
+#ifdef _WIN32
+  SharedMutex() { InitializeSRWLock(&rw); }
+  ~SharedMutex() {}
+  void lock() { AcquireSRWLockExclusive(&rw); }
+  void unlock() { ReleaseSRWLockExclusive(&rw); }
+  void lock_shared() { AcquireSRWLockShared(&rw); }
+  void unlock_shared() { ReleaseSRWLockShared(&rw); }
+#else
+  SharedMutex() { pthread_rwlock_init(&rw, NULL); }
+  ~SharedMutex() { pthread_rwlock_destroy(&rw); }
+  void lock() { pthread_rwlock_wrlock(&rw); }
+  void unlock() { pthread_rwlock_unlock(&rw); }
+  void lock_shared() { pthread_rwlock_rdlock(&rw); }
+  void unlock_shared() { pthread_rwlock_unlock(&rw); }
+#endif
+
+  // Prevent copy/move
+  SharedMutex(const SharedMutex &) = delete;
+  SharedMutex &operator=(const SharedMutex &) = delete;
+
+private:
+#ifdef _WIN32
+  SRWLOCK rw;
+#else
+  pthread_rwlock_t rw;
+#endif
+};
+
+class ReadLockGuard {
+public:
+  explicit ReadLockGuard(SharedMutex &m) : mutex(m) { mutex.lock_shared(); }
+  ~ReadLockGuard() { mutex.unlock_shared(); }
+  // Prevent copy/move
+  ReadLockGuard(const ReadLockGuard &) = delete;
+  ReadLockGuard &operator=(const ReadLockGuard &) = delete;
+
+private:
+  SharedMutex &mutex;
+};
+
+class WriteLockGuard {
+public:
+  explicit WriteLockGuard(SharedMutex &m) : mutex(m) { mutex.lock(); }
+  ~WriteLockGuard() { mutex.unlock(); }
+  // Prevent copy/move
+  WriteLockGuard(const WriteLockGuard &) = delete;
+  WriteLockGuard &operator=(const WriteLockGuard &) = delete;
+
+private:
+  SharedMutex &mutex;
+};
+
+#ifdef _WIN32
+
 class ConditionVariable {
 public:
   ConditionVariable() { InitializeConditionVariable(&cv); }
@@ -68,6 +326,21 @@ public:
     }
   }
 
+  // Returns the predicate's final value: false means the timeout expired
+  bool wait_for(LockGuard &lock, DWORD milliseconds,
+                std::function<bool()> predicate) {
+    ULONGLONG deadline = GetTickCount64() + milliseconds;
+    while (!predicate()) {
+      ULONGLONG now = GetTickCount64();
+      if (now >= deadline) {
+        return false;
+      }
+      SleepConditionVariableCS(&cv, lock.mutex.native_handle(),
+                               (DWORD)(deadline - now));
+    }
+    return true;
+  }
+
   void notify_one() { WakeConditionVariable(&cv); }
   void notify_all() { WakeAllConditionVariable(&cv); }
 
@@ -109,6 +382,40 @@ public:
 
   bool joinable() const { return handle != NULL; }
 
+  /**
+   * @brief Name the thread for debuggers (Windows 10 1607+, no-op before)
+   */
+  bool SetName(const char *name) {
+    typedef HRESULT(WINAPI * SetDescriptionFn)(HANDLE, PCWSTR);
+    if (!handle)
+      return false;
+    // Through void (*)(): GCC's -Wcast-function-type rejects FARPROC casts
+    auto set_description = reinterpret_cast<SetDescriptionFn>(
+        reinterpret_cast<void (*)()>(GetProcAddress(GetModuleHandleA("kernel32.dll"),
+                                                    "SetThreadDescription")));
+    if (!set_description)
+      return false;
+    wchar_t wide[64];
+    int n = MultiByteToWideChar(CP_UTF8, 0, name, -1, wide, 64);
+    if (n == 0)
+      return false;
+    wide[63] = L'\0';
+    return SUCCEEDED(set_description(handle, wide));
+  }
+
+  /**
+   * @brief Pin the thread to one CPU (index wraps at the processor count)
+   */
+  bool SetAffinity(int cpu) {
+    if (!handle || cpu < 0)
+      return false;
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    DWORD cpus = info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+    DWORD_PTR mask = (DWORD_PTR)1 << (cpu % cpus % (sizeof(DWORD_PTR) * 8));
+    return SetThreadAffinityMask(handle, mask) != 0;
+  }
+
   void join() {
     if (joinable()) {
       WaitForSingleObject(handle, INFINITE);
@@ -171,6 +478,246 @@ inline void LocalTime(struct tm *result, const time_t *time) {
     *result = *t;
 }
 
+#else
+
+inline void AddMilliseconds(struct timespec *ts, DWORD milliseconds) {
+  ts->tv_sec += milliseconds / 1000;
+  ts->tv_nsec += (long)(milliseconds % 1000) * 1000000L;
+  if (ts->tv_nsec >= 1000000000L) {
+    ts->tv_nsec -= 1000000000L;
+    ts->tv_sec += 1;
+  }
+}
+
+#ifdef __linux__
+
+// Sequence-counter condition variable on top of the futex Mutex.
+// notify_* skip the syscall entirely when nobody is waiting.
+class ConditionVariable {
+public:
+  ConditionVariable() : seq(0), waiters(0) {}
+  ~ConditionVariable() {}
+
+  void wait(LockGuard &lock, std::function<bool()> predicate) {
+    while (!predicate()) {
+      waiters.fetch_add(1);
+      int observed = seq.load();
+      lock.mutex.unlock();
+      FutexWait(&seq, observed);
+      lock.mutex.lock_contended();
+      waiters.fetch_sub(1);
+    }
+  }
+
+  // Returns the predicate's final value: false means the timeout expired
+  bool wait_for(LockGuard &lock, DWORD milliseconds,
+                std::function<bool()> predicate) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    AddMilliseconds(&deadline, milliseconds);
+    while (!predicate()) {
+      struct timespec now, remaining;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+      remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+      if (remaining.tv_nsec < 0) {
+        remaining.tv_nsec += 1000000000L;
+        remaining.tv_sec -= 1;
+      }
+      if (remaining.tv_sec < 0) {
+        return false;
+      }
+      waiters.fetch_add(1);
+      int observed = seq.load();
+      lock.mutex.unlock();
+      FutexWait(&seq, observed, &remaining);
+      lock.mutex.lock_contended();
+      waiters.fetch_sub(1);
+    }
+    return true;
+  }
+
+  void notify_one() {
+    seq.fetch_add(1);
+    if (waiters.load() > 0)
+      FutexWake(&seq, 1);
+  }
+
+  void notify_all() {
+    seq.fetch_add(1);
+    if (waiters.load() > 0)
+      FutexWake(&seq, INT_MAX);
+  }
+
+  // Prevent copy/move
+  ConditionVariable(const ConditionVariable &) = delete;
+  ConditionVariable &operator=(const ConditionVariable &) = delete;
+
+private:
+  std::atomic<int> seq;
+  std::atomic<int> waiters;
+};
+
+#else
+
+class ConditionVariable {
+public:
+  ConditionVariable() { pthread_cond_init(&cv, NULL); }
+  ~ConditionVariable() { pthread_cond_destroy(&cv); }
+
+  void wait(LockGuard &lock, std::function<bool()> predicate) {
+    while (!predicate()) {
+      pthread_cond_wait(&cv, lock.mutex.native_handle());
+    }
+  }
+
+  // Returns the predicate's final value: false means the timeout expired
+  bool wait_for(LockGuard &lock, DWORD milliseconds,
+                std::function<bool()> predicate) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    AddMilliseconds(&deadline, milliseconds);
+    while (!predicate()) {
+      if (pthread_cond_timedwait(&cv, lock.mutex.native_handle(), &deadline) ==
+          ETIMEDOUT) {
+        return predicate();
+      }
+    }
+    return true;
+  }
+
+  void notify_one() { pthread_cond_signal(&cv); }
+  void notify_all() { pthread_cond_broadcast(&cv); }
+
+  // Prevent copy/move
+  ConditionVariable(const ConditionVariable &) = delete;
+  ConditionVariable &operator=(const ConditionVariable &) = delete;
+
+private:
+  pthread_cond_t cv;
+};
+
+#endif // __linux__
+
+// Simple thread wrapper
+class Thread {
+public:
+  Thread() : handle(), started(false) {}
+
+  template <typename Function, typename... Args>
+  explicit Thread(Function &&f, Args &&...args) : handle(), started(false) {
+    auto task = new std::function<void()>(
+        std::bind(std::forward<Function>(f), std::forward<Args>(args)...));
+
+    if (pthread_create(&handle, NULL, StaticThreadStart, task) == 0) {
+      started = true;
+    } else {
+      delete task;
+    }
+  }
+
+  ~Thread() {
+    // Same contract as the Win32 wrapper: an unjoined thread is released,
+    // never terminated.
+    if (started)
+      pthread_detach(handle);
+  }
+
+  bool joinable() const { return started; }
+
+  /**
+   * @brief Name the thread for debuggers, top -H and perf
+   * Linux truncates names to 15 characters.
+   */
+  bool SetName(const char *name) {
+    if (!started)
+      return false;
+#ifdef __linux__
+    char truncated[16];
+    strncpy(truncated, name, sizeof(truncated) - 1);
+    truncated[sizeof(truncated) - 1] = '\0';
+    return pthread_setname_np(handle, truncated) == 0;
+#else
+    (void)name;
+    return false;
+#endif
+  }
+
+  /**
+   * @brief Pin the thread to one CPU (index wraps at the online CPU count)
+   */
+  bool SetAffinity(int cpu) {
+    if (!started || cpu < 0)
+      return false;
+#ifdef __linux__
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus > 0 ? cpu % cpus : 0, &set);
+    return pthread_setaffinity_np(handle, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+  }
+
+  void join() {
+    if (joinable()) {
+      pthread_join(handle, NULL);
+      started = false;
+    }
+  }
+
+  void detach() {
+    if (started) {
+      pthread_detach(handle);
+      started = false;
+    }
+  }
+
+  // Prevent copy
+  Thread(const Thread &) = delete;
+  Thread &operator=(const Thread &) = delete;
+
+  // Allow move
+  Thread(Thread &&other) noexcept
+      : handle(other.handle), started(other.started) {
+    other.started = false;
+  }
+
+  Thread &operator=(Thread &&other) noexcept {
+    if (this != &other) {
+      if (joinable())
+        std::terminate(); // simplified
+      handle = other.handle;
+      started = other.started;
+      other.started = false;
+    }
+    return *this;
+  }
+
+private:
+  pthread_t handle;
+  bool started;
+
+  static void *StaticThreadStart(void *arg) {
+    auto *task = static_cast<std::function<void()> *>(arg);
+    try {
+      (*task)();
+    } catch (...) {
+    }
+    delete task;
+    return NULL;
+  }
+};
+
+// Time compatibility
+inline void LocalTime(struct tm *result, const time_t *time) {
+  if (result)
+    localtime_r(time, result);
+}
+
+#endif // _WIN32
+
 } // namespace w32
 
 #endif // WIN32_COMPAT_H
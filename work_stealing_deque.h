@@ -0,0 +1,144 @@
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Chase-Lev work-stealing deque of pointers
+ *
+ * The owning thread pushes and takes at the bottom (LIFO, cache-warm);
+ * any other thread steals from the top (FIFO). Only a take/steal race on
+ * the last element touches a shared CAS. Memory orderings follow
+ * Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient Work-Stealing for
+ * Weak Memory Models" (PPoPP 2013).
+ *
+ * Growth is owner-only; outgrown buffers are retired, not freed, since a
+ * concurrent thief may still be reading one. They are released with the
+ * deque.
+ */
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t initial_capacity = 256)
+        : top(0), bottom(0) {
+        size_t capacity = 1;
+        while (capacity < initial_capacity) capacity <<= 1;
+        buffers.emplace_back(new Buffer(capacity));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    /**
+     * @brief Push an item at the bottom (owner thread only)
+     */
+    void push(T* item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(a->mask)) {
+            a = grow(a, t, b);
+        }
+        a->put(b, item);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Take the most recently pushed item (owner thread only)
+     * @return nullptr if empty
+     */
+    T* take() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = a->get(b);
+        if (t == b) {
+            // Last element: race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /**
+     * @brief Steal the oldest item (any thread)
+     * @return nullptr if empty or if another thread won the race
+     */
+    T* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        Buffer* a = buffer.load(std::memory_order_acquire);
+        T* item = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    /**
+     * @brief Approximate number of queued items (any thread)
+     */
+    size_t size() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    struct Buffer {
+        size_t mask;
+        std::unique_ptr<std::atomic<T*>[]> slots;
+
+        explicit Buffer(size_t capacity)
+            : mask(capacity - 1), slots(new std::atomic<T*>[capacity]) {}
+
+        T* get(int64_t i) const {
+            return slots[static_cast<size_t>(i) & mask].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T* item) {
+            slots[static_cast<size_t>(i) & mask].store(item, std::memory_order_relaxed);
+        }
+    };
+
+    Buffer* grow(Buffer* old, int64_t t, int64_t b) {
+        buffers.emplace_back(new Buffer((old->mask + 1) * 2));
+        Buffer* a = buffers.back().get();
+        for (int64_t i = t; i < b; ++i) {
+            a->put(i, old->get(i));
+        }
+        buffer.store(a, std::memory_order_release);
+        return a;
+    }
+
+    // top and bottom on separate cache lines: thieves hammer top
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    alignas(64) std::atomic<Buffer*> buffer;
+    std::vector<std::unique_ptr<Buffer>> buffers; // Owner-only, incl. retired
+};
+
+#endif // WORK_STEALING_DEQUE_H